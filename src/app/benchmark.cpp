@@ -0,0 +1,193 @@
+#include "benchmark.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <iterator>
+#include <string>
+#include "app/database.h"
+
+// short prefixes, like the first letters typed into the search box
+static const char* PREFIXES[] = { "\"im\"*", "\"ph\"*", "\"sc\"*", "\"do\"*", "\"ma\"*", "\"st\"*", "\"co\"*", "\"re\"*" };
+
+DBError Benchmark::run(const QString& path, const PerformanceProfile& profile, Result* out)
+{
+	// the database is only read. everything written goes to a scratch
+	// database next to it, so commits still pay for the same storage
+	sqlite3* con;
+	if (int rc = open(path, SQLITE_OPEN_READONLY, profile, &con); rc != SQLITE_OK)
+		return DBError(rc);
+	const QString scratchPath = path + u"-benchmark"_s;
+	removeScratch(scratchPath);
+	sqlite3* scratch;
+	if (int rc = open(scratchPath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, profile, &scratch); rc != SQLITE_OK)
+	{
+		sqlite3_close(con);
+		removeScratch(scratchPath);
+		return DBError(rc);
+	}
+	// a new file takes any page size, the database it stands in for would
+	// have to be rewritten to get it
+	const std::string pageSize = "PRAGMA page_size = " + std::to_string(profile.pageSize) + ";";
+	sqlite3_exec(scratch, pageSize.c_str(), 0, 0, 0);
+	sqlite3_exec(scratch, "PRAGMA journal_mode = 'WAL';", 0, 0, 0);
+
+	Result result;
+	const int rc = measure(con, scratch, &result);
+	sqlite3_close(scratch);
+	sqlite3_close(con);
+	removeScratch(scratchPath);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	if (out)
+		*out = result;
+	return DBError();
+}
+
+int Benchmark::open(const QString& path, int flags, const PerformanceProfile& profile, sqlite3** con)
+{
+	if (int rc = sqlite3_open_v2(path.toUtf8(), con, flags, nullptr); rc != SQLITE_OK)
+	{
+		sqlite3_close(*con);
+		return rc;
+	}
+	if (int rc = Database::prepareConnection(*con); rc != SQLITE_OK)
+	{
+		sqlite3_close(*con);
+		return rc;
+	}
+	profile.apply(*con);
+	sqlite3_busy_timeout(*con, profile.busyTimeout);
+	return SQLITE_OK;
+}
+
+void Benchmark::removeScratch(const QString& path)
+{
+	for (const QString& suffix : { u""_s, u"-wal"_s, u"-shm"_s, u"-journal"_s })
+		QFile::remove(path + suffix);
+}
+
+int Benchmark::measure(sqlite3* con, sqlite3* scratch, Result* result)
+{
+	QElapsedTimer timer;
+	sqlite3_stmt* stmt;
+
+	// point lookups spread over the ids in use
+	int64_t maxId = 0;
+	sqlite3_prepare_v2(con, "SELECT max(id) FROM file;", -1, &stmt, nullptr);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		maxId = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	if (maxId > 0)
+	{
+		QRandomGenerator random(1);
+		sqlite3_prepare_v2(con, "SELECT name, dir, state FROM file WHERE id = ?;", -1, &stmt, nullptr);
+		timer.start();
+		for (int i = 0; i < LOOKUPS; ++i)
+		{
+			sqlite3_bind_int64(stmt, 1, random.bounded(maxId) + 1);
+			sqlite3_step(stmt);
+			sqlite3_reset(stmt);
+		}
+		result->lookupMicroseconds = timer.nsecsElapsed() / 1000.0 / LOOKUPS;
+		sqlite3_finalize(stmt);
+	}
+
+	sqlite3_prepare_v2(con, "SELECT count(*) FROM file_search WHERE file_search MATCH ?;", -1, &stmt, nullptr);
+	timer.start();
+	for (int i = 0; i < SEARCHES; ++i)
+	{
+		sqlite3_bind_text(stmt, 1, PREFIXES[i % std::size(PREFIXES)], -1, SQLITE_STATIC);
+		sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	}
+	result->searchMilliseconds = timer.nsecsElapsed() / 1000000.0 / SEARCHES;
+	sqlite3_finalize(stmt);
+
+	sqlite3_prepare_v2(con, "SELECT coalesce(sum(length(block)), 0) FROM file_search_data;", -1, &stmt, nullptr);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		result->searchIndexBytes = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	// both tokenizers index the same names, so they are measured on equal
+	// terms
+	QByteArrayList names;
+	sqlite3_prepare_v2(con, "SELECT name FROM file LIMIT ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int(stmt, 1, TOKENIZER_SAMPLE);
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		names.append(QByteArray(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0)));
+	sqlite3_finalize(stmt);
+	result->sampledNames = names.size();
+	int rc = searchSample(scratch, names, "tokenize='unicode61'"
+		, &result->unicodeSearchMilliseconds, &result->unicodeIndexBytes);
+	if (rc == SQLITE_OK)
+		rc = searchSample(scratch, names, "tokenize='filename', prefix='2 3 4'"
+			, &result->filenameSearchMilliseconds, &result->filenameIndexBytes);
+	if (rc != SQLITE_OK)
+		return rc;
+
+	// each commit pays for the syncs the profile asks for
+	rc = sqlite3_exec(scratch, "CREATE TABLE benchmark_commit(value INTEGER) STRICT;", 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return rc;
+	sqlite3_prepare_v2(scratch, "INSERT INTO benchmark_commit(value) VALUES (?);", -1, &stmt, nullptr);
+	timer.start();
+	for (int i = 0; i < COMMITS && rc == SQLITE_OK; ++i)
+	{
+		sqlite3_exec(scratch, "BEGIN TRANSACTION;", 0, 0, 0);
+		sqlite3_bind_int(stmt, 1, i);
+		sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		rc = sqlite3_exec(scratch, "COMMIT TRANSACTION;", 0, 0, 0);
+	}
+	result->commitMilliseconds = timer.nsecsElapsed() / 1000000.0 / COMMITS;
+	sqlite3_finalize(stmt);
+	return rc;
+}
+
+int Benchmark::searchSample(sqlite3* scratch, const QByteArrayList& names, const char* options, double* milliseconds, qint64* indexBytes)
+{
+	const std::string create = std::string("CREATE VIRTUAL TABLE benchmark_search USING fts5(name, ") + options + ");";
+	if (int rc = sqlite3_exec(scratch, create.c_str(), 0, 0, 0); rc != SQLITE_OK)
+		return rc;
+	sqlite3_stmt* stmt;
+	sqlite3_exec(scratch, "BEGIN TRANSACTION;", 0, 0, 0);
+	sqlite3_prepare_v2(scratch, "INSERT INTO benchmark_search(name) VALUES (?);", -1, &stmt, nullptr);
+	int rc = SQLITE_DONE;
+	for (qsizetype i = 0; i < names.size() && rc == SQLITE_DONE; ++i)
+	{
+		sqlite3_bind_text(stmt, 1, names.at(i).constData(), names.at(i).size(), SQLITE_STATIC);
+		rc = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+	if (rc == SQLITE_DONE)
+		rc = sqlite3_exec(scratch, "COMMIT TRANSACTION;", 0, 0, 0);
+	else
+		sqlite3_exec(scratch, "ROLLBACK TRANSACTION;", 0, 0, 0);
+	if (rc == SQLITE_OK)
+	{
+		QElapsedTimer timer;
+		sqlite3_prepare_v2(scratch, "SELECT count(*) FROM benchmark_search WHERE benchmark_search MATCH ?;", -1, &stmt, nullptr);
+		timer.start();
+		for (int i = 0; i < SEARCHES; ++i)
+		{
+			sqlite3_bind_text(stmt, 1, PREFIXES[i % std::size(PREFIXES)], -1, SQLITE_STATIC);
+			sqlite3_step(stmt);
+			sqlite3_reset(stmt);
+		}
+		*milliseconds = timer.nsecsElapsed() / 1000000.0 / SEARCHES;
+		sqlite3_finalize(stmt);
+		sqlite3_prepare_v2(scratch, "SELECT coalesce(sum(length(block)), 0) FROM benchmark_search_data;", -1, &stmt, nullptr);
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+			*indexBytes = sqlite3_column_int64(stmt, 0);
+		sqlite3_finalize(stmt);
+	}
+	sqlite3_exec(scratch, "DROP TABLE benchmark_search;", 0, 0, 0);
+	return rc;
+}
+
+const int Benchmark::LOOKUPS = 5000;
+const int Benchmark::SEARCHES = 16;
+const int Benchmark::COMMITS = 50;
+const int Benchmark::TOKENIZER_SAMPLE = 100000;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QByteArrayList>
+#include <QString>
+#include "app/error.h"
+#include "app/performanceprofile.h"
+
+/**
+ * Short micro-benchmark against an open database, used to compare
+ * performance profiles. Reads on a separate, read-only connection configured
+ * with the profile under test and writes to a scratch database next to it,
+ * so the database itself is left as it is. Also puts the filename tokenizer
+ * side by side with the unicode61 one file_search used before it. Blocks
+ * for a few seconds, so run it off the UI thread.
+ */
+class Benchmark
+{
+public:
+	struct Result
+	{
+		// mean time of one primary key lookup on file
+		double lookupMicroseconds = 0;
+		// mean time of one prefix query against file_search
+		double searchMilliseconds = 0;
+		// mean time to commit a one-row transaction
+		double commitMilliseconds = 0;
+		qint64 searchIndexBytes = 0;
+		// the same prefix queries against a sample of names indexed with
+		// unicode61, and with the filename tokenizer and prefix indexes
+		qint64 sampledNames = 0;
+		double unicodeSearchMilliseconds = 0;
+		double filenameSearchMilliseconds = 0;
+		qint64 unicodeIndexBytes = 0;
+		qint64 filenameIndexBytes = 0;
+	};
+	static DBError run(const QString& path, const PerformanceProfile& profile, Result* out);
+
+private:
+	static const int LOOKUPS;
+	static const int SEARCHES;
+	static const int COMMITS;
+	static const int TOKENIZER_SAMPLE;
+	static int open(const QString& path, int flags, const PerformanceProfile& profile, sqlite3** con);
+	static void removeScratch(const QString& path);
+	static int measure(sqlite3* con, sqlite3* scratch, Result* result);
+	static int searchSample(sqlite3* scratch, const QByteArrayList& names, const char* options, double* milliseconds, qint64* indexBytes);
+};
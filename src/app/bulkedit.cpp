@@ -0,0 +1,316 @@
+#include "bulkedit.h"
+
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QUrl>
+
+#include "app/globals.h"
+
+// ids as a JSON array, for json_each()
+template <typename T>
+static QByteArray idsToJson(const QList<T>& items)
+{
+	QJsonArray ids;
+	for (const T& item : items)
+		ids.append(item.id());
+	return QJsonDocument(ids).toJson(QJsonDocument::Compact);
+}
+
+// fills a temp table with the ids in json, creating it if needed
+static DBError loadIds(const char* table, const QByteArray& json)
+{
+	const QByteArray sql = u"CREATE TEMP TABLE IF NOT EXISTS %1(id INTEGER PRIMARY KEY); DELETE FROM temp.%1;"_s
+		.arg(QLatin1StringView(table)).toUtf8();
+	int rc = sqlite3_exec(db->con(), sql.constData(), 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	sqlite3_stmt* stmt;
+	const QByteArray insert = u"INSERT OR IGNORE INTO temp.%1(id) SELECT value FROM json_each(?);"_s
+		.arg(QLatin1StringView(table)).toUtf8();
+	sqlite3_prepare_v2(db->con(), insert.constData(), -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, json.constData(), -1, SQLITE_STATIC);
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+static void clearIds(const char* table)
+{
+	if (db->isClosed())
+		return;
+	const QByteArray sql = u"DELETE FROM temp.%1;"_s.arg(QLatin1StringView(table)).toUtf8();
+	sqlite3_exec(db->con(), sql.constData(), 0, 0, 0);
+}
+
+DBError urlsToJson(const QStringList& urls, QByteArray* out)
+{
+	QJsonArray values;
+	for (const QString& url : urls)
+	{
+		QUrl qurl(url, QUrl::TolerantMode);
+		if (!qurl.isValid())
+			return DBError(DBError::ValueError, u"Invalid url: %1"_s.arg(url));
+		values.append(qurl.toString());
+	}
+	*out = QJsonDocument(values).toJson(QJsonDocument::Compact);
+	return DBError();
+}
+
+DBError replaceLinks(const char* table, const char* ownerColumn, const char* valueColumn
+	, const QByteArray& owners, const QByteArray& values, bool* changed)
+{
+	const QByteArray remove = u"DELETE FROM %1 WHERE %2 IN (SELECT value FROM json_each(?1)) AND %3 NOT IN (SELECT value FROM json_each(?2));"_s
+		.arg(QLatin1StringView(table), QLatin1StringView(ownerColumn), QLatin1StringView(valueColumn)).toUtf8();
+	const QByteArray insert = u"INSERT OR IGNORE INTO %1(%2, %3) SELECT owner.value, link.value FROM json_each(?1) AS owner, json_each(?2) AS link;"_s
+		.arg(QLatin1StringView(table), QLatin1StringView(ownerColumn), QLatin1StringView(valueColumn)).toUtf8();
+	bool touched = false;
+	for (const QByteArray& sql : { remove, insert })
+	{
+		sqlite3_stmt* stmt;
+		sqlite3_prepare_v2(db->con(), sql.constData(), -1, &stmt, nullptr);
+		sqlite3_bind_text(stmt, 1, owners.constData(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, values.constData(), -1, SQLITE_STATIC);
+		int rc = sqlite3_step(stmt);
+		sqlite3_finalize(stmt);
+		if (rc != SQLITE_DONE)
+			return DBError(rc);
+		touched |= sqlite3_changes(db->con()) > 0;
+	}
+	if (changed)
+		*changed = touched;
+	return DBError();
+}
+
+FileBulkEdit::FileBulkEdit(const QList<File>& files)
+	: m_files(files)
+	, m_loaded(false)
+	, m_touched(false)
+{}
+
+FileBulkEdit::~FileBulkEdit()
+{
+	if (m_loaded)
+		clearIds("bulk_file");
+}
+
+DBError FileBulkEdit::load()
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (m_loaded)
+		return DBError();
+	if (DBError error = loadIds("bulk_file", idsToJson(m_files)))
+		return error;
+	m_loaded = true;
+	return DBError();
+}
+
+DBError FileBulkEdit::setText(const char* sql, const QString& value)
+{
+	if (DBError error = load())
+		return error;
+	QByteArray value_bytes = value.trimmed().toUtf8();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, value_bytes.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	m_touched = true;
+	return DBError();
+}
+
+DBError FileBulkEdit::setAlias(const QString& alias)
+{
+	return setText("UPDATE file SET alias = ? WHERE id IN (SELECT id FROM temp.bulk_file);", alias);
+}
+
+DBError FileBulkEdit::setSource(const QString& source)
+{
+	return setText("UPDATE file SET source = ? WHERE id IN (SELECT id FROM temp.bulk_file);", source);
+}
+
+DBError FileBulkEdit::setComment(const QString& comment)
+{
+	return setText("UPDATE file SET comment = ? WHERE id IN (SELECT id FROM temp.bulk_file);", comment);
+}
+
+DBError FileBulkEdit::setDirectory(const QString& dir)
+{
+	if (DBError error = load())
+		return error;
+	const QString path = QDir(dir).absolutePath();
+	Directory directory;
+	if (DBError error = Directory::ensure(path, &directory))
+		return error;
+	const QByteArray path_bytes = path.toUtf8();
+	sqlite3_stmt* stmt;
+	const char* sql = R"(
+		UPDATE file SET dir = ?, dir_id = ?
+		FROM temp.bulk_file AS bulk_file
+		WHERE file.id = bulk_file.id;
+	)";
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, path_bytes.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 2, directory.id());
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+DBError FileBulkEdit::addTags(const QList<Tag>& tags)
+{
+	if (tags.isEmpty())
+		return DBError();
+	if (DBError error = load())
+		return error;
+	const QByteArray tags_json = idsToJson(tags);
+	sqlite3_stmt* stmt;
+	const char* sql = R"(
+		INSERT OR IGNORE INTO file_tag(file_id, tag_id)
+		SELECT bulk_file.id, tag.value FROM temp.bulk_file, json_each(?) AS tag;
+	)";
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, tags_json.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	m_touched = true;
+	return DBError();
+}
+
+DBError FileBulkEdit::removeTags(const QList<Tag>& tags)
+{
+	if (tags.isEmpty())
+		return DBError();
+	if (DBError error = load())
+		return error;
+	const QByteArray tags_json = idsToJson(tags);
+	sqlite3_stmt* stmt;
+	const char* sql = R"(
+		DELETE FROM file_tag
+		WHERE file_id IN (SELECT id FROM temp.bulk_file)
+			AND tag_id IN (SELECT value FROM json_each(?));
+	)";
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, tags_json.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	m_touched = true;
+	return DBError();
+}
+
+DBError FileBulkEdit::remove()
+{
+	if (DBError error = load())
+		return error;
+	int rc = sqlite3_exec(db->con(), "DELETE FROM file WHERE id IN (SELECT id FROM temp.bulk_file);", 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	m_touched = false;
+	return DBError();
+}
+
+DBError FileBulkEdit::finish()
+{
+	if (!m_touched)
+		return DBError();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "UPDATE file SET modified = ? WHERE id IN (SELECT id FROM temp.bulk_file);", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, QDateTime::currentSecsSinceEpoch());
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	m_touched = false;
+	return DBError();
+}
+
+TagBulkEdit::TagBulkEdit(const QList<Tag>& tags)
+	: m_tags(tags)
+	, m_loaded(false)
+	, m_touched(false)
+{}
+
+TagBulkEdit::~TagBulkEdit()
+{
+	if (m_loaded)
+		clearIds("bulk_tag");
+}
+
+DBError TagBulkEdit::load()
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (m_loaded)
+		return DBError();
+	if (DBError error = loadIds("bulk_tag", idsToJson(m_tags)))
+		return error;
+	m_loaded = true;
+	return DBError();
+}
+
+DBError TagBulkEdit::setDescription(const QString& description)
+{
+	if (DBError error = load())
+		return error;
+	QByteArray description_bytes = description.trimmed().toUtf8();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "UPDATE tag SET description = ? WHERE id IN (SELECT id FROM temp.bulk_tag);", -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, description_bytes.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	m_touched = true;
+	return DBError();
+}
+
+DBError TagBulkEdit::setURLs(const QStringList& urls)
+{
+	if (DBError error = load())
+		return error;
+	QByteArray urls_json;
+	if (DBError error = urlsToJson(urls, &urls_json))
+		return error;
+	bool changed;
+	if (DBError error = replaceLinks("tag_url", "tag_id", "url", idsToJson(m_tags), urls_json, &changed))
+		return error;
+	m_touched |= changed;
+	return DBError();
+}
+
+DBError TagBulkEdit::remove()
+{
+	if (DBError error = load())
+		return error;
+	int rc = sqlite3_exec(db->con(), "DELETE FROM tag WHERE id IN (SELECT id FROM temp.bulk_tag);", 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	m_touched = false;
+	return DBError();
+}
+
+DBError TagBulkEdit::finish()
+{
+	if (!m_touched)
+		return DBError();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "UPDATE tag SET modified = ? WHERE id IN (SELECT id FROM temp.bulk_tag);", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, QDateTime::currentSecsSinceEpoch());
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	m_touched = false;
+	return DBError();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "app/database.h"
+#include "app/file.h"
+#include "app/tag.h"
+
+// checks and normalizes urls into a JSON array, for replaceLinks()
+DBError urlsToJson(const QStringList& urls, QByteArray* out);
+/**
+ * Makes the values of valueColumn linked to each id in owners exactly those
+ * in values, both JSON arrays, by deleting what is no longer there and
+ * inserting what is new. Shared by the single and the bulk edits. changed
+ * is set when a row was touched.
+ */
+DBError replaceLinks(const char* table, const char* ownerColumn, const char* valueColumn
+	, const QByteArray& owners, const QByteArray& values, bool* changed = nullptr);
+
+/**
+ * Applies the same change to many files at once. The ids are loaded into a
+ * temp table on the first operation, each operation is then one statement
+ * over that table, and finish() stamps modified on all of them once. Meant
+ * to run inside db->beginBulk(). Only one may be in use at a time.
+ */
+class FileBulkEdit
+{
+public:
+	explicit FileBulkEdit(const QList<File>& files);
+	~FileBulkEdit();
+	DBError setAlias(const QString& alias);
+	DBError setSource(const QString& source);
+	DBError setComment(const QString& comment);
+	// moves the files into dir keeping their names, which like a single move
+	// does not count as a modification
+	DBError setDirectory(const QString& dir);
+	DBError addTags(const QList<Tag>& tags);
+	DBError removeTags(const QList<Tag>& tags);
+	// deletes the files, finish() is not needed afterwards
+	DBError remove();
+	DBError finish();
+
+private:
+	QList<File> m_files;
+	bool m_loaded;
+	bool m_touched;
+	DBError load();
+	DBError setText(const char* sql, const QString& value);
+};
+
+/**
+ * The same as FileBulkEdit, for tags.
+ */
+class TagBulkEdit
+{
+public:
+	explicit TagBulkEdit(const QList<Tag>& tags);
+	~TagBulkEdit();
+	DBError setDescription(const QString& description);
+	DBError setURLs(const QStringList& urls);
+	DBError remove();
+	DBError finish();
+
+private:
+	QList<Tag> m_tags;
+	bool m_loaded;
+	bool m_touched;
+	DBError load();
+};
@@ -1,18 +1,39 @@
 #include "database.h"
 
 #include <QDir>
+#include <QEventLoop>
 #include <QFileInfo>
 #include <QSettings>
+#include <QThread>
 #include <QTimer>
+#include <cstring>
+#include "app/filenametokenizer.h"
+#include "app/migration.h"
+#include "app/performanceprofile.h"
+
+// file_search is contentless and its rows are deleted by rowid, which needs
+// contentless_delete
+static_assert(SQLITE_VERSION_NUMBER >= 3043000, "SQLite 3.43 or newer is required");
 
 Database::Database(QObject* parent)
 	: QObject(parent)
 	, m_con(nullptr)
+	, m_deferWrites(false)
+	, m_busyTimeout(BUSY_TIMEOUT)
 {
 	m_onUpdateTimer = new QTimer(this);
 	m_onUpdateTimer->setSingleShot(true);
 	m_onUpdateTimer->setInterval(250);
-	connect(m_onUpdateTimer, &QTimer::timeout, this, [this]() -> void { emit updated(); });
+	connect(m_onUpdateTimer, &QTimer::timeout, this, [this]() -> void
+		{
+			if (!m_updatedTags.isEmpty())
+			{
+				QList<int64_t> ids(m_updatedTags.begin(), m_updatedTags.end());
+				m_updatedTags.clear();
+				emit tagsUpdated(ids);
+			}
+			emit updated();
+		});
 }
 
 Database::~Database()
@@ -37,45 +58,41 @@ DBError Database::open(const QString& path)
 {
 	if (isOpen())
 		close();
+	// the bundled library passes the check above, one linked in its place
+	// may not
+	if (sqlite3_libversion_number() < 3043000)
+		return DBError(DBError::UnsupportedVersion, u"SQLite 3.43 or newer is required, found %1."_s.arg(sqlite3_libversion()));
 
-	if (int rc = sqlite3_open(path.toUtf8(), &m_con) != SQLITE_OK)
+	if (int rc = sqlite3_open(path.toUtf8(), &m_con); rc != SQLITE_OK)
 	{
 		qCritical().nospace() << "Failed to open database at " << path << ": " << sqlite3_errstr(rc);
 		close(); // connection still returned even in the event of error
 		return DBError(rc);
 	}
 	m_path = path;
-	sqlite3_exec(m_con, "PRAGMA encoding = 'UTF-8';", 0, 0, 0);
-	sqlite3_exec(m_con, "PRAGMA foreign_keys = '1';", 0, 0, 0);
 	sqlite3_exec(m_con, "PRAGMA journal_mode = 'WAL';", 0, 0, 0);
+	if (int rc = prepareConnection(m_con, &m_deferWrites); rc != SQLITE_OK)
+	{
+		close();
+		return DBError(rc);
+	}
+	applyProfile(PerformanceProfile::load(configPath()));
 
 	// update database schema if need be
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(m_con, "PRAGMA user_version;", -1, &stmt, nullptr);
-	sqlite3_step(stmt);
-	int user_version = sqlite3_column_int(stmt, 0);
-	sqlite3_finalize(stmt);
-
-	if (user_version > CURRENT_USER_VERSION)
+	const int userVersion = Migrator::version(m_con);
+	if (userVersion > Migrator::latestVersion())
 	{
 		close();
 		return DBError(DBError::UnsupportedVersion, u"Database version is newer than the application supports."_s);
 	}
-
-	begin();
-	switch (user_version)
+	if (userVersion < Migrator::latestVersion())
 	{
-	case 0:
-		if (int rc = migrate_0_to_1() != SQLITE_OK)
+		if (int rc = migrate(); rc != SQLITE_OK)
 		{
-			rollback();
 			close();
 			return DBError(rc);
 		}
 	}
-	commit();
-	const std::string q = "PRAGMA user_version = " + std::to_string(CURRENT_USER_VERSION) + ";";
-	sqlite3_exec(m_con, q.c_str(), 0, 0, 0);
 
 	QSettings settings;
 	// make this database automatically open on next launch
@@ -102,6 +119,8 @@ DBError Database::open(const QString& path)
 	emit opened(path);
 	sqlite3_update_hook(m_con, [](void* arg, int operation, const char* dbName, const char* tableName, sqlite3_int64 rowid) -> void
 		{
+			if (std::strcmp(tableName, "tag") == 0)
+				db->m_updatedTags.insert(rowid);
 			db->m_onUpdateTimer->start();
 		}, nullptr);
 	//sqlite3_trace_v2(m_con, SQLITE_TRACE_STMT, [](unsigned int mask, void* context, void* p, void* x) -> int
@@ -126,6 +145,8 @@ DBError Database::close(bool clearLastOpened)
 		}
 		m_con = nullptr;
 		m_path = QString();
+		m_updatedTags.clear();
+		m_deferWrites = false;
 		emit closed();
 		return DBError();
 	}
@@ -147,19 +168,42 @@ DBError Database::begin()
 {
 	if (db->isClosed())
 		return DBError(DBError::DatabaseClosed);
-	return DBError(sqlite3_exec(m_con, "BEGIN TRANSACTION;", 0, 0, 0));
+	emit beginning();
+	if (int rc = sqlite3_exec(m_con, "BEGIN TRANSACTION;", 0, 0, 0); rc != SQLITE_OK)
+		return DBError(rc);
+	return DBError();
+}
+
+DBError Database::beginBulk()
+{
+	if (DBError error = begin())
+		return error;
+	m_deferWrites = true;
+	return DBError();
 }
 
 DBError Database::commit()
 {
 	if (db->isClosed())
 		return DBError(DBError::DatabaseClosed);
+	// on failure the transaction is rolled back, few callers could do
+	// anything else and one left open would swallow every later write
+	if (m_deferWrites)
+	{
+		if (int rc = flushDeferred(); rc != SQLITE_OK)
+		{
+			rollback();
+			return DBError(rc);
+		}
+		m_deferWrites = false;
+	}
 	int rc = sqlite3_exec(m_con, "COMMIT TRANSACTION;", 0, 0, 0);
 	if (rc == SQLITE_OK)
 	{
 		emit committed();
 		return DBError();
 	}
+	rollback();
 	return DBError(rc);
 }
 
@@ -167,6 +211,7 @@ DBError Database::rollback()
 {
 	if (db->isClosed())
 		return DBError(DBError::DatabaseClosed);
+	m_deferWrites = false;
 	int rc = sqlite3_exec(m_con, "ROLLBACK TRANSACTION;", 0, 0, 0);
 	if (rc == SQLITE_OK)
 	{
@@ -176,6 +221,66 @@ DBError Database::rollback()
 	return DBError(rc);
 }
 
+DBError Database::setPageSize(int pageSize)
+{
+	if (isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (pageSize < 512 || pageSize > 65536 || (pageSize & (pageSize - 1)) != 0)
+		return DBError(DBError::ValueError, u"Page size must be a power of two between 512 and 65536"_s);
+	// the page size of a WAL database is fixed, so leave WAL for the rewrite.
+	// this only works while no other connection is open
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(m_con, "PRAGMA journal_mode = 'DELETE';", -1, &stmt, nullptr);
+	QString mode;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		mode = QString::fromUtf8((const char*)sqlite3_column_text(stmt, 0));
+	sqlite3_finalize(stmt);
+	if (mode != u"delete"_s)
+		return DBError(SQLITE_BUSY);
+	const std::string sql = "PRAGMA page_size = " + std::to_string(pageSize) + ";";
+	sqlite3_exec(m_con, sql.c_str(), 0, 0, 0);
+	int rc = sqlite3_exec(m_con, "VACUUM;", 0, 0, 0);
+	sqlite3_exec(m_con, "PRAGMA journal_mode = 'WAL';", 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	return DBError();
+}
+
+int Database::pageSize() const
+{
+	if (isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(m_con, "PRAGMA page_size;", -1, &stmt, nullptr);
+	int size = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		size = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return size;
+}
+
+void Database::applyProfile(const PerformanceProfile& profile)
+{
+	if (isClosed())
+		return;
+	profile.apply(m_con);
+	m_busyTimeout = profile.busyTimeout;
+	// waits as long as the profile asks, but says so first. a write that
+	// does not start a transaction runs into maintenance without
+	// beginning(). sqlite3_busy_timeout() would replace this, so nothing
+	// may call it on m_con
+	sqlite3_busy_handler(m_con, [](void* arg, int count) -> int
+		{
+			Database* database = static_cast<Database*>(arg);
+			if (count == 0)
+				emit database->busy();
+			if (count * BUSY_RETRY_INTERVAL >= database->m_busyTimeout)
+				return 0;
+			sqlite3_sleep(BUSY_RETRY_INTERVAL);
+			return 1;
+		}, this);
+}
+
 QString Database::path() const
 {
 	return m_path;
@@ -190,119 +295,94 @@ QString Database::configPath() const
 	return iniFile.absoluteFilePath();
 }
 
-int Database::migrate_0_to_1()
+int Database::prepareConnection(sqlite3* con, bool* deferWrites)
 {
-	const char* sql = R"(
-		CREATE TABLE file(
-			id       INTEGER PRIMARY KEY AUTOINCREMENT,
-			name     TEXT    NOT NULL,
-			dir      TEXT    NOT NULL,
-			alias    TEXT    NOT NULL DEFAULT '',
-			state    INTEGER NOT NULL DEFAULT 0, -- Ok
-			comment  TEXT    NOT NULL DEFAULT '',
-			source   TEXT    NOT NULL DEFAULT '',
-			sha1     BLOB    NOT NULL,
-			created  INTEGER NOT NULL DEFAULT (unixepoch()),
-			modified INTEGER NOT NULL DEFAULT (unixepoch()),
-			checked  INTEGER NOT NULL DEFAULT (unixepoch()),
-
-			UNIQUE (name, dir)
-		) STRICT;
-
-		CREATE INDEX file_alias ON file(alias);
-		CREATE INDEX file_state ON file(state);
-		CREATE INDEX file_created ON file(created);
-		CREATE INDEX file_modified ON file(modified);
-		CREATE INDEX file_checked ON file(checked);
-
-		CREATE VIRTUAL TABLE file_search USING fts5(name, alias, dir, comment, content='file', content_rowid='id');
-		CREATE TRIGGER file_ai AFTER INSERT ON file
-		BEGIN
-			INSERT INTO file_search(rowid, name, alias, dir, comment)
-			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
-		END;
-		CREATE TRIGGER file_ad AFTER DELETE ON file
-		BEGIN
-			INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
-			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
-		END;
-		CREATE TRIGGER file_au AFTER UPDATE ON file
-		BEGIN
-			INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
-			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
-			INSERT INTO file_search(rowid, name, alias, dir, comment)
-			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
-		END;
-
-		CREATE TABLE tag(
-			id          INTEGER PRIMARY KEY AUTOINCREMENT,
-			name        TEXT    NOT NULL UNIQUE,
-			description TEXT    NOT NULL DEFAULT '',
-			degree      INTEGER NOT NULL DEFAULT 0,
-			created     INTEGER NOT NULL DEFAULT (unixepoch()),
-			modified    INTEGER NOT NULL DEFAULT (unixepoch())
-		) STRICT;
-
-		CREATE INDEX tag_name ON tag(name);
-		CREATE INDEX tag_degree ON tag(degree);
-		CREATE INDEX tag_created ON tag(created);
-		CREATE INDEX tag_modified ON tag(modified);
-
-		CREATE VIRTUAL TABLE tag_search USING fts5(name, description, content='tag', content_rowid='id');
-		CREATE TRIGGER tag_ai AFTER INSERT ON tag
-		BEGIN
-			INSERT INTO tag_search(rowid, name, description)
-			VALUES (NEW.id, NEW.name, NEW.description);
-		END;
-		CREATE TRIGGER tag_ad AFTER DELETE ON tag
-		BEGIN
-			INSERT INTO tag_search(tag_search, rowid, name, description)
-			VALUES ('delete', OLD.id, old.name, old.description);
-		END;
-		CREATE TRIGGER tag_au AFTER UPDATE ON tag
-		BEGIN
-			INSERT INTO tag_search(tag_search, rowid, name, description)
-			VALUES ('delete', OLD.id, OLD.name, OLD.description);
-			INSERT INTO tag_search(rowid, name, description)
-			VALUES (NEW.id, NEW.name, NEW.description);
-		END;
-
-		CREATE TABLE tag_url(
-			tag_id INTEGER NOT NULL,
-			url    TEXT    NOT NULL,
-
-			PRIMARY KEY (tag_id, url),
-			FOREIGN KEY (tag_id) REFERENCES tag(id) ON DELETE CASCADE
-		) STRICT;
-
-		CREATE TABLE file_tag(
-			file_id INTEGER NOT NULL,
-			tag_id  INTEGER NOT NULL,
-			created INTEGER NOT NULL DEFAULT (unixepoch()),
-			PRIMARY KEY (file_id, tag_id),
-			FOREIGN KEY (file_id) REFERENCES file(id) ON DELETE CASCADE,
-			FOREIGN KEY (tag_id)  REFERENCES tag(id)  ON DELETE CASCADE
-		) STRICT;
-
-		CREATE TRIGGER file_tag_ai AFTER INSERT ON file_tag
-		BEGIN
-			UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
-		END;
-
-		CREATE TRIGGER file_tag_ad AFTER DELETE ON file_tag
-		BEGIN
-			UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
-		END;
+	sqlite3_exec(con, "PRAGMA encoding = 'UTF-8';", 0, 0, 0);
+	sqlite3_exec(con, "PRAGMA foreign_keys = '1';", 0, 0, 0);
+	// wait for background maintenance instead of failing with SQLITE_BUSY
+	sqlite3_busy_timeout(con, BUSY_TIMEOUT);
+	if (int rc = FilenameTokenizer::install(con); rc != SQLITE_OK)
+	{
+		qCritical().nospace() << "Failed to register the filename tokenizer: " << sqlite3_errstr(rc);
+		return rc;
+	}
+	// the index and degree triggers check this to tell whether they should
+	// run now or leave the work to flushDeferred(). connections without a
+	// flag never defer
+	sqlite3_create_function_v2(con, "deferred_writes", 0, SQLITE_UTF8 | SQLITE_INNOCUOUS, deferWrites
+		, [](sqlite3_context* context, int argc, sqlite3_value** argv) -> void
+		{
+			const bool* flag = static_cast<bool*>(sqlite3_user_data(context));
+			sqlite3_result_int(context, flag != nullptr && *flag);
+		}, nullptr, nullptr, nullptr);
+	return SQLITE_OK;
+}
 
-		CREATE TRIGGER file_tag_au AFTER UPDATE ON file_tag
-		BEGIN
-			UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
-			UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
-		END;
+int Database::flushDeferred()
+{
+	// the same rows the triggers would have written, one statement each
+	const char* sql = R"(
+		INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+		SELECT * FROM file_search_source WHERE id IN (SELECT id FROM deferred_search);
+		INSERT INTO file_search_trigram(rowid, name, alias, dir)
+		SELECT id, name, alias, dir FROM file WHERE id IN (SELECT id FROM deferred_trigram);
+		UPDATE tag SET degree = coalesce(counts.degree, 0)
+		FROM deferred_tag
+		LEFT JOIN (
+			SELECT tag_id, count(*) AS degree FROM file_tag
+			WHERE tag_id IN (SELECT id FROM deferred_tag)
+			GROUP BY tag_id
+		) AS counts ON counts.tag_id = deferred_tag.id
+		WHERE tag.id = deferred_tag.id;
+		UPDATE directory SET file_count = (SELECT count(*) FROM file WHERE dir_id = directory.id)
+		WHERE id IN (SELECT id FROM deferred_directory);
+		UPDATE directory SET total_count = (
+			SELECT coalesce(sum(d.file_count), 0) FROM directory_closure AS c
+			INNER JOIN directory AS d ON d.id = c.descendant_id
+			WHERE c.ancestor_id = directory.id
+		)
+		WHERE id IN (
+			SELECT ancestor_id FROM directory_closure
+			WHERE descendant_id IN (SELECT id FROM deferred_directory)
+		);
+		DELETE FROM directory WHERE total_count = 0 AND id IN (
+			SELECT ancestor_id FROM directory_closure
+			WHERE descendant_id IN (SELECT id FROM deferred_directory)
+		);
+		DELETE FROM deferred_search;
+		DELETE FROM deferred_trigram;
+		DELETE FROM deferred_tag;
+		DELETE FROM deferred_directory;
 	)";
 	int rc = sqlite3_exec(m_con, sql, 0, 0, 0);
 	if (rc != SQLITE_OK)
-		qCritical() << "Failed updating database from user_version 0 to 1:" << sqlite3_errmsg(m_con);
+		qCritical() << "Failed to apply deferred writes:" << sqlite3_errmsg(m_con);
+	return rc;
+}
+
+int Database::migrate()
+{
+	// steps that backfill every file take a while on large databases, so they
+	// run on their own connection while the event loop keeps the UI painted
+	Migrator migrator(m_path);
+	connect(&migrator, &Migrator::progress, this, &Database::migrating);
+	// whatever that loop runs finds the database closed rather than on the
+	// old schema until it is done, and the progress is up before it starts
+	sqlite3* con = m_con;
+	m_con = nullptr;
+	emit migrating(tr("Preparing to update the database"), 0);
+	int rc = SQLITE_OK;
+	QEventLoop loop;
+	QThread* thread = QThread::create([&migrator, &rc]() -> void
+		{
+			rc = migrator.run();
+		});
+	connect(thread, &QThread::finished, &loop, &QEventLoop::quit);
+	thread->start();
+	loop.exec();
+	thread->wait();
+	delete thread;
+	m_con = con;
 	return rc;
 }
 
@@ -317,5 +397,6 @@ const QStringList DBError::CODE_STRING
 };
 
 Database* Database::s_instance = nullptr;
-const int Database::CURRENT_USER_VERSION = 1;
 const int Database::MAX_RECENTLY_OPENED_HISTORY_SIZE = 6;
+const int Database::BUSY_TIMEOUT = 5000;
+const int Database::BUSY_RETRY_INTERVAL = 10;
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <QObject>
+#include <QSet>
 #include "sqlite3.h"
 #include "app/error.h"
 #include "app/globals.h"
 
+struct PerformanceProfile;
+
 #define db Database::instance()
 
 struct DBError : public Error
@@ -58,26 +61,62 @@ public:
 	bool isOpen() const;
 	bool isClosed() const;
 	DBError begin();
+	/**
+	 * Starts a transaction in which search index and tag degree maintenance is
+	 * collected rather than done per row, then applied once by commit(). Use
+	 * for writes that touch many files at once.
+	 */
+	DBError beginBulk();
+	// rolls back if the transaction cannot be committed
 	DBError commit();
 	DBError rollback();
+	/**
+	 * Rewrites the whole database with a new page size. Blocks until done,
+	 * and fails with SQLITE_BUSY if another connection is open.
+	 */
+	DBError setPageSize(int pageSize);
+	int pageSize() const;
+	// applies the connection settings, including how long to wait for locks
+	void applyProfile(const PerformanceProfile& profile);
 	QString path() const;
 	QString configPath() const;
+	/**
+	 * Applies the settings, tokenizers and functions the schema relies on.
+	 * Every connection to a database must go through this, including those
+	 * opened on other threads.
+	 */
+	static int prepareConnection(sqlite3* con, bool* deferWrites = nullptr);
+	// how long a statement waits for another connection's lock, in ms
+	static const int BUSY_TIMEOUT;
 
 signals:
 	void opened(const QString& path);
+	// emitted before a transaction is started
+	void beginning();
+	// emitted when a statement has to wait for another connection's lock
+	void busy();
 	void closed();
 	void committed();
 	void rollbacked();
 	// debounced signal from sqlite_update_hook
 	void updated();
+	// debounced alongside updated(), lists the tag rows that were touched
+	void tagsUpdated(const QList<int64_t>& ids);
+	// emitted while open() brings an older database up to date, once before
+	// the first step starts. the database reads as closed until it is done
+	void migrating(const QString& description, int permille);
 
 private:
 	explicit Database(QObject* parent = nullptr);
 	static Database* s_instance;
-	static const int CURRENT_USER_VERSION;
 	static const int MAX_RECENTLY_OPENED_HISTORY_SIZE;
+	static const int BUSY_RETRY_INTERVAL;
 	QTimer* m_onUpdateTimer;
+	QSet<int64_t> m_updatedTags;
 	QString m_path;
 	sqlite3* m_con;
-	int migrate_0_to_1();
+	bool m_deferWrites;
+	int m_busyTimeout;
+	int flushDeferred();
+	int migrate();
 };
@@ -0,0 +1,353 @@
+#include "directory.h"
+
+#include <QDir>
+#include <QStorageInfo>
+#include <optional>
+
+#include "app/globals.h"
+#include "app/volume.h"
+
+Directory::Directory()
+	: m_id(-1)
+{}
+
+Directory::Directory(int64_t id)
+	: m_id(id)
+{}
+
+DBError Directory::ensure(const QString& path, Directory* out)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+
+	// walk up to the nearest directory that is already known
+	QStringList missing;
+	Directory parent;
+	for (QString current = path; !current.isNull(); current = parentPath(current))
+	{
+		parent = fromPath(current);
+		if (parent.id() >= 0)
+			break;
+		missing.prepend(current);
+	}
+
+	// the file system is looked up once for the deepest directory. those
+	// above its mount point are few and looked up on their own
+	Volume volume;
+	QString mountRoot;
+	std::optional<Volume::Identities> identities;
+	if (!missing.isEmpty())
+	{
+		const QStorageInfo storage(path);
+		mountRoot = QDir::fromNativeSeparators(storage.rootPath());
+		identities.emplace();
+		if (DBError error = Volume::ensure(storage, &volume, &*identities))
+			return error;
+	}
+
+	// then create the rest top down, each one with its ancestors in the
+	// closure table and itself at depth 0
+	sqlite3_stmt* insertStmt;
+	sqlite3_stmt* closureStmt;
+	sqlite3_prepare_v2(db->con(), "INSERT INTO directory(parent_id, name, path, volume_id) VALUES (?, ?, ?, ?);", -1, &insertStmt, nullptr);
+	const char* sql = R"(
+		INSERT INTO directory_closure(ancestor_id, descendant_id, depth)
+		SELECT ancestor_id, ?1, depth + 1 FROM directory_closure WHERE descendant_id = ?2
+		UNION ALL
+		SELECT ?1, ?1, 0;
+	)";
+	sqlite3_prepare_v2(db->con(), sql, -1, &closureStmt, nullptr);
+	int rc = SQLITE_DONE;
+	for (const QString& current : missing)
+	{
+		const QString parentPath = Directory::parentPath(current);
+		const QByteArray name_bytes = (parentPath.isNull() ? current : current.mid(current.lastIndexOf('/') + 1)).toUtf8();
+		const QByteArray path_bytes = current.toUtf8();
+		if (parent.id() >= 0)
+			sqlite3_bind_int64(insertStmt, 1, parent.id());
+		else
+			sqlite3_bind_null(insertStmt, 1);
+		sqlite3_bind_text(insertStmt, 2, name_bytes.constData(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(insertStmt, 3, path_bytes.constData(), -1, SQLITE_STATIC);
+		Volume currentVolume = volume;
+		if (current.size() < mountRoot.size())
+		{
+			currentVolume = Volume();
+			Volume::ensure(QStorageInfo(current), &currentVolume, &*identities);
+		}
+		if (currentVolume.id() >= 0)
+			sqlite3_bind_int64(insertStmt, 4, currentVolume.id());
+		else
+			sqlite3_bind_null(insertStmt, 4);
+		rc = sqlite3_step(insertStmt);
+		sqlite3_reset(insertStmt);
+		if (rc != SQLITE_DONE)
+			break;
+		const int64_t id = sqlite3_last_insert_rowid(db->con());
+		sqlite3_bind_int64(closureStmt, 1, id);
+		sqlite3_bind_int64(closureStmt, 2, parent.id());
+		rc = sqlite3_step(closureStmt);
+		sqlite3_reset(closureStmt);
+		if (rc != SQLITE_DONE)
+			break;
+		parent = Directory(id);
+	}
+	sqlite3_finalize(insertStmt);
+	sqlite3_finalize(closureStmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	if (out)
+		*out = parent;
+	return DBError();
+}
+
+DBError Directory::relocate(const QString& from, const QString& to, QList<int64_t>* moved)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (from == to)
+		return DBError();
+	// its own subdirectories would be renamed onto paths the move is still
+	// about to take away
+	if (to.startsWith(from.endsWith('/') ? from : from + '/'))
+		return DBError(DBError::ValueError, u"Cannot move %1 into itself"_s.arg(from));
+	const Directory source = fromPath(from);
+	if (source.id() < 0)
+		return DBError(DBError::ValueError, u"No files are stored under %1"_s.arg(from));
+
+	sqlite3_stmt* stmt;
+	const char* sql = R"(
+		SELECT directory.id, directory.path FROM directory_closure
+		INNER JOIN directory ON directory.id = directory_closure.descendant_id
+		WHERE directory_closure.ancestor_id = ?
+		ORDER BY directory_closure.depth;
+	)";
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, source.id());
+	QList<std::pair<int64_t, QString>> subtree;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		subtree.append({
+			sqlite3_column_int64(stmt, 0),
+			QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1))
+		});
+	sqlite3_finalize(stmt);
+
+	// map every directory in the subtree to its new place first, so the files
+	// can then be moved in one statement
+	int rc = sqlite3_exec(db->con(), R"(
+		CREATE TEMP TABLE IF NOT EXISTS relocation(
+			old_id   INTEGER PRIMARY KEY,
+			new_id   INTEGER NOT NULL,
+			new_path TEXT    NOT NULL
+		);
+		DELETE FROM temp.relocation;
+	)", 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	sqlite3_prepare_v2(db->con(), "INSERT INTO temp.relocation(old_id, new_id, new_path) VALUES (?, ?, ?);", -1, &stmt, nullptr);
+	for (const auto& [id, path] : subtree)
+	{
+		QString rest = path.mid(from.size());
+		if (rest.startsWith('/'))
+			rest.remove(0, 1);
+		const QString newPath = rest.isEmpty() ? to : to.endsWith('/') ? to + rest : to + '/' + rest;
+		Directory target;
+		if (DBError error = ensure(newPath, &target))
+		{
+			sqlite3_finalize(stmt);
+			return error;
+		}
+		const QByteArray path_bytes = newPath.toUtf8();
+		sqlite3_bind_int64(stmt, 1, id);
+		sqlite3_bind_int64(stmt, 2, target.id());
+		sqlite3_bind_text(stmt, 3, path_bytes.constData(), -1, SQLITE_STATIC);
+		rc = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			sqlite3_finalize(stmt);
+			return DBError(rc);
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	if (moved)
+	{
+		sqlite3_prepare_v2(db->con(), "SELECT id FROM file WHERE dir_id IN (SELECT old_id FROM temp.relocation);", -1, &stmt, nullptr);
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+			moved->append(sqlite3_column_int64(stmt, 0));
+		sqlite3_finalize(stmt);
+	}
+	rc = sqlite3_exec(db->con(), R"(
+		UPDATE file SET dir = relocation.new_path, dir_id = relocation.new_id
+		FROM temp.relocation AS relocation
+		WHERE file.dir_id = relocation.old_id;
+		DELETE FROM temp.relocation;
+	)", 0, 0, 0);
+	if (rc != SQLITE_OK)
+		return DBError(rc);
+	return DBError();
+}
+
+Directory Directory::fromPath(const QString& path)
+{
+	if (db->isClosed())
+		return Directory();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id FROM directory WHERE path = ?;", -1, &stmt, nullptr);
+	QByteArray path_utf8 = path.toUtf8();
+	sqlite3_bind_text(stmt, 1, path_utf8, -1, SQLITE_STATIC);
+	Directory directory;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		directory = Directory(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return directory;
+}
+
+QList<Directory> Directory::roots()
+{
+	if (db->isClosed())
+		return QList<Directory>();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id FROM directory WHERE parent_id IS NULL ORDER BY name;", -1, &stmt, nullptr);
+	QList<Directory> roots;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		roots.append(Directory(sqlite3_column_int64(stmt, 0)));
+	sqlite3_finalize(stmt);
+	return roots;
+}
+
+QString Directory::parentPath(const QString& path)
+{
+	// a root keeps its trailing separator, like "/" or "C:/". the schema
+	// migration splits paths with the same rules in SQL
+	if (path.endsWith('/'))
+		return QString();
+	const qsizetype i = path.lastIndexOf('/');
+	if (i < 0)
+		return QString();
+	QString parent = path.left(i + 1);
+	QString trimmed = parent;
+	while (trimmed.endsWith('/'))
+		trimmed.chop(1);
+	return trimmed.contains('/') ? trimmed : parent;
+}
+
+bool Directory::exists() const
+{
+	if (m_id < 0)
+		return false;
+	if (db->isClosed())
+		return false;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT EXISTS(SELECT 1 FROM directory WHERE id = ?);", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	bool exists = false;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		exists = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return exists;
+}
+
+int64_t Directory::id() const
+{
+	return m_id;
+}
+
+QString Directory::name() const
+{
+	if (db->isClosed())
+		return QString();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT name FROM directory WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QString name;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		name = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+	sqlite3_finalize(stmt);
+	return name;
+}
+
+QString Directory::path() const
+{
+	if (db->isClosed())
+		return QString();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT path FROM directory WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QString path;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		path = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+	sqlite3_finalize(stmt);
+	return path;
+}
+
+Directory Directory::parent() const
+{
+	if (db->isClosed())
+		return Directory();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT parent_id FROM directory WHERE id = ? AND parent_id IS NOT NULL;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	Directory parent;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		parent = Directory(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return parent;
+}
+
+QList<Directory> Directory::children() const
+{
+	if (db->isClosed())
+		return QList<Directory>();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id FROM directory WHERE parent_id = ? ORDER BY name;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QList<Directory> children;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		children.append(Directory(sqlite3_column_int64(stmt, 0)));
+	sqlite3_finalize(stmt);
+	return children;
+}
+
+int64_t Directory::fileCount() const
+{
+	if (db->isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT file_count FROM directory WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int64_t count = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return count;
+}
+
+Volume Directory::volume() const
+{
+	if (db->isClosed())
+		return Volume();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT volume_id FROM directory WHERE id = ? AND volume_id IS NOT NULL;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	Volume volume;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		volume = Volume(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return volume;
+}
+
+int64_t Directory::totalCount() const
+{
+	if (db->isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT total_count FROM directory WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int64_t count = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return count;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+
+#include "app/database.h"
+#include "app/volume.h"
+
+/**
+ * A directory holding files, or one of its ancestors. Directories are
+ * created by File as files are added or moved and removed again once no
+ * file below them is left. Paths are absolute and use '/' as separator.
+ */
+struct Directory
+{
+public:
+	Directory();
+	Directory(int64_t id);
+	// returns the directory at path, creating it and any missing ancestors
+	static DBError ensure(const QString& path, Directory* out = nullptr);
+	static Directory fromPath(const QString& path);
+	static QList<Directory> roots();
+	/**
+	 * Moves every file stored under from, at any depth, to the same place
+	 * under to with a single UPDATE. Only the database changes, nothing is
+	 * read from disk. The ids of the moved files are appended to moved. to
+	 * may not lie inside from.
+	 */
+	static DBError relocate(const QString& from, const QString& to, QList<int64_t>* moved = nullptr);
+	// path of the containing directory, or a null string for a root
+	static QString parentPath(const QString& path);
+	bool exists() const;
+	int64_t id() const;
+	QString name() const;
+	QString path() const;
+	Directory parent() const;
+	QList<Directory> children() const;
+	// number of files directly inside
+	int64_t fileCount() const;
+	// number of files inside or in any subdirectory
+	int64_t totalCount() const;
+	// the file system it was on when created, invalid if not known
+	Volume volume() const;
+	bool operator==(const Directory& other) const
+	{
+		return this->id() == other.id();
+	}
+	bool operator!=(const Directory& other) const
+	{
+		return this->id() != other.id();
+	}
+
+private:
+	int64_t m_id;
+};
@@ -0,0 +1,194 @@
+#include "directorywalker.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+
+#include "app/globals.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// the layout getdents64 fills in, glibc does not export it
+struct LinuxDirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+#endif
+
+DirectoryWalker::DirectoryWalker(const WalkOptions& options, int threads)
+	: m_recursive(options.recursive)
+	, m_ignoreHidden(options.ignoreHidden)
+	, m_cancel(false)
+	, m_pending(0)
+{
+	m_pool.setMaxThreadCount(std::max(1, threads));
+	for (const QString& pattern : options.ignore)
+		if (!pattern.trimmed().isEmpty())
+			m_ignore.append(QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern.trimmed())
+				, QRegularExpression::CaseInsensitiveOption));
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+	cancel();
+	m_pool.waitForDone();
+}
+
+void DirectoryWalker::start(const QStringList& roots)
+{
+	QStringList files;
+	for (const QString& root : roots)
+	{
+		const QFileInfo info(root);
+		if (info.isDir())
+			enqueue(info.absoluteFilePath());
+		else if (info.isFile())
+			files.append(info.absoluteFilePath());
+	}
+	deliver(files);
+	// nothing to walk, wake a waiting take()
+	if (m_pending == 0)
+	{
+		QMutexLocker locker(&m_mutex);
+		m_changed.wakeAll();
+	}
+}
+
+bool DirectoryWalker::take(QStringList& out, int timeout)
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_found.isEmpty() && m_pending > 0)
+		m_changed.wait(&m_mutex, timeout);
+	const bool took = !m_found.isEmpty();
+	out.append(m_found);
+	m_found.clear();
+	return took || m_pending > 0;
+}
+
+void DirectoryWalker::cancel()
+{
+	m_cancel = true;
+	QMutexLocker locker(&m_mutex);
+	m_changed.wakeAll();
+}
+
+QStringList DirectoryWalker::walk(const QStringList& roots, const WalkOptions& options)
+{
+	DirectoryWalker walker(options);
+	walker.start(roots);
+	QStringList files;
+	while (walker.take(files, 1000))
+		;
+	return files;
+}
+
+void DirectoryWalker::enqueue(const QString& dir)
+{
+	++m_pending;
+	m_pool.start([this, dir]() -> void
+		{
+			if (!m_cancel)
+				readDirectory(dir);
+			// the last directory done ends the walk
+			if (--m_pending == 0)
+			{
+				QMutexLocker locker(&m_mutex);
+				m_changed.wakeAll();
+			}
+		});
+}
+
+void DirectoryWalker::readDirectory(const QString& dir)
+{
+	const QString prefix = dir.endsWith('/') ? dir : dir + '/';
+	QStringList files;
+#ifdef Q_OS_LINUX
+	const QByteArray dir_native = QFile::encodeName(dir);
+	const int fd = open(dir_native.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	alignas(LinuxDirent64) char buffer[64 * 1024];
+	long size;
+	while (!m_cancel && (size = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (long offset = 0; offset < size; )
+		{
+			const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(buffer + offset);
+			offset += entry->d_reclen;
+			const char* name = entry->d_name;
+			if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+				continue;
+			if (m_ignoreHidden && name[0] == '.')
+				continue;
+			const QString fileName = QFile::decodeName(name);
+			if (ignored(fileName))
+				continue;
+			unsigned char type = entry->d_type;
+			if (type == DT_UNKNOWN || type == DT_LNK)
+			{
+				// links count as what they point to, but directories are only
+				// entered through their real path
+				struct stat st;
+				if (fstatat(fd, name, &st, 0) != 0)
+					continue;
+				if (S_ISREG(st.st_mode))
+					type = DT_REG;
+				else if (S_ISDIR(st.st_mode) && entry->d_type != DT_LNK)
+					type = DT_DIR;
+				else
+					continue;
+			}
+			if (type == DT_REG)
+				files.append(prefix + fileName);
+			else if (type == DT_DIR && m_recursive)
+				enqueue(prefix + fileName);
+		}
+		if (files.size() >= 1024)
+			deliver(files);
+	}
+	close(fd);
+#else
+	QDir::Filters filters = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System;
+	if (!m_ignoreHidden)
+		filters |= QDir::Hidden;
+	QDirIterator it(dir, filters);
+	while (!m_cancel && it.hasNext())
+	{
+		const QFileInfo entry = it.nextFileInfo();
+		if (ignored(entry.fileName()))
+			continue;
+		if (entry.isFile())
+			files.append(prefix + entry.fileName());
+		else if (entry.isDir() && !entry.isSymLink() && m_recursive)
+			enqueue(prefix + entry.fileName());
+		if (files.size() >= 1024)
+			deliver(files);
+	}
+#endif
+	deliver(files);
+}
+
+bool DirectoryWalker::ignored(QStringView name) const
+{
+	for (const QRegularExpression& pattern : m_ignore)
+		if (pattern.matchView(name).hasMatch())
+			return true;
+	return false;
+}
+
+void DirectoryWalker::deliver(QStringList& files)
+{
+	if (files.isEmpty())
+		return;
+	QMutexLocker locker(&m_mutex);
+	m_found.append(files);
+	files.clear();
+	m_changed.wakeAll();
+}
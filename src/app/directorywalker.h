@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QMutex>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+
+struct WalkOptions
+{
+	bool recursive = true;
+	bool ignoreHidden = true;
+	// wildcard patterns matched against file and directory names
+	QStringList ignore;
+};
+
+/**
+ * Lists the files below a set of roots on a pool of threads, one task per
+ * directory, handing them out as they are found rather than after the whole
+ * tree was walked. On Linux directories are read with getdents64 and only
+ * entries of unknown type are stat'ed, elsewhere QDirIterator is used.
+ * Symbolic links to files are listed, links to directories not followed.
+ */
+class DirectoryWalker
+{
+public:
+	explicit DirectoryWalker(const WalkOptions& options, int threads = QThread::idealThreadCount());
+	// cancels the walk and waits for the threads
+	~DirectoryWalker();
+	void start(const QStringList& roots);
+	/**
+	 * Moves the files found since the last call into out, waiting up to
+	 * timeout milliseconds for more if there are none yet. Returns false
+	 * once the walk is over and everything was taken.
+	 */
+	bool take(QStringList& out, int timeout = 50);
+	void cancel();
+	// walks roots to the end on the calling thread's behalf
+	static QStringList walk(const QStringList& roots, const WalkOptions& options);
+
+private:
+	QThreadPool m_pool;
+	QList<QRegularExpression> m_ignore;
+	bool m_recursive;
+	bool m_ignoreHidden;
+	std::atomic_bool m_cancel;
+	// directories queued or being read
+	std::atomic_int m_pending;
+	QMutex m_mutex;
+	QWaitCondition m_changed;
+	QStringList m_found;
+	void enqueue(const QString& dir);
+	void readDirectory(const QString& dir);
+	bool ignored(QStringView name) const;
+	void deliver(QStringList& files);
+};
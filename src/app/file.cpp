@@ -1,8 +1,14 @@
 #include "file.h"
 
-#include <QCryptographicHash>
+#include <atomic>
+#include <vector>
 #include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QThreadPool>
+#include "app/bulkedit.h"
 #include "app/globals.h"
+#include "app/hashcache.h"
 
 File::File()
 	: m_id(-1)
@@ -12,6 +18,28 @@ File::File(int64_t id)
 	: m_id(id)
 {}
 
+File File::fromPath(const QString& path)
+{
+	if (db->isClosed())
+		return File();
+	QFileInfo fileInfo(path);
+	const char* sql = R"(
+		SELECT id FROM file
+		WHERE dir_id = (SELECT id FROM directory WHERE path = ?) AND name = ?;
+	)";
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	QByteArray dir_utf8 = fileInfo.dir().absolutePath().toUtf8();
+	QByteArray name_utf8 = fileInfo.fileName().toUtf8();
+	sqlite3_bind_text(stmt, 1, dir_utf8.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, name_utf8.constData(), -1, SQLITE_STATIC);
+	File file;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		file = File(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return file;
+}
+
 bool File::exists() const
 {
 	if (m_id < 0)
@@ -28,17 +56,21 @@ bool File::exists() const
 	return exists;
 }
 
-DBError File::create(const QString& path, const QString& alias, const QString& comment, const QString& source, File* out)
+DBError File::create(const QString& path, const QString& alias, const QString& comment, const QString& source, File* out
+	, const QByteArray& knownSha1)
 {
 	if (db->isClosed())
 		return DBError(DBError::DatabaseClosed);
 	QFileInfo fileInfo(path);
-	QByteArray sha1 = sha1Digest(path);
+	QByteArray sha1 = knownSha1.isNull() ? sha1Digest(path) : knownSha1;
 	if (sha1.isNull())
 		return DBError(DBError::FileIOError, "Failed to calculate SHA1 digest");
+	Directory directory;
+	if (DBError error = Directory::ensure(fileInfo.dir().absolutePath(), &directory))
+		return error;
 	const char* sql = R"(
-		INSERT INTO file(name, dir, alias, state, comment, source, sha1)
-		VALUES(?, ?, ?, ?, ?, ?, ?);
+		INSERT INTO file(name, dir, alias, state, comment, source, sha1, dir_id, size)
+		VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?);
 	)";
 	sqlite3_stmt* stmt;
 	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
@@ -54,6 +86,11 @@ DBError File::create(const QString& path, const QString& alias, const QString& c
 	sqlite3_bind_text(stmt, 5, comment_bytes.constData(), -1, SQLITE_STATIC);
 	sqlite3_bind_text(stmt, 6, source_bytes.constData(), -1, SQLITE_STATIC);
 	sqlite3_bind_blob(stmt, 7, sha1.constData(), SHA1_DIGEST_SIZE_BYTES, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 8, directory.id());
+	if (fileInfo.exists())
+		sqlite3_bind_int64(stmt, 9, fileInfo.size());
+	else
+		sqlite3_bind_null(stmt, 9);
 	int rc = sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
 	if (rc != SQLITE_DONE)
@@ -87,14 +124,20 @@ DBError File::remove() const
 CheckError File::check() const
 {
 	CheckError ok = CheckError();
-	QByteArray newChecksum = sha1Digest(path());
-	QByteArray oldChecksum = sha1();
-	if (!QFileInfo::exists(path()))
+	const QString path = this->path();
+	// a missing file is known from one stat, there is nothing to hash
+	if (!QFileInfo::exists(path))
 	{
 		if (DBError error = setState(FileMissing))
 			return CheckError(CheckError::Fail, u"Failed to update file state to FileMissing"_s, error);
+		updateChecked();
+		return ok;
 	}
-	else if (newChecksum.isEmpty())
+	// a check is asked for to catch what the identity cannot tell, so the
+	// contents are always read, and the cache corrected with them
+	QByteArray newChecksum = HashCache::instance()->refresh(path);
+	QByteArray oldChecksum = sha1();
+	if (newChecksum.isEmpty())
 	{
 		if (DBError error = setState(Error))
 			return CheckError(CheckError::Fail, u"Failed to update state to Error"_s, error);
@@ -106,8 +149,12 @@ CheckError File::check() const
 		ok.sha1 = oldChecksum;
 	}
 	else
+	{
 		if (DBError error = setState(Ok))
 			return CheckError(CheckError::Fail, u"Failed to set state back to Ok"_s, error);
+		// the contents are confirmed, so is their size
+		updateSize(QFileInfo(path).size());
+	}
 	updateChecked();
 	return ok;
 
@@ -115,21 +162,7 @@ CheckError File::check() const
 
 DBError File::setTags(const QList<Tag>& tags) const
 {
-	QSet<Tag> oldTags;
-	for (const FileTag& tag : this->tags())
-		oldTags.insert(Tag(tag.tagId()));
-	QSet<Tag> newTags(tags.begin(), tags.end());
-
-	QSet<Tag> toDelete = oldTags - newTags;
-	QSet<Tag> toInsert = newTags - oldTags;
-
-	for (const Tag& tag : toDelete.values())
-		if (DBError error = removeTag(tag))
-			return error;
-	for (const Tag& tag : toInsert)
-		if (DBError error = addTag(tag))
-			return error;
-	return DBError();
+	return FileEdit(*this).tags(tags).commit();
 }
 
 DBError File::addTag(const Tag& tag) const
@@ -170,18 +203,7 @@ DBError File::removeTag(const Tag& tag) const
 
 DBError File::setAlias(const QString& alias) const
 {
-	QByteArray alias_bytes = alias.trimmed().toUtf8();
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE file SET alias = ? WHERE id = ?;", -1, &stmt, nullptr);
-	sqlite3_bind_text(stmt, 1, alias_bytes.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 2, m_id);
-	int rc = sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	if (rc != SQLITE_DONE)
-		return DBError(rc);
-	if (DBError error = updateModified())
-		return error;
-	return DBError();
+	return FileEdit(*this).alias(alias).commit();
 }
 
 QString File::displayName() const
@@ -195,20 +217,7 @@ QString File::displayName() const
 
 DBError File::setPath(const QString& path) const
 {
-	QFileInfo file(path);
-	QByteArray name_utf8 = file.fileName().toUtf8();
-	QByteArray dir_utf8 = file.dir().absolutePath().toUtf8();
-	sqlite3_stmt* stmt;
-	const char* sql = "UPDATE file SET name = ?, dir = ? WHERE id = ?;";
-	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
-	sqlite3_bind_text(stmt, 1, name_utf8.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_text(stmt, 2, dir_utf8.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 3, m_id);
-	int rc = sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	if (rc != SQLITE_DONE)
-		return DBError(rc);
-	return DBError();
+	return FileEdit(*this).path(path).commit();
 }
 
 DBError File::setState(File::State state) const
@@ -228,56 +237,37 @@ DBError File::setState(File::State state) const
 
 DBError File::setComment(const QString& comment) const
 {
-	QByteArray comment_bytes = comment.trimmed().toUtf8();
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE file SET comment = ? WHERE id = ?;", -1, &stmt, nullptr);
-	sqlite3_bind_text(stmt, 1, comment_bytes.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 2, m_id);
-	int rc = sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	if (rc != SQLITE_DONE)
-		return DBError(rc);
-	if (DBError error = updateModified())
-		return error;
-	return DBError();
+	return FileEdit(*this).comment(comment).commit();
 }
 
 DBError File::setSource(const QString& source) const
 {
-	QByteArray source_bytes = source.trimmed().toUtf8(); // validation
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE file SET source = ? WHERE id = ?;", -1, &stmt, nullptr);
-	sqlite3_bind_text(stmt, 1, source_bytes.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 2, m_id);
-	int rc = sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	if (rc != SQLITE_DONE)
-		return DBError(rc);
-	if (DBError error = updateModified())
-		return error;
-	return DBError();
+	return FileEdit(*this).source(source).commit();
 }
 
 DBError File::setSHA1(const QByteArray& sha1) const
+{
+	return FileEdit(*this).sha1(sha1).commit();
+}
+
+DBError File::updateChecked() const
 {
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE file SET sha1 = ? WHERE id = ?;", -1, &stmt, nullptr);
-	sqlite3_bind_blob(stmt, 1, sha1, SHA1_DIGEST_SIZE_BYTES, SQLITE_STATIC);
+	sqlite3_prepare_v2(db->con(), "UPDATE file SET checked = ? WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, QDateTime::currentSecsSinceEpoch());
 	sqlite3_bind_int64(stmt, 2, m_id);
 	int rc = sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
 	if (rc != SQLITE_DONE)
 		return DBError(rc);
-	if (DBError error = updateModified())
-		return error;
 	return DBError();
 }
 
-DBError File::updateChecked() const
+DBError File::updateSize(int64_t size) const
 {
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE file SET checked = ? WHERE id = ?;", -1, &stmt, nullptr);
-	sqlite3_bind_int64(stmt, 1, QDateTime::currentSecsSinceEpoch());
+	sqlite3_prepare_v2(db->con(), "UPDATE file SET size = ? WHERE id = ? AND size IS NOT ?1;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, size);
 	sqlite3_bind_int64(stmt, 2, m_id);
 	int rc = sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
@@ -324,6 +314,25 @@ QString File::dir() const
 	return dir;
 }
 
+Volume File::volume() const
+{
+	return directory().volume();
+}
+
+Directory File::directory() const
+{
+	if (db->isClosed())
+		return Directory();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT dir_id FROM file WHERE id = ? AND dir_id IS NOT NULL;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	Directory directory;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		directory = Directory(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return directory;
+}
+
 QString File::alias() const
 {
 	if (db->isClosed())
@@ -394,6 +403,20 @@ QByteArray File::sha1() const
 	return sha1;
 }
 
+int64_t File::size() const
+{
+	if (db->isClosed())
+		return -1;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT size FROM file WHERE id = ? AND size IS NOT NULL;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int64_t size = -1;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		size = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return size;
+}
+
 QDateTime File::created() const
 {
 	if (db->isClosed())
@@ -474,19 +497,7 @@ QList<FileTag> File::tags() const
 
 QByteArray File::sha1Digest(const QString& path)
 {
-	QCryptographicHash hash(QCryptographicHash::Sha1);
-	QFile file(path);
-	if (!file.open(QIODevice::ReadOnly))
-		return QByteArray();
-	char buff[4096];
-	while (!file.atEnd())
-	{
-		qint64 bytes = file.read(buff, 4096);
-		if (bytes < 0)
-			return QByteArray();
-		hash.addData(buff, bytes);
-	}
-	return hash.result();
+	return HashCache::instance()->sha1(path);
 }
 
 int64_t File::countByState(File::State state)
@@ -503,6 +514,205 @@ int64_t File::countByState(File::State state)
 	return count;
 }
 
+FileEdit File::edit() const
+{
+	return FileEdit(*this);
+}
+
+DBError File::checkExistence(const QList<File>& files, int64_t* missing
+	, const std::function<bool(qsizetype)>& progress)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	ExistenceSweep sweep = ExistenceSweep::of(files);
+	sweep.probe(progress);
+	return sweep.apply(missing);
+}
+
+DBError File::checkAllExistence(int64_t* missing, const std::function<bool(qsizetype)>& progress)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	ExistenceSweep sweep = ExistenceSweep::all();
+	sweep.probe(progress);
+	return sweep.apply(missing);
+}
+
+QSet<int64_t> File::onVolumes(const QList<File>& files, const QSet<int64_t>& volumes)
+{
+	QSet<int64_t> on;
+	if (db->isClosed() || files.isEmpty() || volumes.isEmpty())
+		return on;
+	QJsonArray file_ids, volume_ids;
+	for (const File& file : files)
+		file_ids.append(file.id());
+	for (int64_t id : volumes)
+		volume_ids.append(id);
+	const QByteArray files_json = QJsonDocument(file_ids).toJson(QJsonDocument::Compact);
+	const QByteArray volumes_json = QJsonDocument(volume_ids).toJson(QJsonDocument::Compact);
+	const QByteArray sql = R"(
+		SELECT file.id FROM file
+		LEFT JOIN directory ON directory.id = file.dir_id
+		WHERE file.id IN (SELECT value FROM json_each(?))
+			AND )" + Volume::DIRECTORY_VOLUME_SQL + R"( IN (SELECT value FROM json_each(?));
+	)";
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), sql.constData(), -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, files_json.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, volumes_json.constData(), -1, SQLITE_STATIC);
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		on.insert(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return on;
+}
+
+ExistenceSweep ExistenceSweep::of(const QList<File>& files)
+{
+	if (db->isClosed())
+		return ExistenceSweep();
+	QJsonArray ids;
+	for (const File& file : files)
+		ids.append(file.id());
+	const QByteArray ids_json = QJsonDocument(ids).toJson(QJsonDocument::Compact);
+
+	sqlite3_stmt* stmt;
+	const QByteArray sql = R"(
+		SELECT file.id, file.dir, file.name, file.state, )" + Volume::DIRECTORY_VOLUME_SQL + R"(, file.sha1 FROM file
+		LEFT JOIN directory ON directory.id = file.dir_id
+		WHERE file.id IN (SELECT value FROM json_each(?));
+	)";
+	sqlite3_prepare_v2(db->con(), sql.constData(), -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, ids_json.constData(), -1, SQLITE_STATIC);
+	return load(stmt);
+}
+
+ExistenceSweep ExistenceSweep::all()
+{
+	if (db->isClosed())
+		return ExistenceSweep();
+	sqlite3_stmt* stmt;
+	// in directory order, so neighbouring stats tend to hit the same
+	// directory entries
+	const QByteArray sql = R"(
+		SELECT file.id, file.dir, file.name, file.state, )" + Volume::DIRECTORY_VOLUME_SQL + R"(, file.sha1 FROM file
+		LEFT JOIN directory ON directory.id = file.dir_id
+		ORDER BY file.dir_id;
+	)";
+	sqlite3_prepare_v2(db->con(), sql.constData(), -1, &stmt, nullptr);
+	return load(stmt);
+}
+
+ExistenceSweep ExistenceSweep::load(sqlite3_stmt* stmt)
+{
+	ExistenceSweep sweep;
+	sweep.m_mounts = Volume::mounts();
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		const QString dir = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1));
+		const QString name = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)), sqlite3_column_bytes(stmt, 2));
+		const File::State state = static_cast<File::State>(sqlite3_column_int(stmt, 3));
+		sweep.m_entries.push_back({
+			sqlite3_column_int64(stmt, 0),
+			QFileInfo(dir, name).filePath(),
+			state,
+			state == File::FileMissing
+				? QByteArray(static_cast<const char*>(sqlite3_column_blob(stmt, 5)), sqlite3_column_bytes(stmt, 5))
+				: QByteArray(),
+			-1,
+			state,
+			sqlite3_column_type(stmt, 4) != SQLITE_NULL ? sqlite3_column_int64(stmt, 4) : -1
+		});
+	}
+	sqlite3_finalize(stmt);
+	return sweep;
+}
+
+void ExistenceSweep::probe(const std::function<bool(qsizetype)>& progress)
+{
+	// stat in parallel with far more threads than cores, on a network mount
+	// nearly all of the time is spent waiting for the round trip. only files
+	// that were missing and are back are read, being there again says
+	// nothing about whether they are the same files. files on a volume that
+	// is not there are neither missing nor back, they are left as they are
+	const QSet<int64_t> offline = Volume::offline(m_mounts);
+	QThreadPool pool;
+	pool.setMaxThreadCount(THREADS);
+	std::atomic<qsizetype> done = 0;
+	std::atomic_bool canceled = false;
+	for (size_t begin = 0; begin < m_entries.size(); begin += CHUNK_SIZE)
+	{
+		const size_t end = std::min(m_entries.size(), begin + CHUNK_SIZE);
+		pool.start([this, &offline, &done, &canceled, begin, end]()
+		{
+			for (size_t i = begin; i < end && !canceled; ++i)
+			{
+				Entry& entry = m_entries[i];
+				++done;
+				if (offline.contains(entry.volume))
+					continue;
+				entry.exists = QFileInfo::exists(entry.path);
+				if (entry.exists > 0 && entry.state == File::FileMissing)
+				{
+					const QByteArray sha1 = File::sha1Digest(entry.path);
+					entry.found = sha1.isNull() ? File::Error : sha1 == entry.sha1 ? File::Ok : File::ChecksumChanged;
+				}
+			}
+		});
+	}
+	while (!pool.waitForDone(50))
+		if (progress && !progress(done))
+			canceled = true;
+	if (progress && !canceled)
+		progress(done);
+}
+
+DBError ExistenceSweep::apply(int64_t* missing) const
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	QJsonArray gone, back, unreadable, changed;
+	int64_t missingCount = 0;
+	for (const Entry& entry : m_entries)
+	{
+		if (entry.exists < 0)
+			continue;
+		if (!entry.exists)
+			++missingCount;
+		if (!entry.exists && entry.state != File::FileMissing)
+			gone.append(entry.id);
+		else if (entry.exists && entry.state == File::FileMissing)
+			(entry.found == File::Ok ? back : entry.found == File::Error ? unreadable : changed).append(entry.id);
+	}
+
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "UPDATE file SET state = ? WHERE id IN (SELECT value FROM json_each(?));", -1, &stmt, nullptr);
+	int rc = SQLITE_DONE;
+	for (const auto& [state, ids] : { std::pair{ File::FileMissing, gone }, std::pair{ File::Ok, back }
+		, std::pair{ File::Error, unreadable }, std::pair{ File::ChecksumChanged, changed } })
+	{
+		// in batches, so one statement never has to parse millions of ids
+		for (qsizetype i = 0; i < ids.size() && rc == SQLITE_DONE; i += BATCH_SIZE)
+		{
+			QJsonArray batch;
+			for (qsizetype j = i; j < std::min(ids.size(), i + BATCH_SIZE); ++j)
+				batch.append(ids[j]);
+			const QByteArray batch_json = QJsonDocument(batch).toJson(QJsonDocument::Compact);
+			sqlite3_bind_int(stmt, 1, state);
+			sqlite3_bind_text(stmt, 2, batch_json.constData(), -1, SQLITE_TRANSIENT);
+			rc = sqlite3_step(stmt);
+			sqlite3_reset(stmt);
+		}
+		if (rc != SQLITE_DONE)
+			break;
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	if (missing)
+		*missing = missingCount;
+	return DBError();
+}
+
 const QStringList File::stateString
 {
 	"Ok",
@@ -510,3 +720,128 @@ const QStringList File::stateString
 	"File missing",
 	"Checksum changed"
 };
+
+FileEdit::FileEdit(const File& file)
+	: m_file(file)
+{}
+
+FileEdit& FileEdit::path(const QString& path)
+{
+	m_path = path;
+	return *this;
+}
+
+FileEdit& FileEdit::alias(const QString& alias)
+{
+	m_alias = alias;
+	return *this;
+}
+
+FileEdit& FileEdit::comment(const QString& comment)
+{
+	m_comment = comment;
+	return *this;
+}
+
+FileEdit& FileEdit::source(const QString& source)
+{
+	m_source = source;
+	return *this;
+}
+
+FileEdit& FileEdit::sha1(const QByteArray& sha1)
+{
+	m_sha1 = sha1;
+	return *this;
+}
+
+FileEdit& FileEdit::tags(const QList<Tag>& tags)
+{
+	m_tags = tags;
+	return *this;
+}
+
+DBError FileEdit::commit()
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	sqlite3_stmt* stmt;
+	int rc;
+	bool modified = m_alias || m_comment || m_source || m_sha1;
+
+	if (m_tags)
+	{
+		QJsonArray ids;
+		for (const Tag& tag : *m_tags)
+			ids.append(tag.id());
+		const QByteArray tags_json = QJsonDocument(ids).toJson(QJsonDocument::Compact);
+		const QByteArray owner_json = QJsonDocument(QJsonArray{ static_cast<qint64>(m_file.id()) }).toJson(QJsonDocument::Compact);
+		bool changed;
+		if (DBError error = replaceLinks("file_tag", "file_id", "tag_id", owner_json, tags_json, &changed))
+			return error;
+		modified |= changed;
+	}
+
+	Directory directory;
+	QByteArray name_bytes, dir_bytes;
+	if (m_path)
+	{
+		QFileInfo file(*m_path);
+		if (DBError error = Directory::ensure(file.dir().absolutePath(), &directory))
+			return error;
+		name_bytes = file.fileName().toUtf8();
+		dir_bytes = file.dir().absolutePath().toUtf8();
+	}
+	if (!m_path && !modified)
+		return DBError();
+
+	QStringList columns;
+	if (modified)
+		columns.append(u"modified = ?"_s);
+	if (m_path)
+		columns.append(u"name = ?, dir = ?, dir_id = ?"_s);
+	if (m_alias)
+		columns.append(u"alias = ?"_s);
+	if (m_comment)
+		columns.append(u"comment = ?"_s);
+	if (m_source)
+		columns.append(u"source = ?"_s);
+	if (m_sha1)
+		columns.append(u"sha1 = ?, size = ?"_s);
+	const QByteArray alias_bytes = m_alias ? m_alias->trimmed().toUtf8() : QByteArray();
+	const QByteArray comment_bytes = m_comment ? m_comment->trimmed().toUtf8() : QByteArray();
+	const QByteArray source_bytes = m_source ? m_source->trimmed().toUtf8() : QByteArray();
+	const QByteArray sql = u"UPDATE file SET %1 WHERE id = ?;"_s.arg(columns.join(u", "_s)).toUtf8();
+	sqlite3_prepare_v2(db->con(), sql.constData(), -1, &stmt, nullptr);
+	int i = 1;
+	if (modified)
+		sqlite3_bind_int64(stmt, i++, QDateTime::currentSecsSinceEpoch());
+	if (m_path)
+	{
+		sqlite3_bind_text(stmt, i++, name_bytes.constData(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, i++, dir_bytes.constData(), -1, SQLITE_STATIC);
+		sqlite3_bind_int64(stmt, i++, directory.id());
+	}
+	if (m_alias)
+		sqlite3_bind_text(stmt, i++, alias_bytes.constData(), -1, SQLITE_STATIC);
+	if (m_comment)
+		sqlite3_bind_text(stmt, i++, comment_bytes.constData(), -1, SQLITE_STATIC);
+	if (m_source)
+		sqlite3_bind_text(stmt, i++, source_bytes.constData(), -1, SQLITE_STATIC);
+	if (m_sha1)
+	{
+		sqlite3_bind_blob(stmt, i++, m_sha1->constData(), m_sha1->size(), SQLITE_STATIC);
+		// a new digest is taken from the file on disk, so is its size
+		const QFileInfo file(m_path ? *m_path : m_file.path());
+		if (file.exists())
+			sqlite3_bind_int64(stmt, i++, file.size());
+		else
+			sqlite3_bind_null(stmt, i++);
+	}
+	sqlite3_bind_int64(stmt, i, m_file.id());
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
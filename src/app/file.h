@@ -4,11 +4,16 @@
 #include <QDir>
 #include <QHash>
 #include <QDateTime>
+#include <functional>
+#include <optional>
+#include <vector>
 
 #include "app/database.h"
+#include "app/directory.h"
 #include "app/error.h"
 #include "app/filetag.h"
 #include "app/tag.h"
+#include "app/volume.h"
 
 struct CheckError : public Error
 {
@@ -40,13 +45,18 @@ struct CheckError : public Error
 	QByteArray sha1;
 };
 
+class FileEdit;
+
 struct File
 {
 public:
 	File();
 	File(int64_t id);
+	// sha1 is the file's digest if already known, otherwise the file is read
 	static DBError create(const QString& path, const QString& alias = QString(), const QString& comment = QString()
-		, const QString& source = QString(), File* out = nullptr);
+		, const QString& source = QString(), File* out = nullptr, const QByteArray& sha1 = QByteArray());
+	// the file stored under path, or an invalid File
+	static File fromPath(const QString& path);
 	enum State
 	{
 		Ok = 0,
@@ -56,6 +66,28 @@ public:
 	};
 	static const QStringList stateString;
 	static int64_t countByState(File::State state);
+	// a null array if the file could not be read. unchanged files are
+	// answered from the HashCache
+	static QByteArray sha1Digest(const QString& path);
+	/**
+	 * Marks the files that are gone from disk as FileMissing without reading
+	 * anything. Missing files that are back are hashed and set to Ok,
+	 * ChecksumChanged or Error like check() would. Files on offline volumes
+	 * are skipped, see onVolumes(). progress is called with the number of files
+	 * looked at so far, returning false stops early. See ExistenceSweep to
+	 * do the looking on another thread.
+	 */
+	static DBError checkExistence(const QList<File>& files, int64_t* missing = nullptr
+		, const std::function<bool(qsizetype)>& progress = nullptr);
+	// the same over every file in the database
+	static DBError checkAllExistence(int64_t* missing = nullptr
+		, const std::function<bool(qsizetype)>& progress = nullptr);
+	/**
+	 * The ids of the files whose directory is on one of volumes, assigned or
+	 * going by Volume::DIRECTORY_VOLUME_SQL. This is how the files on
+	 * offline volumes are told apart for skipping.
+	 */
+	static QSet<int64_t> onVolumes(const QList<File>& files, const QSet<int64_t>& volumes);
 	//static QString stateString(State state);
 	bool exists() const;
 	CheckError check() const;
@@ -66,6 +98,8 @@ public:
 	DBError setAlias(const QString& alias) const;
 	QString path() const;
 	QString dir() const;
+	Directory directory() const;
+	Volume volume() const;
 	DBError setPath(const QString& path) const;
 	State state() const;
 	DBError setState(File::State state) const;
@@ -75,6 +109,8 @@ public:
 	DBError setSource(const QString& source) const;
 	QByteArray sha1() const;
 	DBError setSHA1(const QByteArray&) const;
+	// in bytes as of the last time the contents were read, -1 if unknown
+	int64_t size() const;
 	QDateTime created() const;
 	QDateTime modified() const;
 	QDateTime checked() const;
@@ -84,6 +120,8 @@ public:
 	DBError removeTag(const Tag& tag) const;
 	DBError setTags(const QList<Tag>& tags) const;
 	DBError remove() const;
+	// collects several changes to write at once, see FileEdit
+	FileEdit edit() const;
 	bool operator==(const File& other) const
 	{
 		return this->id() == other.id();
@@ -95,9 +133,77 @@ public:
 
 private:
 	static const int SHA1_DIGEST_SIZE_BYTES = 20;
-	static QByteArray sha1Digest(const QString& path);
 	int64_t m_id;
 	DBError updateModified() const;
+	DBError updateSize(int64_t size) const;
+};
+
+/**
+ * File::checkExistence() taken apart. The files are loaded and the states
+ * written on the thread that owns the connection, only probe() touches the
+ * disk and the volumes, so it may run on a thread of its own in between.
+ */
+class ExistenceSweep
+{
+public:
+	static ExistenceSweep of(const QList<File>& files);
+	static ExistenceSweep all();
+	// stats every file and hashes the missing ones that are back, progress
+	// as for File::checkExistence()
+	void probe(const std::function<bool(qsizetype)>& progress = nullptr);
+	// writes the states of the files probe() got to
+	DBError apply(int64_t* missing = nullptr) const;
+
+private:
+	struct Entry
+	{
+		int64_t id;
+		QString path;
+		File::State state;
+		// only kept for missing files, which are hashed if they are back
+		QByteArray sha1;
+		// -1 until looked at, then 0 or 1
+		int8_t exists;
+		// the state a file that came back is found in
+		File::State found;
+		// -1 if no volume covers its directory
+		int64_t volume;
+	};
+	static const int THREADS = 64;
+	static const int CHUNK_SIZE = 256;
+	static const int BATCH_SIZE = 10000;
+	std::vector<Entry> m_entries;
+	// probed by probe(), so the wait for them is not on the caller of load()
+	QList<Volume::Mount> m_mounts;
+	static ExistenceSweep load(sqlite3_stmt* stmt);
+};
+
+/**
+ * Changes to one file, written by commit() as a single UPDATE plus a
+ * set-based diff of the tags, with modified stamped once. Fields that are
+ * not set are left alone, and moving the file alone does not count as a
+ * modification.
+ */
+class FileEdit
+{
+public:
+	explicit FileEdit(const File& file);
+	FileEdit& path(const QString& path);
+	FileEdit& alias(const QString& alias);
+	FileEdit& comment(const QString& comment);
+	FileEdit& source(const QString& source);
+	FileEdit& sha1(const QByteArray& sha1);
+	FileEdit& tags(const QList<Tag>& tags);
+	DBError commit();
+
+private:
+	File m_file;
+	std::optional<QString> m_path;
+	std::optional<QString> m_alias;
+	std::optional<QString> m_comment;
+	std::optional<QString> m_source;
+	std::optional<QByteArray> m_sha1;
+	std::optional<QList<Tag>> m_tags;
 };
 
 namespace std
@@ -0,0 +1,138 @@
+#include "filenametokenizer.h"
+
+#include <QList>
+#include <QString>
+#include <algorithm>
+
+namespace
+{
+	enum CharClass { Lower, Upper, Digit };
+
+	struct CodePoint
+	{
+		char32_t value;
+		CharClass type;
+		// byte range in the UTF-8 input
+		int start;
+		int end;
+	};
+
+	CharClass classify(char32_t c)
+	{
+		if (QChar::isDigit(c))
+			return Digit;
+		if (QChar::isUpper(c) || QChar::isTitleCase(c))
+			return Upper;
+		// letters without case are grouped with lower case ones
+		return Lower;
+	}
+
+	// true if a new part starts at i
+	bool isBoundary(const QList<CodePoint>& word, qsizetype i)
+	{
+		if (i == 0)
+			return false;
+		const CharClass prev = word.at(i - 1).type;
+		const CharClass curr = word.at(i).type;
+		if ((prev == Digit) != (curr == Digit))
+			return true;
+		// fooBar
+		if (prev == Lower && curr == Upper)
+			return true;
+		// HTMLParser splits before the P
+		if (prev == Upper && curr == Upper && i + 1 < word.size() && word.at(i + 1).type == Lower)
+			return true;
+		return false;
+	}
+
+	QByteArray lowerUtf8(const QList<CodePoint>& word, qsizetype from, qsizetype to)
+	{
+		QString s;
+		for (qsizetype i = from; i < to; ++i)
+			s.append(QString::fromUcs4(&word.at(i).value, 1));
+		return s.toLower().toUtf8();
+	}
+}
+
+int FilenameTokenizer::install(sqlite3* con)
+{
+	fts5_api* api = nullptr;
+	sqlite3_stmt* stmt;
+	int rc = sqlite3_prepare_v2(con, "SELECT fts5(?);", -1, &stmt, nullptr);
+	if (rc != SQLITE_OK)
+		return rc;
+	sqlite3_bind_pointer(stmt, 1, &api, "fts5_api_ptr", nullptr);
+	sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (api == nullptr)
+		return SQLITE_ERROR;
+	static fts5_tokenizer tokenizer{ &FilenameTokenizer::create, &FilenameTokenizer::destroy, &FilenameTokenizer::tokenize };
+	return api->xCreateTokenizer(api, "filename", nullptr, &tokenizer, nullptr);
+}
+
+int FilenameTokenizer::create(void* context, const char** args, int argCount, Fts5Tokenizer** out)
+{
+	// stateless, so every table shares one dummy instance
+	static char instance;
+	if (argCount > 0)
+		return SQLITE_ERROR;
+	*out = reinterpret_cast<Fts5Tokenizer*>(&instance);
+	return SQLITE_OK;
+}
+
+void FilenameTokenizer::destroy(Fts5Tokenizer* tokenizer)
+{}
+
+int FilenameTokenizer::tokenize(Fts5Tokenizer* tokenizer, void* context, int flags, const char* text, int size
+	, int (*token)(void* context, int flags, const char* token, int size, int start, int end))
+{
+	// whole words are only indexed, a query for one is split into the same
+	// parts as the document and matched as a phrase
+	const bool indexWholeWords = !(flags & FTS5_TOKENIZE_QUERY);
+	const QString decoded = QString::fromUtf8(text, size);
+	QList<CodePoint> word;
+
+	auto flush = [&]() -> int
+		{
+			if (word.isEmpty())
+				return SQLITE_OK;
+			qsizetype from = 0;
+			bool first = true;
+			for (qsizetype i = 1; i <= word.size(); ++i)
+			{
+				if (i < word.size() && !isBoundary(word, i))
+					continue;
+				const QByteArray part = lowerUtf8(word, from, i);
+				int rc = token(context, 0, part.constData(), part.size(), word.at(from).start, word.at(i - 1).end);
+				if (rc != SQLITE_OK)
+					return rc;
+				if (first && i < word.size() && indexWholeWords)
+				{
+					const QByteArray whole = lowerUtf8(word, 0, word.size());
+					rc = token(context, FTS5_TOKEN_COLOCATED, whole.constData(), whole.size(), word.first().start, word.last().end);
+					if (rc != SQLITE_OK)
+						return rc;
+				}
+				first = false;
+				from = i;
+			}
+			word.clear();
+			return SQLITE_OK;
+		};
+
+	int offset = 0;
+	for (qsizetype i = 0; i < decoded.size(); ++i)
+	{
+		char32_t c = decoded.at(i).unicode();
+		if (QChar::isHighSurrogate(c) && i + 1 < decoded.size() && decoded.at(i + 1).isLowSurrogate())
+			c = QChar::surrogateToUcs4(decoded.at(i).unicode(), decoded.at(++i).unicode());
+		const int bytes = c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+		const int end = std::min(offset + bytes, size);
+		if (QChar::isLetterOrNumber(c))
+			word.append({ c, classify(c), offset, end });
+		else if (int rc = flush(); rc != SQLITE_OK)
+			return rc;
+		offset = end;
+	}
+	return flush();
+}
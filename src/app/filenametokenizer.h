@@ -0,0 +1,24 @@
+#pragma once
+
+#include "sqlite3.h"
+
+/**
+ * FTS5 tokenizer for file names. Words are split on punctuation, case
+ * changes and digit runs, so holiday_beach-2021.JPG and HolidayBeach2021
+ * both index as holiday, beach and 2021. When a word is split, the whole
+ * word is indexed at the same position so it can still be searched as one.
+ *
+ * Registered as "filename" and must be installed on every connection that
+ * reads or writes file_search.
+ */
+class FilenameTokenizer
+{
+public:
+	static int install(sqlite3* con);
+
+private:
+	static int create(void* context, const char** args, int argCount, Fts5Tokenizer** out);
+	static void destroy(Fts5Tokenizer* tokenizer);
+	static int tokenize(Fts5Tokenizer* tokenizer, void* context, int flags, const char* text, int size
+		, int (*token)(void* context, int flags, const char* token, int size, int start, int end));
+};
@@ -0,0 +1,164 @@
+#include "fuzzymatcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+FuzzyMatcher::FuzzyMatcher()
+{}
+
+void FuzzyMatcher::clear()
+{
+	m_entries.clear();
+	m_postings.clear();
+	m_counts.clear();
+}
+
+void FuzzyMatcher::insert(int64_t id, const QString& text)
+{
+	const int index = static_cast<int>(m_entries.size());
+	m_entries.push_back({ id, text });
+	QList<quint64> grams = trigrams(text);
+	std::sort(grams.begin(), grams.end());
+	grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+	for (quint64 gram : grams)
+		m_postings[gram].push_back(index);
+}
+
+void FuzzyMatcher::squeeze()
+{
+	for (auto it = m_postings.begin(); it != m_postings.end(); ++it)
+		it->shrink_to_fit();
+	m_counts.assign(m_entries.size(), 0);
+}
+
+QList<FuzzyMatcher::Match> FuzzyMatcher::search(const QString& query, int maxDistance) const
+{
+	QList<Match> matches;
+	if (query.isEmpty() || m_entries.empty())
+		return matches;
+	QList<quint64> grams = trigrams(query);
+	std::sort(grams.begin(), grams.end());
+	grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+	// every edit touches at most three of the query's trigram positions, so a
+	// match keeps at least this many of its distinct trigrams
+	const qsizetype required = grams.size() - 3 * maxDistance;
+	if (required <= 0)
+	{
+		// the filter cannot rule anything out, but queries this short are
+		// cheap to compare against every entry of a similar length
+		for (const Entry& entry : m_entries)
+			if (std::abs(entry.text.size() - query.size()) <= maxDistance)
+				if (int d = distance(query, entry.text); d <= maxDistance)
+					matches.append({ entry.id, d });
+		return matches;
+	}
+
+	m_counts.resize(m_entries.size(), 0);
+	std::vector<int> touched;
+	for (quint64 gram : grams)
+	{
+		auto it = m_postings.constFind(gram);
+		if (it == m_postings.cend())
+			continue;
+		for (int index : *it)
+			if (m_counts[index]++ == 0)
+				touched.push_back(index);
+	}
+	for (int index : touched)
+	{
+		const Entry& entry = m_entries[index];
+		if (m_counts[index] >= required && std::abs(entry.text.size() - query.size()) <= maxDistance)
+			if (int d = distance(query, entry.text); d <= maxDistance)
+				matches.append({ entry.id, d });
+		m_counts[index] = 0;
+	}
+	return matches;
+}
+
+int FuzzyMatcher::defaultDistance(qsizetype length)
+{
+	if (length <= 2)
+		return 0;
+	if (length <= 5)
+		return 1;
+	return 2;
+}
+
+int FuzzyMatcher::distance(QStringView a, QStringView b)
+{
+	if (a.size() < b.size())
+		std::swap(a, b);
+	if (b.isEmpty())
+		return static_cast<int>(a.size());
+	// the pattern has to fit in one machine word
+	if (b.size() <= 64)
+		return myers(b, a);
+	return dynamic(a, b);
+}
+
+QList<quint64> FuzzyMatcher::trigrams(QStringView text)
+{
+	// padded with two spaces on each side, which never appear in a tag name,
+	// so the start and end of the text form trigrams of their own
+	const qsizetype n = text.size() + 4;
+	auto at = [&text](qsizetype i) -> quint64
+		{
+			return (i < 2 || i >= text.size() + 2) ? u' ' : text.at(i - 2).unicode();
+		};
+	QList<quint64> grams;
+	grams.reserve(n - 2);
+	for (qsizetype i = 0; i + 2 < n; ++i)
+		grams.append(at(i) << 32 | at(i + 1) << 16 | at(i + 2));
+	return grams;
+}
+
+int FuzzyMatcher::myers(QStringView pattern, QStringView text)
+{
+	// Hyyrö's formulation of Myers' algorithm for the global edit distance
+	const qsizetype m = pattern.size();
+	QHash<char16_t, quint64> peq;
+	for (qsizetype i = 0; i < m; ++i)
+		peq[pattern.at(i).unicode()] |= quint64(1) << i;
+	const quint64 last = quint64(1) << (m - 1);
+	quint64 pv = ~quint64(0);
+	quint64 mv = 0;
+	int score = static_cast<int>(m);
+	for (QChar c : text)
+	{
+		const quint64 eq = peq.value(c.unicode(), 0);
+		const quint64 xv = eq | mv;
+		const quint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+		quint64 ph = mv | ~(xh | pv);
+		quint64 mh = pv & xh;
+		if (ph & last)
+			++score;
+		else if (mh & last)
+			--score;
+		// the top row counts up by one per column
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+	}
+	return score;
+}
+
+int FuzzyMatcher::dynamic(QStringView a, QStringView b)
+{
+	std::vector<int> row(b.size() + 1);
+	for (qsizetype j = 0; j <= b.size(); ++j)
+		row[j] = static_cast<int>(j);
+	for (qsizetype i = 1; i <= a.size(); ++i)
+	{
+		int diagonal = row[0];
+		row[0] = static_cast<int>(i);
+		for (qsizetype j = 1; j <= b.size(); ++j)
+		{
+			const int above = row[j];
+			row[j] = std::min({ above + 1, row[j - 1] + 1, diagonal + (a.at(i - 1) == b.at(j - 1) ? 0 : 1) });
+			diagonal = above;
+		}
+	}
+	return row[b.size()];
+}
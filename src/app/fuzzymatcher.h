@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <vector>
+
+/**
+ * Finds strings within a small edit distance of a query. Candidates are
+ * gathered from a trigram index and only those sharing enough trigrams with
+ * the query are checked with an exact (bit-parallel) Levenshtein distance.
+ */
+class FuzzyMatcher
+{
+public:
+	struct Match
+	{
+		int64_t id;
+		int distance;
+	};
+	FuzzyMatcher();
+	void clear();
+	void insert(int64_t id, const QString& text);
+	void squeeze();
+	/**
+	 * Returns every entry within maxDistance edits of query, unordered. The
+	 * entry equal to the query, if any, is included with a distance of 0.
+	 */
+	QList<Match> search(const QString& query, int maxDistance) const;
+	// the number of typos tolerated for a query of this length
+	static int defaultDistance(qsizetype length);
+	static int distance(QStringView a, QStringView b);
+
+private:
+	struct Entry
+	{
+		int64_t id;
+		QString text;
+	};
+	std::vector<Entry> m_entries;
+	// entry indexes containing each padded trigram, in ascending order
+	QHash<quint64, std::vector<int>> m_postings;
+	// scratch counters for search, one per entry
+	mutable std::vector<quint16> m_counts;
+	static QList<quint64> trigrams(QStringView text);
+	static int myers(QStringView pattern, QStringView text);
+	static int dynamic(QStringView a, QStringView b);
+};
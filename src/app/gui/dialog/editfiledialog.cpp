@@ -39,27 +39,31 @@ EditFileDialog::~EditFileDialog()
 void EditFileDialog::accept()
 {
 	DBError error;
-	db->begin();
+	// every tag added or removed would re-index the file on its own
+	if (error = db->beginBulk())
+	{
+		QMessageBox::warning(this, qApp->applicationName()
+			, tr("Failed to update file: ") + error.message());
+		return;
+	}
 
 	QFileInfo newPath(QDir(m_ui->lineEdit_dir->text()), m_ui->lineEdit_fileName->text());
+	const bool moved = newPath.absoluteFilePath() != m_file.path();
 
-	if (newPath.absoluteFilePath() != m_file.path())
-	{
-		if (error = m_file.setPath(newPath.absoluteFilePath()))
-			goto error;
-		m_file.check();
-	}
+	FileEdit edit = m_file.edit();
+	if (moved)
+		edit.path(newPath.absoluteFilePath());
 	if (m_ui->lineEdit_alias->text() != m_file.alias())
-		if (error = m_file.setAlias(m_ui->lineEdit_alias->text()))
-			goto error;
+		edit.alias(m_ui->lineEdit_alias->text());
 	if (m_ui->plainTextEdit_comment->toPlainText() != m_file.comment())
-		if (error = m_file.setComment(m_ui->plainTextEdit_comment->toPlainText()))
-			goto error;
+		edit.comment(m_ui->plainTextEdit_comment->toPlainText());
 	if (m_ui->lineEdit_source->text() != m_file.source())
-		if (error = m_file.setSource(m_ui->lineEdit_source->text()))
-			goto error;
-	if (error = m_file.setTags(m_ui->tagSelect->tags()))
+		edit.source(m_ui->lineEdit_source->text());
+	edit.tags(m_ui->tagSelect->tags());
+	if (error = edit.commit())
 		goto error;
+	if (moved)
+		m_file.check();
 	db->commit();
 	return QDialog::accept();
 
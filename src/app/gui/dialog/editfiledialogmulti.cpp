@@ -4,6 +4,8 @@
 #include <QFileDialog>
 #include <QMessageBox>
 
+#include "app/bulkedit.h"
+
 EditFileDialogMulti::EditFileDialogMulti(const QList<File>& files, QWidget* parent)
 	: QDialog(parent)
 	, m_ui(new Ui::EditFileDialogMulti)
@@ -37,39 +39,38 @@ EditFileDialogMulti::~EditFileDialogMulti()
 
 void EditFileDialogMulti::accept()
 {
-	db->begin();
+	// moved files are only looked for on disk, only those that were missing
+	// are hashed again
 	DBError error;
+	if (error = db->beginBulk())
+	{
+		QMessageBox::warning(this, qApp->applicationName()
+			, tr("Failed to update files: ") + error.message());
+		return;
+	}
+	FileBulkEdit edit(m_files);
 	if (m_ui->directoryCheckBox->isChecked())
 	{
-		for (const File& file : m_files)
-		{
-			QString dir = m_ui->directory->text();
-			QString fileName = QFileInfo(file.path()).fileName();
-			if (error = file.setPath(QFileInfo(dir, fileName).absoluteFilePath()))
-				goto error;
-			file.check();
-		}
+		if (error = edit.setDirectory(m_ui->directory->text()))
+			goto error;
+		if (error = File::checkExistence(m_files))
+			goto error;
 	}
 	if (m_ui->aliasCheckBox->isChecked())
-		for (const File& file : m_files)
-			if (error = file.setAlias(m_ui->alias->text()))
-				goto error;
+		if (error = edit.setAlias(m_ui->alias->text()))
+			goto error;
 	if (m_ui->sourceCheckBox->isChecked())
-		for (const File& file : m_files)
-			if (error = file.setSource(m_ui->source->text()))
-				goto error;
+		if (error = edit.setSource(m_ui->source->text()))
+			goto error;
 	if (m_ui->commentCheckBox->isChecked())
-		for (const File& file : m_files)
-			if (error = file.setComment(m_ui->comment->toPlainText()))
-				goto error;
-	for (const Tag& tag : m_ui->tagSelectRemove->tags())
-		for (const File& file : m_files)
-			if (error = file.removeTag(tag))
-				goto error;
-	for (const Tag& tag : m_ui->tagSelectAdd->tags())
-		for (const File& file : m_files)
-			if (error = file.addTag(tag))
-				goto error;
+		if (error = edit.setComment(m_ui->comment->toPlainText()))
+			goto error;
+	if (error = edit.removeTags(m_ui->tagSelectRemove->tags()))
+		goto error;
+	if (error = edit.addTags(m_ui->tagSelectAdd->tags()))
+		goto error;
+	if (error = edit.finish())
+		goto error;
 	db->commit();
 	return QDialog::accept();
 
@@ -29,15 +29,15 @@ void EditTagDialog::accept()
 {
 	db->begin();
 	DBError error;
+	TagEdit edit = m_tag.edit();
 	if (m_ui->name->text() != m_tag.name())
-		if (error = m_tag.setName(m_ui->name->text()))
-			goto error;
+		edit.name(m_ui->name->text());
 	if (m_ui->description->toPlainText() != m_tag.description())
-		if (error = m_tag.setDescription(m_ui->description->toPlainText()))
-			goto error;
+		edit.description(m_ui->description->toPlainText());
 	if (m_ui->urls->values() != m_tag.urls())
-		if (error = m_tag.setURLs(m_ui->urls->values()))
-			goto error;
+		edit.urls(m_ui->urls->values());
+	if (error = edit.commit())
+		goto error;
 	db->commit();
 	return QDialog::accept();
 
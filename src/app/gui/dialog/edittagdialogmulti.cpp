@@ -3,6 +3,8 @@
 
 #include <QMessageBox>
 
+#include "app/bulkedit.h"
+
 EditTagDialogMulti::EditTagDialogMulti(const QList<Tag>& tags, QWidget* parent)
 	: QDialog(parent)
 	, m_ui(new Ui::EditTagDialogMulti)
@@ -32,15 +34,16 @@ EditTagDialogMulti::~EditTagDialogMulti()
 void EditTagDialogMulti::accept()
 {
 	db->begin();
+	TagBulkEdit edit(m_tags);
 	DBError error;
 	if (m_ui->descriptionGroup->isChecked())
-		for (const Tag& tag : m_tags)
-			if (error = tag.setDescription(m_ui->description->toPlainText()))
-				goto error;
+		if (error = edit.setDescription(m_ui->description->toPlainText()))
+			goto error;
 	if (m_ui->urlsGroup->isChecked())
-		for (const Tag& tag : m_tags)
-			if (error = tag.setURLs(m_ui->urls->values()))
-				goto error;
+		if (error = edit.setURLs(m_ui->urls->values()))
+			goto error;
+	if (error = edit.finish())
+		goto error;
 	db->commit();
 	return QDialog::accept();
 
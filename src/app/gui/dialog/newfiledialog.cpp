@@ -5,7 +5,13 @@
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QProgressDialog>
+#include <memory>
+#include "app/bulkedit.h"
+#include "app/directorywalker.h"
 #include "app/file.h"
+#include "app/importfilter.h"
+#include "app/importjob.h"
+#include "app/writebatcher.h"
 #include "app/globals.h"
 
 NewFileDialog::NewFileDialog(QWidget* parent, Qt::WindowFlags f)
@@ -59,64 +65,147 @@ void NewFileDialog::accept()
 	if (!m_ui->path->text().trimmed().isEmpty())
 		paths.insert(0, m_ui->path->text());
 
-	QDir::Filters filters = QDir::AllEntries | QDir::NoDotAndDotDot;
-	if (!m_ui->ignoreHidden->isChecked())
-		filters |= QDir::Hidden;
-	QStringList filePathList;
-	for (const QString& path : paths)
+	ImportOptions options;
+	options.alias = m_ui->alias->text();
+	options.comment = m_ui->comment->toPlainText();
+	options.source = m_ui->source->text();
+	options.tags = m_ui->tagSelect->tags();
+	options.recursive = m_ui->recursive_checkBox->isChecked();
+	options.ignoreHidden = m_ui->ignoreHidden->isChecked();
+	for (const QString& pattern : m_ui->ignore->text().split(';', Qt::SkipEmptyParts))
+		options.ignore.append(pattern.trimmed());
+	options.duplicates = static_cast<ImportOptions::DuplicatePolicy>(m_ui->duplicates->currentIndex());
+	ImportJob job;
+	if (DBError error = db->beginBulk())
 	{
-		if (QFileInfo(path).isFile())
-			filePathList.append(path);
-		else
-			walkDirectory(path, filters, m_ui->recursive_checkBox->isChecked(), filePathList);
+		QMessageBox::warning(this, tr("Failed to add files"), error.message());
+		return;
 	}
-
-	if (filePathList.size() > 128)
+	if (DBError error = ImportJob::create(paths, options, &job))
 	{
-		QMessageBox::StandardButton btn = QMessageBox::question(this, tr("Confirm action")
-			, tr("This action will import %1 files, and may take some time. Continue?").arg(QLocale().toString(filePathList.size())));
-		if (btn != QMessageBox::Yes)
-			return;
+		db->rollback();
+		QMessageBox::warning(this, tr("Failed to add files"), error.message());
+		return;
 	}
+	db->commit();
+	if (runImport(job, this))
+		return QDialog::accept();
+}
 
-	QProgressDialog progress(tr("Adding files..."), tr("Abort"), 0, filePathList.size(), this);
+bool NewFileDialog::runImport(const ImportJob& job, QWidget* parent)
+{
+	const ImportOptions options = job.options();
+	int64_t done = job.cursor();
+	int64_t total = job.total();
+	QProgressDialog progress(tr("Adding files..."), tr("Abort"), 0, total, parent);
 	progress.setWindowModality(Qt::ApplicationModal);
-		
-	db->begin();
-	DBError error;
-	for (int i = 0; i < filePathList.size(); ++i)
+
+	// files that fail, e.g. because they are already stored, are skipped. the
+	// cursor is saved with every chunk, so aborting keeps what was added and
+	// the rest can be resumed later
+	ImportFilter filter(total - done);
+	WriteBatcher batcher;
+	batcher.setCheckpoint([&job, &done]() -> DBError { return job.setCursor(done); });
+	bool aborted = false;
+
+	// files are added while the walk goes on. a walk that was interrupted
+	// starts over, the files it added already are skipped by the filter
+	std::unique_ptr<DirectoryWalker> walker;
+	if (!job.walked())
 	{
-		QString& filePath = filePathList[i];
-		progress.setValue(i);
-		progress.setLabelText(tr("Adding file: %1").arg(
-			filePath.size() > 32
-				? filePath.first(8) + u"..."_s + filePath.last(24)
-				: filePath
-		));
-		if (progress.wasCanceled())
-			goto error;
-		File file;
-		if (error = File::create(filePath, m_ui->alias->text(), m_ui->comment->toPlainText(), m_ui->source->text(), &file))
-			continue;
-		if (error = file.setTags(m_ui->tagSelect->tags()))
+		if (DBError error = batcher.write([&job]() -> DBError { return job.clearPending(); }))
+		{
+			QMessageBox::warning(parent, tr("Failed to add files"), error.message());
+			return false;
+		}
+		total = done;
+		walker = std::make_unique<DirectoryWalker>(WalkOptions{ options.recursive, options.ignoreHidden, options.ignore });
+		walker->start(job.roots());
+	}
+	while (!aborted)
+	{
+		const QList<std::pair<int64_t, QString>> paths = job.paths(done, IMPORT_PAGE_SIZE);
+		if (paths.isEmpty())
+		{
+			if (!walker)
+				break;
+			QStringList found;
+			const bool more = walker->take(found);
+			DBError error = batcher.write([&]() -> DBError
+				{
+					if (DBError appendError = job.appendPaths(found))
+						return appendError;
+					return more ? DBError() : job.setWalked();
+				});
+			if (error)
+			{
+				QMessageBox::warning(parent, tr("Failed to add files"), error.message());
+				aborted = true;
+			}
+			if (!more)
+				walker.reset();
+			total += found.size();
+			progress.setMaximum(total);
+			progress.setLabelText(tr("Looking for files..."));
+			progress.setValue(done);
+			if (progress.wasCanceled())
+				aborted = true;
 			continue;
+		}
+		for (const auto& [seq, filePath] : paths)
+		{
+			progress.setValue(done);
+			progress.setLabelText(tr("Adding file: %1").arg(
+				filePath.size() > 32
+					? filePath.first(8) + u"..."_s + filePath.last(24)
+					: filePath
+			));
+			if (progress.wasCanceled())
+			{
+				aborted = true;
+				break;
+			}
+			done = seq;
+			// stored paths are skipped before the file is read
+			if (filter.knownPath(filePath))
+				continue;
+			batcher.write([&]() -> DBError
+				{
+					const QByteArray sha1 = File::sha1Digest(filePath);
+					if (sha1.isNull())
+						return DBError(DBError::FileIOError, "Failed to calculate SHA1 digest");
+					if (options.duplicates != ImportOptions::ImportDuplicates)
+						if (File duplicate = filter.duplicateOf(sha1); duplicate.id() >= 0)
+						{
+							if (options.duplicates == ImportOptions::SkipDuplicates)
+								return DBError();
+							FileBulkEdit edit({ duplicate });
+							if (DBError error = edit.addTags(options.tags))
+								return error;
+							return edit.finish();
+						}
+					File file;
+					if (DBError error = File::create(filePath, options.alias, options.comment, options.source, &file, sha1))
+						return error;
+					filter.add(filePath, sha1);
+					return file.setTags(options.tags);
+				});
+		}
 	}
-	progress.setValue(filePathList.size());
-	db->commit();
-	return QDialog::accept();
-
-error:
-	db->rollback();
-	QMessageBox::warning(this, tr("Failed to add files"), error.message());
-}
-
-void NewFileDialog::walkDirectory(const QDir& dir, QDir::Filters filters, bool recursive, QStringList& paths)
-{
-	for (QFileInfo entry : dir.entryInfoList(filters, QDir::Name | QDir::DirsFirst))
+	if (DBError error = batcher.finish())
 	{
-		if (entry.isFile())
-			paths.append(entry.absoluteFilePath());
-		else if (recursive)
-			walkDirectory(QDir(entry.absoluteFilePath()), filters, recursive, paths);
+		QMessageBox::warning(parent, tr("Failed to add files"), error.message());
+		return false;
 	}
+	progress.setValue(total);
+	if (aborted)
+		return false;
+	db->begin();
+	if (job.remove())
+		db->rollback();
+	else
+		db->commit();
+	return true;
 }
+
+const int NewFileDialog::IMPORT_PAGE_SIZE = 1000;
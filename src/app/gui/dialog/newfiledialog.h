@@ -1,7 +1,8 @@
 #pragma once
 
 #include <QDialog>
-#include <QDir>
+
+#include "app/importjob.h"
 
 namespace Ui
 {
@@ -15,6 +16,8 @@ class NewFileDialog : public QDialog
 public:
 	explicit NewFileDialog(QWidget* parent = nullptr, Qt::WindowFlags = { 0 });
 	virtual ~NewFileDialog() override;
+	// adds the files of job that are still left, returns false if aborted
+	static bool runImport(const ImportJob& job, QWidget* parent = nullptr);
 
 private slots:
 	void accept() override;
@@ -22,6 +25,6 @@ private slots:
 	void openFileDialog_dir();
 
 private:
+	static const int IMPORT_PAGE_SIZE;
 	Ui::NewFileDialog* m_ui;
-	static void walkDirectory(const QDir& dir, QDir::Filters filters, bool recursive, QStringList& paths);
 };
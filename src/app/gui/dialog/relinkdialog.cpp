@@ -0,0 +1,75 @@
+#include "relinkdialog.h"
+#include "ui_relinkdialog.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QProgressDialog>
+
+#include "app/file.h"
+#include "app/relinker.h"
+
+RelinkDialog::RelinkDialog(QWidget* parent, Qt::WindowFlags f)
+	: QDialog(parent, f)
+	, m_ui(new Ui::RelinkDialog)
+{
+	m_ui->setupUi(this);
+	m_ui->missing->setText(tr("%n file(s) are missing.", nullptr, static_cast<int>(File::countByState(File::FileMissing))));
+
+	connect(m_ui->buttonBox, &QDialogButtonBox::accepted, this, &RelinkDialog::accept);
+	connect(m_ui->buttonBox, &QDialogButtonBox::rejected, this, &RelinkDialog::reject);
+	connect(m_ui->btnChooseRoot, &QPushButton::clicked, this, [this]() -> void
+		{
+			const QString dir = QFileDialog::getExistingDirectory(this, QString(), m_ui->root->text());
+			if (!dir.isEmpty())
+				m_ui->root->setText(dir);
+		});
+}
+
+RelinkDialog::~RelinkDialog()
+{
+	delete m_ui;
+}
+
+void RelinkDialog::accept()
+{
+	const QString root = QDir::cleanPath(QDir::fromNativeSeparators(m_ui->root->text().trimmed()));
+	if (m_ui->root->text().trimmed().isEmpty() || !QFileInfo(root).isDir())
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Choose a directory to search."));
+		return;
+	}
+
+	WalkOptions options;
+	options.ignoreHidden = !m_ui->hiddenCheckBox->isChecked();
+	Relinker relinker(options);
+	if (relinker.load() == 0)
+	{
+		QMessageBox::information(this, qApp->applicationName(), tr("No files are missing."));
+		return QDialog::accept();
+	}
+
+	QProgressDialog progress(tr("Looking for missing files..."), tr("Abort"), 0, 0, this);
+	progress.setWindowModality(Qt::ApplicationModal);
+	progress.setMinimumDuration(0);
+	const QList<Relinker::Match> matches = relinker.find(root, [&progress](qsizetype scanned, qsizetype matched) -> bool
+		{
+			progress.setLabelText(tr("Looked at %1 file(s), found %2.").arg(scanned).arg(matched));
+			progress.setValue(0);
+			return !progress.wasCanceled();
+		});
+	progress.reset();
+	if (matches.isEmpty())
+	{
+		QMessageBox::information(this, qApp->applicationName(), tr("None of the missing files were found."));
+		return;
+	}
+
+	int64_t relinked = 0;
+	if (DBError error = Relinker::relink(matches, &relinked))
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to relink files: ") + error.message());
+		return;
+	}
+	QMessageBox::information(this, qApp->applicationName(), tr("Relinked %n file(s).", nullptr, static_cast<int>(relinked)));
+	QDialog::accept();
+}
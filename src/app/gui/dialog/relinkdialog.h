@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QDialog>
+
+namespace Ui
+{
+	class RelinkDialog;
+}
+
+/**
+ * Looks for the files marked missing below a directory, by their contents
+ * rather than their paths, and points them to where they were found.
+ */
+class RelinkDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit RelinkDialog(QWidget* parent = nullptr, Qt::WindowFlags f = { 0 });
+	virtual ~RelinkDialog() override;
+
+private slots:
+	void accept() override;
+
+private:
+	Ui::RelinkDialog* m_ui;
+};
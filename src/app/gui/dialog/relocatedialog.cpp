@@ -0,0 +1,121 @@
+#include "relocatedialog.h"
+#include "ui_relocatedialog.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QProgressDialog>
+
+#include "app/directory.h"
+#include "app/file.h"
+
+RelocateDialog::RelocateDialog(const QString& from, QWidget* parent, Qt::WindowFlags f)
+	: QDialog(parent, f)
+	, m_ui(new Ui::RelocateDialog)
+{
+	m_ui->setupUi(this);
+	m_ui->from->setText(from);
+	updateAffected();
+
+	connect(m_ui->buttonBox, &QDialogButtonBox::accepted, this, &RelocateDialog::accept);
+	connect(m_ui->buttonBox, &QDialogButtonBox::rejected, this, &RelocateDialog::reject);
+	connect(m_ui->from, &QLineEdit::textChanged, this, &RelocateDialog::updateAffected);
+	connect(m_ui->btnChooseFrom, &QPushButton::clicked, this
+		, [this]() -> void { m_ui->from->setText(chooseDirectory(m_ui->from->text())); });
+	connect(m_ui->btnChooseTo, &QPushButton::clicked, this
+		, [this]() -> void { m_ui->to->setText(chooseDirectory(m_ui->to->text())); });
+}
+
+RelocateDialog::~RelocateDialog()
+{
+	delete m_ui;
+}
+
+void RelocateDialog::accept()
+{
+	const QString from = normalize(m_ui->from->text());
+	const QString to = normalize(m_ui->to->text());
+	if (from.isEmpty() || to.isEmpty())
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Both directories are required."));
+		return;
+	}
+	if (from == to)
+		return QDialog::accept();
+
+	// the paths are rewritten in one statement, the directory counts are
+	// settled once on commit
+	QList<int64_t> ids;
+	DBError error = db->beginBulk();
+	if (error)
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to relocate files: ") + error.message());
+		return;
+	}
+	if ((error = Directory::relocate(from, to, &ids)))
+	{
+		db->rollback();
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to relocate files: ") + error.message());
+		return;
+	}
+	db->commit();
+
+	const QList<File> files(ids.begin(), ids.end());
+	QProgressDialog progress(tr("Looking for relocated files..."), tr("Abort"), 0, files.size(), this);
+	progress.setWindowModality(Qt::ApplicationModal);
+	int64_t missing = 0;
+	db->begin();
+	error = File::checkExistence(files, &missing, [&progress](qsizetype done) -> bool
+		{
+			progress.setValue(done);
+			return !progress.wasCanceled();
+		});
+	if (error)
+		db->rollback();
+	else
+		db->commit();
+	progress.setValue(files.size());
+
+	if (m_ui->verifyCheckBox->isChecked() && !progress.wasCanceled())
+	{
+		QProgressDialog verify(tr("Checking files..."), tr("Abort"), 0, files.size(), this);
+		verify.setWindowModality(Qt::ApplicationModal);
+		const QSet<int64_t> onOffline = File::onVolumes(files, Volume::offline());
+		for (int i = 0; i < files.size(); ++i)
+		{
+			verify.setValue(i);
+			if (verify.wasCanceled())
+				break;
+			if (files[i].state() != File::FileMissing && !onOffline.contains(files[i].id()))
+				files[i].check();
+		}
+		verify.setValue(files.size());
+	}
+
+	if (error)
+		QMessageBox::warning(this, qApp->applicationName(), tr("Relocated %n file(s), but failed to look for them on disk: ", nullptr, files.size()) + error.message());
+	else if (missing > 0)
+		QMessageBox::information(this, qApp->applicationName()
+			, tr("Relocated %n file(s), %1 of them could not be found.", nullptr, files.size()).arg(missing));
+	QDialog::accept();
+}
+
+void RelocateDialog::updateAffected()
+{
+	const Directory directory = Directory::fromPath(normalize(m_ui->from->text()));
+	m_ui->affected->setText(directory.id() >= 0
+		? tr("%n file(s) will be relocated.", nullptr, directory.totalCount())
+		: tr("No files are stored in this directory."));
+}
+
+QString RelocateDialog::chooseDirectory(const QString& current)
+{
+	QString dir = QFileDialog::getExistingDirectory(this, QString(), current);
+	return dir.isEmpty() ? current : dir;
+}
+
+QString RelocateDialog::normalize(const QString& path)
+{
+	if (path.trimmed().isEmpty())
+		return QString();
+	return QDir::cleanPath(QDir::fromNativeSeparators(path.trimmed()));
+}
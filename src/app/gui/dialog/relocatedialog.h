@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QDialog>
+
+namespace Ui
+{
+	class RelocateDialog;
+}
+
+/**
+ * Moves every file under one directory to another in the database, for when
+ * a drive letter or mount point changed. Afterwards the files are only
+ * checked to exist, re-hashing them is left as an option.
+ */
+class RelocateDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit RelocateDialog(const QString& from = QString(), QWidget* parent = nullptr, Qt::WindowFlags f = { 0 });
+	virtual ~RelocateDialog() override;
+
+private slots:
+	void accept() override;
+	void updateAffected();
+
+private:
+	Ui::RelocateDialog* m_ui;
+	QString chooseDirectory(const QString& current);
+	static QString normalize(const QString& path);
+};
@@ -1,9 +1,17 @@
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
 
+#include <QApplication>
+#include <QLocale>
+#include <QMessageBox>
 #include <QSettings>
+#include <QThread>
+#include <memory>
 
+#include "app/benchmark.h"
 #include "app/database.h"
+#include "app/maintenance.h"
+#include "app/movetracker.h"
 
 SettingsDialog::SettingsDialog(QWidget* parent, Qt::WindowFlags f)
 	: QDialog(parent, f)
@@ -14,8 +22,49 @@ SettingsDialog::SettingsDialog(QWidget* parent, Qt::WindowFlags f)
 	connect(m_ui->buttonBox, &QDialogButtonBox::accepted, this, &SettingsDialog::accept);
 	connect(m_ui->buttonBox, &QDialogButtonBox::rejected, this, &SettingsDialog::reject);
 
+	for (const PerformanceProfile::Preset& preset : PerformanceProfile::presets())
+		m_ui->presetComboBox->addItem(preset.name);
+	m_ui->presetComboBox->addItem(tr("Custom"));
+	m_ui->synchronousComboBox->addItem(tr("Normal"), PerformanceProfile::Normal);
+	m_ui->synchronousComboBox->addItem(tr("Full"), PerformanceProfile::Full);
+	m_ui->tempStoreComboBox->addItem(tr("Default"), PerformanceProfile::DefaultStore);
+	m_ui->tempStoreComboBox->addItem(tr("File"), PerformanceProfile::FileStore);
+	m_ui->tempStoreComboBox->addItem(tr("Memory"), PerformanceProfile::MemoryStore);
+	for (int size = 512; size <= 65536; size *= 2)
+		m_ui->pageSizeComboBox->addItem(QLocale().formattedDataSize(size), size);
+
+	connect(m_ui->presetComboBox, &QComboBox::activated, this, [this](int index) -> void
+		{
+			const QList<PerformanceProfile::Preset> presets = PerformanceProfile::presets();
+			if (index < presets.size())
+				setProfile(presets.at(index).profile);
+		});
+	connect(m_ui->cacheSizeSpinBox, &QSpinBox::valueChanged, this, &SettingsDialog::updatePreset);
+	connect(m_ui->mmapSizeSpinBox, &QSpinBox::valueChanged, this, &SettingsDialog::updatePreset);
+	connect(m_ui->synchronousComboBox, &QComboBox::currentIndexChanged, this, &SettingsDialog::updatePreset);
+	connect(m_ui->tempStoreComboBox, &QComboBox::currentIndexChanged, this, &SettingsDialog::updatePreset);
+	connect(m_ui->pageSizeComboBox, &QComboBox::currentIndexChanged, this, &SettingsDialog::updatePreset);
+	connect(m_ui->busyTimeoutSpinBox, &QSpinBox::valueChanged, this, &SettingsDialog::updatePreset);
+	connect(m_ui->benchmarkButton, &QPushButton::clicked, this, &SettingsDialog::runBenchmark);
+
 	if (!db->isOpen())
 		m_ui->tabWidget->setTabEnabled(0, false);
+	else
+	{
+		PerformanceProfile profile = PerformanceProfile::load(db->configPath());
+		// show the page size the file actually has
+		profile.pageSize = db->pageSize();
+		setProfile(profile);
+		const WatchSettings watch = WatchSettings::load(db->configPath());
+		m_ui->watchedDirectories->setValues(watch.directories);
+		m_ui->recursiveCheckBox->setChecked(watch.recursive);
+		m_ui->ignoreHiddenCheckBox->setChecked(watch.ignoreHidden);
+	}
+	if (!MoveTracker::isSupported())
+	{
+		m_ui->watchGroupBox->setEnabled(false);
+		m_ui->watchGroupBox->setToolTip(tr("Watching directories is not supported on this platform."));
+	}
 }
 
 SettingsDialog::~SettingsDialog()
@@ -25,15 +74,124 @@ SettingsDialog::~SettingsDialog()
 
 void SettingsDialog::accept()
 {
-	//QSettings settings(db->path)
-	//if (app->isOpen())
-	//{
-	//	app->watchedDirectories()
-	//}
+	if (db->isOpen())
+	{
+		PerformanceProfile profile = this->profile();
+		db->applyProfile(profile);
+		if (profile.pageSize != db->pageSize())
+		{
+			QMessageBox::StandardButton button = QMessageBox::question(this, tr("Change page size")
+				, tr("Changing the page size rewrites the whole database, which can take a while for large databases. Continue?"));
+			if (button == QMessageBox::Yes)
+			{
+				// leaving WAL for the rewrite fails while maintenance has
+				// the database open
+				MaintenanceScheduler::instance()->stop();
+				QApplication::setOverrideCursor(Qt::WaitCursor);
+				DBError error = db->setPageSize(profile.pageSize);
+				QApplication::restoreOverrideCursor();
+				if (error)
+					QMessageBox::warning(this, tr("Failed to change page size"), error.message());
+			}
+			// only the page size the file ended up with is remembered
+			profile.pageSize = db->pageSize();
+		}
+		profile.save(db->configPath());
+
+		WatchSettings watch;
+		watch.directories = m_ui->watchedDirectories->values();
+		watch.recursive = m_ui->recursiveCheckBox->isChecked();
+		watch.ignoreHidden = m_ui->ignoreHiddenCheckBox->isChecked();
+		watch.save(db->configPath());
+		MoveTracker::instance()->watch(watch);
+	}
 	QDialog::accept();
 }
 
 void SettingsDialog::reject()
 {
 	QDialog::reject();
-}
\ No newline at end of file
+}
+
+PerformanceProfile SettingsDialog::profile() const
+{
+	PerformanceProfile profile;
+	profile.cacheSizeMiB = m_ui->cacheSizeSpinBox->value();
+	profile.mmapSizeMiB = m_ui->mmapSizeSpinBox->value();
+	profile.synchronous = static_cast<PerformanceProfile::Synchronous>(m_ui->synchronousComboBox->currentData().toInt());
+	profile.tempStore = static_cast<PerformanceProfile::TempStore>(m_ui->tempStoreComboBox->currentData().toInt());
+	profile.pageSize = m_ui->pageSizeComboBox->currentData().toInt();
+	profile.busyTimeout = m_ui->busyTimeoutSpinBox->value();
+	return profile;
+}
+
+void SettingsDialog::setProfile(const PerformanceProfile& profile)
+{
+	m_ui->cacheSizeSpinBox->setValue(profile.cacheSizeMiB);
+	m_ui->mmapSizeSpinBox->setValue(profile.mmapSizeMiB);
+	m_ui->synchronousComboBox->setCurrentIndex(m_ui->synchronousComboBox->findData(profile.synchronous));
+	m_ui->tempStoreComboBox->setCurrentIndex(m_ui->tempStoreComboBox->findData(profile.tempStore));
+	m_ui->pageSizeComboBox->setCurrentIndex(m_ui->pageSizeComboBox->findData(profile.pageSize));
+	m_ui->busyTimeoutSpinBox->setValue(profile.busyTimeout);
+	updatePreset();
+}
+
+void SettingsDialog::updatePreset()
+{
+	// select the preset the fields match, or custom
+	const QList<PerformanceProfile::Preset> presets = PerformanceProfile::presets();
+	const PerformanceProfile current = profile();
+	int index = presets.size();
+	for (int i = 0; i < presets.size(); ++i)
+		if (presets.at(i).profile == current)
+			index = i;
+	m_ui->presetComboBox->setCurrentIndex(index);
+}
+
+void SettingsDialog::runBenchmark()
+{
+	if (db->isClosed())
+		return;
+	MaintenanceScheduler::instance()->cancel();
+	m_ui->benchmarkButton->setEnabled(false);
+	m_ui->benchmarkLabel->setText(tr("Running benchmark..."));
+	// the thread outlives the dialog if it is closed early, the results are
+	// then dropped with the connection below
+	const QString path = db->path();
+	const PerformanceProfile profile = this->profile();
+	const auto result = std::make_shared<Benchmark::Result>();
+	const auto error = std::make_shared<DBError>();
+	QThread* thread = QThread::create([path, profile, result, error]() -> void
+		{
+			*error = Benchmark::run(path, profile, result.get());
+		});
+	connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+	connect(thread, &QThread::finished, this, [this, result, error]() -> void
+		{
+			m_ui->benchmarkButton->setEnabled(true);
+			showBenchmark(*error, *result);
+		});
+	thread->start(QThread::LowPriority);
+}
+
+void SettingsDialog::showBenchmark(const DBError& error, const Benchmark::Result& result)
+{
+	if (error)
+	{
+		m_ui->benchmarkLabel->setText(error.message());
+		return;
+	}
+	const QLocale locale;
+	m_ui->benchmarkLabel->setText(tr("Lookup: %1 µs\nSearch: %2 ms\nCommit: %3 ms\nSearch index: %4")
+		.arg(locale.toString(result.lookupMicroseconds, 'f', 1)
+			, locale.toString(result.searchMilliseconds, 'f', 2)
+			, locale.toString(result.commitMilliseconds, 'f', 2)
+			, locale.formattedDataSize(result.searchIndexBytes))
+		+ u"\n\n"_s
+		+ tr("Prefix search over %1 names:\nunicode61: %2 ms, %3\nfilename: %4 ms, %5")
+		.arg(locale.toString(result.sampledNames)
+			, locale.toString(result.unicodeSearchMilliseconds, 'f', 2)
+			, locale.formattedDataSize(result.unicodeIndexBytes)
+			, locale.toString(result.filenameSearchMilliseconds, 'f', 2)
+			, locale.formattedDataSize(result.filenameIndexBytes)));
+}
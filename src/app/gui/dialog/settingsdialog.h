@@ -1,6 +1,9 @@
 #pragma once
 
 #include <QDialog>
+#include "app/benchmark.h"
+#include "app/database.h"
+#include "app/performanceprofile.h"
 
 namespace Ui
 {
@@ -21,4 +24,9 @@ private slots:
 
 private:
 	Ui::SettingsDialog* m_ui;
+	PerformanceProfile profile() const;
+	void setProfile(const PerformanceProfile& profile);
+	void updatePreset();
+	void runBenchmark();
+	void showBenchmark(const DBError& error, const Benchmark::Result& result);
 };
@@ -11,10 +11,17 @@ FilePreview::FilePreview(FileList* fileList, QWidget* parent)
 	m_label = new QLabel(this);
 	m_label->setText(tr("No preview available"));
 	m_label->setAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
-	//m_label->setScaledContents(true);
+
+	m_imageView = new TiledImageView(this);
+	m_textView = new FileTextView(this);
+
+	m_stack = new QStackedWidget(this);
+	m_stack->addWidget(m_label);
+	m_stack->addWidget(m_imageView);
+	m_stack->addWidget(m_textView);
 
 	QVBoxLayout* layout = new QVBoxLayout();
-	layout->addWidget(m_label);
+	layout->addWidget(m_stack);
 	setLayout(layout);
 }
 
@@ -25,28 +32,27 @@ void FilePreview::updatePreview(const QList<File>& selected)
 	File file = selected.first();
 	QString path = file.path();
 	QFileInfo qpath(file.path());
-	if (!QImageReader::supportedImageFormats().contains(qpath.suffix()))
-		return clear();
-	m_pixmap = QPixmap(path);
-	if (m_pixmap.isNull())
+	if (!qpath.isFile())
 		return clear();
-	// margin so that the widget can still be rescaled
-	QPixmap pixmap = m_pixmap.scaled(QSize(m_label->width() - 9, m_label->height() - 9), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-	if (pixmap.isNull())
+	// only the visible tiles get decoded, so large scans do not have to be
+	// held in memory as a whole
+	if (QImageReader::supportedImageFormats().contains(qpath.suffix().toLower().toUtf8())
+		&& m_imageView->setImage(path))
+	{
+		m_textView->clear();
+		m_stack->setCurrentWidget(m_imageView);
+		return;
+	}
+	// anything else is shown as text or hex, straight from a memory mapping
+	m_imageView->clear();
+	if (!m_textView->setFile(path))
 		return clear();
-	m_label->setPixmap(pixmap);
+	m_stack->setCurrentWidget(m_textView);
 }
 
 void FilePreview::clear()
 {
-	m_label->setPixmap(QPixmap());
-	m_label->setText(tr("No preview available"));
-}
-
-void FilePreview::resizeEvent(QResizeEvent* event)
-{
-	if (m_pixmap.isNull())
-		return;
-	m_label->setPixmap(m_pixmap.scaled(QSize(m_label->width() - 9, m_label->height() - 9), Qt::KeepAspectRatio));
-	event->accept();
+	m_imageView->clear();
+	m_textView->clear();
+	m_stack->setCurrentWidget(m_label);
 }
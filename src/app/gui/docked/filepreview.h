@@ -1,11 +1,12 @@
 #pragma once
 
 #include <QLabel>
-#include <QPixmap>
 #include <QPointer>
-#include <QResizeEvent>
+#include <QStackedWidget>
 #include <QWidget>
 #include "app/gui/filelist.h"
+#include "app/gui/helper/filetextview.h"
+#include "app/gui/helper/tiledimageview.h"
 
 class FilePreview : public QWidget
 {
@@ -18,8 +19,9 @@ private slots:
 	void updatePreview(const QList<File>& selected);
 
 private:
+	QStackedWidget* m_stack;
 	QLabel* m_label;
-	QPixmap m_pixmap;
-	void resizeEvent(QResizeEvent* event) override;
+	TiledImageView* m_imageView;
+	FileTextView* m_textView;
 	void clear();
 };
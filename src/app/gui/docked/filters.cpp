@@ -2,15 +2,93 @@
 
 #include <QSettings>
 #include <QMenu>
+#include <QSet>
+#include <QThread>
+#include <algorithm>
+#include <memory>
 
 #include "app/tag.h"
+#include "app/directory.h"
 #include "app/file.h"
 #include "app/utils.h"
+#include "app/volume.h"
+#include "app/gui/dialog/relocatedialog.h"
+
+DirectoryLoader::DirectoryLoader(QObject* parent)
+	: QObject(parent)
+	, m_con(nullptr)
+{}
+
+DirectoryLoader::~DirectoryLoader()
+{
+	close();
+}
+
+void DirectoryLoader::open(const QString& path)
+{
+	close();
+	if (sqlite3_open_v2(path.toUtf8(), &m_con, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+	{
+		sqlite3_close(m_con);
+		m_con = nullptr;
+		return;
+	}
+	Database::prepareConnection(m_con);
+}
+
+void DirectoryLoader::close()
+{
+	sqlite3_close(m_con);
+	m_con = nullptr;
+}
+
+void DirectoryLoader::load(int generation, int64_t parentId, int offset, int limit)
+{
+	QList<DirectoryNode> nodes;
+	if (m_con)
+	{
+		// walks directory_parent in name order, one page at a time
+		const char* sql = R"(
+			SELECT d.id, d.name, d.path, d.total_count,
+				EXISTS(SELECT 1 FROM directory AS c WHERE c.parent_id = d.id)
+			FROM directory AS d
+			WHERE d.parent_id IS ?
+			ORDER BY d.name
+			LIMIT ? OFFSET ?;
+		)";
+		// one row more than asked for tells whether there is another page
+		sqlite3_stmt* stmt;
+		sqlite3_prepare_v2(m_con, sql, -1, &stmt, nullptr);
+		if (parentId >= 0)
+			sqlite3_bind_int64(stmt, 1, parentId);
+		else
+			sqlite3_bind_null(stmt, 1);
+		sqlite3_bind_int(stmt, 2, limit + 1);
+		sqlite3_bind_int(stmt, 3, offset);
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			DirectoryNode node;
+			node.id = sqlite3_column_int64(stmt, 0);
+			node.name = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1));
+			node.path = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)), sqlite3_column_bytes(stmt, 2));
+			node.totalCount = sqlite3_column_int64(stmt, 3);
+			node.hasChildren = sqlite3_column_int(stmt, 4);
+			nodes.append(node);
+		}
+		sqlite3_finalize(stmt);
+	}
+	const bool more = nodes.size() > limit;
+	if (more)
+		nodes.removeLast();
+	emit loaded(generation, parentId, offset, nodes, more);
+}
 
 Filters::Filters(MainWindow* mainWindow, FileList* fileList, QWidget* parent)
 	: QTreeWidget(parent)
 	, m_mainWindow(mainWindow)
 	, m_fileList(fileList)
+	, m_generation(0)
+	, m_probeGeneration(0)
 {
 	setContextMenuPolicy(Qt::CustomContextMenu);
 	setHeaderHidden(true);
@@ -33,28 +111,58 @@ Filters::Filters(MainWindow* mainWindow, FileList* fileList, QWidget* parent)
 	item->setIcon(0, QIcon(":/icons/file-error.svg"));
 	item->setData(0, Qt::UserRole, File::Error);
 	m_tag = new QTreeWidgetItem(this, QStringList{ tr("Tags") });
+	m_dir = new QTreeWidgetItem(this, QStringList{ tr("Directories") });
+	m_volume = new QTreeWidgetItem(this, QStringList{ tr("Volumes") });
 
 	m_actionIncludeTag = new QAction(QIcon::fromTheme(QIcon::ThemeIcon::ListAdd), u"Include in search"_s, this);
 	m_actionExcludeTag = new QAction(QIcon::fromTheme(QIcon::ThemeIcon::ListRemove), u"Exclude from search"_s, this);
 	connect(m_actionIncludeTag, &QAction::triggered, this, &Filters::handleIncludeTag);
 	connect(m_actionExcludeTag, &QAction::triggered, this, &Filters::handleExcludeTag);
+	m_actionShowDirectory = new QAction(QIcon::fromTheme(QIcon::ThemeIcon::FolderOpen), tr("Show files in directory"), this);
+	m_actionClearDirectory = new QAction(QIcon::fromTheme(QIcon::ThemeIcon::EditClear), tr("Clear directory filter"), this);
+	connect(m_actionShowDirectory, &QAction::triggered, this, &Filters::handleShowDirectory);
+	connect(m_actionClearDirectory, &QAction::triggered, this, &Filters::handleClearDirectory);
+	m_actionRelocateDirectory = new QAction(tr("Relocate files..."), this);
+	connect(m_actionRelocateDirectory, &QAction::triggered, this, &Filters::handleRelocateDirectory);
+	connect(this, &QTreeWidget::itemClicked, this, &Filters::handleItemClicked);
 	connect(this, &QTreeWidget::itemDoubleClicked, this, &Filters::handleItemDoubleClicked);
+	connect(this, &QTreeWidget::itemExpanded, this, &Filters::handleItemExpanded);
+
+	m_loaderThread = new QThread(this);
+	m_loader = new DirectoryLoader();
+	m_loader->moveToThread(m_loaderThread);
+	connect(m_loaderThread, &QThread::finished, m_loader, &QObject::deleteLater);
+	connect(m_loader, &DirectoryLoader::loaded, this, &Filters::handleDirectoriesLoaded);
+	m_loaderThread->start();
 
+	connect(db, &Database::opened, this, &Filters::probeVolumes);
 	connect(db, &Database::opened, this, &Filters::populate);
+	connect(db, &Database::opened, this, &Filters::openDirectories);
 	connect(db, &Database::closed, this, &Filters::depopulate);
+	connect(db, &Database::closed, this, [this]() -> void
+		{
+			++m_probeGeneration;
+			m_offlineVolumes.clear();
+		});
+	connect(db, &Database::closed, this, &Filters::closeDirectories);
 	connect(db, &Database::updated, this, &Filters::refresh);
 
 	m_actionRefresh = new QAction(QIcon::fromTheme(QIcon::ThemeIcon::ViewRefresh), tr("Refresh"), this);
 	connect(this, &QWidget::customContextMenuRequested, this, &Filters::showContextMenu);
+	connect(m_actionRefresh, &QAction::triggered, this, &Filters::probeVolumes);
 	connect(m_actionRefresh, &QAction::triggered, this, &Filters::refresh);
 
 	readSettings();
+	probeVolumes();
 	populate();
+	openDirectories();
 }
 
 Filters::~Filters()
 {
 	writeSettings();
+	m_loaderThread->quit();
+	m_loaderThread->wait();
 }
 
 void Filters::populate()
@@ -85,14 +193,198 @@ void Filters::populate()
 		item->setData(0, Qt::UserRole, tag.name());
 	}
 	sqlite3_finalize(stmt);
+
+	populateVolumes();
+}
+
+void Filters::populateVolumes()
+{
+	for (const QTreeWidgetItem* item : m_volume->takeChildren())
+		delete item;
+	if (db->isClosed())
+		return;
+	// with whether they were there when last probed
+	for (const Volume& volume : Volume::all())
+	{
+		const QString name = volume.label().isEmpty() ? volume.root() : volume.label();
+		const int64_t count = volume.fileCount();
+		const bool offline = m_offlineVolumes.contains(volume.id());
+		QTreeWidgetItem* item = new QTreeWidgetItem(m_volume, QStringList{ offline
+			? tr("%1 (%2, offline)").arg(name, friendlyNumber(count))
+			: u"%1 (%2)"_s.arg(name, friendlyNumber(count)) });
+		item->setIcon(0, QIcon::fromTheme(QIcon::ThemeIcon::DriveHarddisk));
+		item->setToolTip(0, u"%1 %2\n%3"_s.arg(volume.root(), QLocale().toString(count)
+			, offline ? tr("Offline, its files are skipped by checks") : tr("Online")));
+		item->setData(0, Qt::UserRole, volume.root());
+		if (offline)
+			item->setForeground(0, palette().brush(QPalette::Disabled, QPalette::Text));
+	}
 }
 
 void Filters::depopulate()
 {
 	for (const QTreeWidgetItem* item : m_tag->takeChildren())
 		delete item;
-	//for (const QTreeWidgetItem* item : m_dir->takeChildren())
-	//	delete item;
+	for (const QTreeWidgetItem* item : m_volume->takeChildren())
+		delete item;
+}
+
+void Filters::probeVolumes()
+{
+	if (db->isClosed())
+		return;
+	// a hung mount keeps the probe waiting for up to its timeout, the
+	// volumes are shown as last probed until it answers
+	const QList<Volume::Mount> mounts = Volume::mounts();
+	const QString databasePath = db->path();
+	const int generation = ++m_probeGeneration;
+	const auto offline = std::make_shared<QSet<int64_t>>();
+	QThread* thread = QThread::create([mounts, offline]() -> void
+		{
+			*offline = Volume::offline(mounts);
+		});
+	connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+	connect(thread, &QThread::finished, this, [this, generation, databasePath, offline]() -> void
+		{
+			if (generation != m_probeGeneration || db->isClosed() || db->path() != databasePath)
+				return;
+			m_offlineVolumes = *offline;
+			populateVolumes();
+		});
+	thread->start(QThread::LowPriority);
+}
+
+void Filters::openDirectories()
+{
+	if (db->isClosed())
+		return;
+	const QString path = db->path();
+	QMetaObject::invokeMethod(m_loader, [this, path]() -> void { m_loader->open(path); }, Qt::QueuedConnection);
+	m_dir->setData(0, DirectoryLoadedRole, true);
+	requestDirectories(-1, 0, DIRECTORY_PAGE_SIZE);
+}
+
+void Filters::closeDirectories()
+{
+	// answers to requests made before this point are dropped
+	++m_generation;
+	QMetaObject::invokeMethod(m_loader, [this]() -> void { m_loader->close(); }, Qt::QueuedConnection);
+	for (const QTreeWidgetItem* item : m_dir->takeChildren())
+		delete item;
+	m_dirItems.clear();
+	m_dir->setData(0, DirectoryLoadedRole, false);
+}
+
+void Filters::refreshDirectories()
+{
+	if (db->isClosed())
+		return;
+	// reload every level that has been opened so far, nothing else
+	QList<QTreeWidgetItem*> parents{ m_dir };
+	for (QTreeWidgetItem* item : m_dirItems)
+		if (item->data(0, DirectoryLoadedRole).toBool())
+			parents.append(item);
+	for (QTreeWidgetItem* parent : parents)
+	{
+		int count = parent->childCount();
+		if (count > 0 && parent->child(count - 1)->data(0, DirectoryMoreRole).toBool())
+			--count;
+		const int64_t parentId = parent == m_dir ? -1 : parent->data(0, DirectoryIdRole).toLongLong();
+		requestDirectories(parentId, 0, std::max(count, DIRECTORY_PAGE_SIZE));
+	}
+}
+
+void Filters::requestDirectories(int64_t parentId, int offset, int limit)
+{
+	const int generation = m_generation;
+	QMetaObject::invokeMethod(m_loader, [this, generation, parentId, offset, limit]() -> void
+		{
+			m_loader->load(generation, parentId, offset, limit);
+		}, Qt::QueuedConnection);
+}
+
+void Filters::handleDirectoriesLoaded(int generation, int64_t parentId, int offset, const QList<DirectoryNode>& nodes, bool more)
+{
+	if (generation != m_generation)
+		return;
+	QTreeWidgetItem* parent = parentId < 0 ? m_dir : m_dirItems.value(parentId);
+	if (!parent)
+		return;
+
+	// drop the paging item, it is added back below if the page was full
+	const int last = parent->childCount() - 1;
+	if (last >= 0 && parent->child(last)->data(0, DirectoryMoreRole).toBool())
+		delete parent->takeChild(last);
+
+	// a reload from offset 0 replaces the loaded children. names never
+	// change, so the surviving items are already in order and the new ones
+	// are slotted in between, keeping what is expanded below them
+	if (offset == 0)
+	{
+		QSet<int64_t> ids;
+		for (const DirectoryNode& node : nodes)
+			ids.insert(node.id);
+		for (int i = parent->childCount() - 1; i >= 0; --i)
+			if (!ids.contains(parent->child(i)->data(0, DirectoryIdRole).toLongLong()))
+			{
+				QTreeWidgetItem* item = parent->takeChild(i);
+				forgetDirectoryItem(item);
+				delete item;
+			}
+	}
+	for (int i = 0; i < nodes.size(); ++i)
+	{
+		const DirectoryNode& node = nodes[i];
+		const int index = offset + i;
+		QTreeWidgetItem* item = index < parent->childCount() ? parent->child(index) : nullptr;
+		if (!item || item->data(0, DirectoryIdRole).toLongLong() != node.id)
+		{
+			item = new QTreeWidgetItem();
+			item->setIcon(0, QIcon::fromTheme(QIcon::ThemeIcon::FolderOpen));
+			item->setData(0, DirectoryIdRole, static_cast<qlonglong>(node.id));
+			parent->insertChild(index, item);
+			m_dirItems.insert(node.id, item);
+		}
+		item->setText(0, u"%1 (%2)"_s.arg(node.name, friendlyNumber(node.totalCount)));
+		item->setToolTip(0, node.path + " " + QLocale().toString(node.totalCount));
+		// children are only read when expanded, until then just show that
+		// there are some
+		item->setChildIndicatorPolicy(node.hasChildren && !item->data(0, DirectoryLoadedRole).toBool()
+			? QTreeWidgetItem::ShowIndicator
+			: QTreeWidgetItem::DontShowIndicatorWhenChildless);
+	}
+	if (parent != m_dir)
+		parent->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicatorWhenChildless);
+	if (more)
+	{
+		QTreeWidgetItem* more = new QTreeWidgetItem(parent, QStringList{ tr("Show more...") });
+		more->setData(0, DirectoryMoreRole, true);
+		more->setData(0, DirectoryIdRole, static_cast<qlonglong>(parentId));
+	}
+}
+
+void Filters::handleItemExpanded(QTreeWidgetItem* item)
+{
+	if (!isDirectoryItem(item) || item == m_dir || item->data(0, DirectoryLoadedRole).toBool())
+		return;
+	item->setData(0, DirectoryLoadedRole, true);
+	requestDirectories(item->data(0, DirectoryIdRole).toLongLong(), 0, DIRECTORY_PAGE_SIZE);
+}
+
+bool Filters::isDirectoryItem(const QTreeWidgetItem* item) const
+{
+	for (; item; item = item->parent())
+		if (item == m_dir)
+			return true;
+	return false;
+}
+
+void Filters::forgetDirectoryItem(QTreeWidgetItem* item)
+{
+	m_dirItems.remove(item->data(0, DirectoryIdRole).toLongLong());
+	for (int i = 0; i < item->childCount(); ++i)
+		if (!item->child(i)->data(0, DirectoryMoreRole).toBool())
+			forgetDirectoryItem(item->child(i));
 }
 
 //void Filters::onItemDoubleClicked(QTreeWidgetItem* item, int column)
@@ -105,6 +397,8 @@ void Filters::readSettings()
 	QSettings settings;
 	m_state->setExpanded(settings.value("GUI/Filters/stateExpanded", true).toBool());
 	m_tag->setExpanded(settings.value("GUI/Filters/tagExpanded", true).toBool());
+	m_dir->setExpanded(settings.value("GUI/Filters/dirExpanded", true).toBool());
+	m_volume->setExpanded(settings.value("GUI/Filters/volumeExpanded", true).toBool());
 }
 
 void Filters::writeSettings()
@@ -112,12 +406,15 @@ void Filters::writeSettings()
 	QSettings settings;
 	settings.setValue("GUI/Filters/stateExpanded", m_state->isExpanded());
 	settings.setValue("GUI/Filters/tagExpanded", m_tag->isExpanded());
+	settings.setValue("GUI/Filters/dirExpanded", m_dir->isExpanded());
+	settings.setValue("GUI/Filters/volumeExpanded", m_volume->isExpanded());
 }
 
 void Filters::refresh()
 {
 	depopulate();
 	populate();
+	refreshDirectories();
 }
 
 void Filters::showContextMenu(const QPoint& pos)
@@ -136,6 +433,12 @@ void Filters::showContextMenu(const QPoint& pos)
 			menu->addAction(m_actionIncludeTag);
 			menu->addAction(m_actionExcludeTag);
 		}
+		else if (item != m_dir && isDirectoryItem(item) && !item->data(0, DirectoryMoreRole).toBool())
+		{
+			menu->addAction(m_actionShowDirectory);
+			menu->addAction(m_actionClearDirectory);
+			menu->addAction(m_actionRelocateDirectory);
+		}
 	}
 	menu->addSeparator();
 	menu->addAction(m_actionRefresh);
@@ -153,6 +456,28 @@ void Filters::handleItemDoubleClicked(QTreeWidgetItem* item, int column) const
 		m_fileList->appendToTagQuery(item->data(0, Qt::UserRole).toString());
 }
 
+void Filters::handleItemClicked(QTreeWidgetItem* item, int column)
+{
+	// a volume shows the files below where it was mounted
+	if (item->parent() == m_volume)
+	{
+		if (m_mainWindow->currentTab() == MainWindow::File)
+			m_fileList->setDirectory(Directory::fromPath(item->data(0, Qt::UserRole).toString()));
+		return;
+	}
+	if (item == m_dir || !isDirectoryItem(item))
+		return;
+	if (item->data(0, DirectoryMoreRole).toBool())
+	{
+		const int64_t parentId = item->data(0, DirectoryIdRole).toLongLong();
+		const int offset = item->parent()->childCount() - 1;
+		requestDirectories(parentId, offset, DIRECTORY_PAGE_SIZE);
+		return;
+	}
+	if (m_mainWindow->currentTab() == MainWindow::File)
+		m_fileList->setDirectory(Directory(item->data(0, DirectoryIdRole).toLongLong()));
+}
+
 void Filters::handleIncludeTag() const
 {
 	if (m_mainWindow->currentTab() != MainWindow::File)
@@ -182,3 +507,33 @@ void Filters::handleExcludeTag() const
 	if (parent == m_tag)
 		m_fileList->appendToTagQuery(u"!"_s + item->data(0, Qt::UserRole).toString());
 }
+
+void Filters::handleShowDirectory() const
+{
+	QList<QTreeWidgetItem*> selected = selectedItems();
+	if (selected.isEmpty())
+		return;
+	QTreeWidgetItem* item = selected.first();
+	if (item == m_dir || !isDirectoryItem(item) || item->data(0, DirectoryMoreRole).toBool())
+		return;
+	m_fileList->setDirectory(Directory(item->data(0, DirectoryIdRole).toLongLong()));
+}
+
+void Filters::handleClearDirectory() const
+{
+	m_fileList->setDirectory(Directory());
+}
+
+void Filters::handleRelocateDirectory()
+{
+	QList<QTreeWidgetItem*> selected = selectedItems();
+	if (selected.isEmpty())
+		return;
+	QTreeWidgetItem* item = selected.first();
+	if (item == m_dir || !isDirectoryItem(item) || item->data(0, DirectoryMoreRole).toBool())
+		return;
+	RelocateDialog dialog(Directory(item->data(0, DirectoryIdRole).toLongLong()).path(), this);
+	dialog.exec();
+}
+
+const int Filters::DIRECTORY_PAGE_SIZE = 500;
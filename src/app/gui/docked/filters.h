@@ -1,9 +1,47 @@
 #pragma once
 
+#include <QHash>
+#include <QSet>
+#include <QThread>
 #include <QTreeWidget>
+#include "sqlite3.h"
 #include "app/gui/mainwindow.h"
 #include "app/gui/filelist.h"
 
+struct DirectoryNode
+{
+	int64_t id;
+	QString name;
+	QString path;
+	int64_t totalCount;
+	bool hasChildren;
+};
+
+/**
+ * Reads one level of the directory tree at a time on its own connection,
+ * so expanding a directory with many subdirectories never blocks the UI.
+ */
+class DirectoryLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit DirectoryLoader(QObject* parent = nullptr);
+	~DirectoryLoader() override;
+
+public slots:
+	void open(const QString& path);
+	void close();
+	// a parentId of -1 loads the roots
+	void load(int generation, int64_t parentId, int offset, int limit);
+
+signals:
+	void loaded(int generation, int64_t parentId, int offset, const QList<DirectoryNode>& nodes, bool more);
+
+private:
+	sqlite3* m_con;
+};
+
 class Filters : public QTreeWidget
 {
 	Q_OBJECT
@@ -14,12 +52,28 @@ public:
 
 private slots:
 	void refresh();
+	void handleItemClicked(QTreeWidgetItem* item, int column);
 	void handleItemDoubleClicked(QTreeWidgetItem* item, int column) const;
+	void handleItemExpanded(QTreeWidgetItem* item);
+	void handleDirectoriesLoaded(int generation, int64_t parentId, int offset, const QList<DirectoryNode>& nodes, bool more);
 	void showContextMenu(const QPoint& pos);
 	void handleIncludeTag() const;
 	void handleExcludeTag() const;
+	void handleShowDirectory() const;
+	void handleClearDirectory() const;
+	void handleRelocateDirectory();
+	void probeVolumes();
 
 private:
+	enum DirectoryRole
+	{
+		DirectoryIdRole = Qt::UserRole,
+		// set once the children have been requested
+		DirectoryLoadedRole,
+		// set on the item that loads the next page of its siblings
+		DirectoryMoreRole
+	};
+	static const int DIRECTORY_PAGE_SIZE;
 	QTreeWidgetItem* m_state;
 	QTreeWidgetItem* m_stateOk;
 	QTreeWidgetItem* m_stateFileMissing;
@@ -27,13 +81,33 @@ private:
 	QTreeWidgetItem* m_stateError;
 	QTreeWidgetItem* m_tag;
 	QTreeWidgetItem* m_dir;
+	QTreeWidgetItem* m_volume;
+	QHash<int64_t, QTreeWidgetItem*> m_dirItems;
+	// as of the last probe that answered, which is not repeated on every
+	// refresh. probes run on a thread of their own and are dropped when a
+	// later one was started
+	QSet<int64_t> m_offlineVolumes;
+	int m_probeGeneration;
 	QAction* m_actionRefresh;
 	QAction* m_actionIncludeTag;
 	QAction* m_actionExcludeTag;
+	QAction* m_actionShowDirectory;
+	QAction* m_actionClearDirectory;
+	QAction* m_actionRelocateDirectory;
 	MainWindow* m_mainWindow;
 	FileList* m_fileList;
+	QThread* m_loaderThread;
+	DirectoryLoader* m_loader;
+	int m_generation;
 	void populate();
+	void populateVolumes();
 	void depopulate();
+	void openDirectories();
+	void closeDirectories();
+	void refreshDirectories();
+	void requestDirectories(int64_t parentId, int offset, int limit);
+	bool isDirectoryItem(const QTreeWidgetItem* item) const;
+	void forgetDirectoryItem(QTreeWidgetItem* item);
 	void readSettings();
 	void writeSettings();
 };
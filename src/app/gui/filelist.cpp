@@ -10,13 +10,18 @@
 #include <QTreeWidget>
 #include <QProgressDialog>
 #include <QDesktopServices>
+#include <QToolTip>
+#include <algorithm>
 
+#include "app/bulkedit.h"
 #include "app/database.h"
 #include "app/file.h"
 #include "app/gui/dialog/newfiledialog.h"
 #include "app/gui/dialog/editfiledialog.h"
 #include "app/gui/dialog/editfiledialogmulti.h"
 #include "app/gui/helper/taglineedit.h"
+#include "app/tagdictionary.h"
+#include "app/writebatcher.h"
 #include "app/globals.h"
 
 FileList::FileList(QWidget* parent)
@@ -39,6 +44,7 @@ FileList::FileList(QWidget* parent)
 	m_ui->menuButton->setIcon(QIcon(":/icons/menu.svg"));
 	QMenu* menu = new QMenu(this);
 	menu->addAction(m_ui->actionSortByRelevancy);
+	menu->addAction(m_ui->actionMatchSubstrings);
 	m_ui->menuButton->setMenu(menu);
 
 	QHeaderView* header = m_ui->treeView->header();
@@ -51,7 +57,7 @@ FileList::FileList(QWidget* parent)
 	connect(m_ui->treeView->selectionModel(), &QItemSelectionModel::selectionChanged, this, [this]()-> void {emit selectionChanged(selectedFiles()); });
 
 	m_ui->sortBy->addItem(tr("Name"), u"displayName"_s);
-	m_ui->sortBy->addItem(tr("Path"), u"file.path"_s);
+	m_ui->sortBy->addItem(tr("Path"), u"file.dir"_s);
 	m_ui->sortBy->addItem(tr("State"), u"file.state"_s);
 	m_ui->sortBy->addItem(tr("Date created"), u"file.created"_s);
 	m_ui->sortBy->addItem(tr("Last modified"), u"file.modified"_s);
@@ -64,13 +70,22 @@ FileList::FileList(QWidget* parent)
 	connect(db, &Database::updated, this, &FileList::populate);
 	connect(m_ui->nameLineEdit, &QLineEdit::textChanged, this, &FileList::populate);
 	connect(m_ui->tagLineEdit, &QLineEdit::textChanged, this, &FileList::populate);
+	connect(m_ui->tagLineEdit, &QLineEdit::editingFinished, this, &FileList::checkTagQuery);
 	connect(m_ui->paginator, &Paginator::pageChangedByUser, this, &FileList::populate);
 	connect(m_ui->resultsPerPage, &QSpinBox::editingFinished, this, &FileList::populate);
 	connect(m_ui->sortBy, &QComboBox::currentIndexChanged, this, &FileList::populate);
 	connect(m_ui->sortOrder, &QComboBox::currentIndexChanged, this, &FileList::populate);
 	connect(m_ui->actionSortByRelevancy, &QAction::toggled, this, &FileList::populate);
+	connect(m_ui->actionMatchSubstrings, &QAction::toggled, this, &FileList::populate);
 
 	connect(m_ui->clearQuery, &QToolButton::clicked, this, &FileList::clearQuery);
+	m_ui->directoryButton->hide();
+	connect(m_ui->directoryButton, &QToolButton::clicked, this, [this]() -> void { setDirectory(Directory()); });
+	connect(db, &Database::closed, this, [this]() -> void
+		{
+			m_directory = Directory();
+			m_ui->directoryButton->hide();
+		});
 
 	readSettings();
 }
@@ -110,10 +125,20 @@ void FileList::checkSelected()
 	
 	QProgressDialog progress(tr("Checking files..."), tr("Abort"), 0, files.size(), this);
 	progress.setWindowModality(Qt::ApplicationModal);
+	// probed once up front, files on a drive that is not there are skipped
+	// rather than each found missing or waited on
+	const QSet<int64_t> onOffline = File::onVolumes(files, Volume::offline());
+	int skipped = 0;
+	WriteBatcher batcher(false);
 	for (int i = 0; i < files.size(); ++i)
 	{
 		File file = files[i];
 		progress.setValue(i);
+		if (onOffline.contains(file.id()))
+		{
+			++skipped;
+			continue;
+		}
 		QString path = file.path();
 		progress.setLabelText(tr("Checking file: %1").arg(
 			path.size() > 32
@@ -122,11 +147,20 @@ void FileList::checkSelected()
 		));
 		if (progress.wasCanceled())
 			break;
-		CheckError error = file.check();
+		CheckError error;
+		batcher.write([&]() -> DBError
+			{
+				error = file.check();
+				return error.dbError;
+			});
 		if (!error && file.state() == File::ChecksumChanged)
 			checksumErrors.append({ file, error });
 	}
+	batcher.finish();
 	progress.setValue(files.size());
+	if (skipped > 0)
+		QMessageBox::information(this, qApp->applicationName()
+			, tr("%n file(s) were skipped because their volume is offline.", nullptr, skipped));
 
 	if (!checksumErrors.isEmpty())
 	{
@@ -169,9 +203,21 @@ void FileList::deleteSelected()
 			? tr("Are you sure you want to delete %1 files? This will not delete the files from disk.").arg(files.size())
 			: tr("Are you sure you want to delete '%1'? This will not delete the file from disk.").arg(files.first().name())
 	);
-	if (btn == QMessageBox::Yes)
-		for (const File& file : files)
-			file.remove();
+	if (btn != QMessageBox::Yes)
+		return;
+	DBError error = db->beginBulk();
+	if (error)
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to delete files: ") + error.message());
+		return;
+	}
+	if (error = FileBulkEdit(files).remove())
+	{
+		db->rollback();
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to delete files: ") + error.message());
+		return;
+	}
+	db->commit();
 }
 
 void FileList::populate()
@@ -183,6 +229,30 @@ void FileList::populate()
 	QString sortBy = m_ui->sortBy->currentData().toString();
 	QString sortOrder = m_ui->sortOrder->currentData().toString();
 
+	// trigrams can find text anywhere in a name, but need at least three
+	// characters per word, shorter words fall back to prefix matching
+	QStringList query_parts = query.split(' ', Qt::SkipEmptyParts);
+	const bool matchSubstrings = m_ui->actionMatchSubstrings->isChecked()
+		&& std::all_of(query_parts.cbegin(), query_parts.cend(), [](const QString& part) -> bool { return part.size() >= 3; });
+	QString searchTable, relevancy;
+	if (matchSubstrings)
+	{
+		searchTable = u"file_search_trigram"_s;
+		relevancy = u"bm25(file_search_trigram, 15.0, 15.0, 10.0)"_s;
+		for (QString& part : query_parts)
+			part = u"\""_s + part.replace('"', u"\"\""_s) + u"\""_s;
+	}
+	else
+	{
+		searchTable = u"file_search"_s;
+		relevancy = u"bm25(file_search, 15.0, 15.0, 10.0, 5.0, 10.0)"_s;
+		// quoted so punctuation reaches the tokenizer instead of being a
+		// syntax error, it splits the word the same way the name was indexed
+		for (QString& part : query_parts)
+			part = u"\""_s + part.replace('"', u"\"\""_s) + u"\"*"_s;
+	}
+	QByteArray query_bytes = query_parts.join(' ').toUtf8();
+
 	QString sql, sqlCount;
 	if (query.isEmpty())
 	{
@@ -195,14 +265,14 @@ void FileList::populate()
 				END AS displayName
 			FROM file
 			LEFT JOIN file_tag ON file_tag.file_id = file.id
-			WHERE :tags
+			WHERE :dir AND :tags
 			ORDER BY %1 %2, file.name ASC
 			LIMIT ? OFFSET ?;
 		)"_s.arg(sortBy, sortOrder);
 		sqlCount = uR"(
 			SELECT COUNT(*) FROM file
 			LEFT JOIN file_tag ON file_tag.file_id = file.id
-			WHERE :tags;
+			WHERE :dir AND :tags;
 		)"_s;
 	}
 	else
@@ -219,36 +289,40 @@ void FileList::populate()
 					WHEN LENGTH(file.alias) > 0 THEN file.alias
 					ELSE file.name
 				END AS displayName,
-				bm25(file_search, 15.0, 15.0, 10.0, 5.0) AS relevancy
+				%3 AS relevancy
 			FROM file
-			INNER JOIN file_search ON file_search.ROWID = file.id
+			INNER JOIN %4 ON %4.ROWID = file.id
 			LEFT JOIN file_tag ON file_tag.file_id = file.id
-			WHERE :tags AND file_search MATCH ?
+			WHERE :dir AND :tags AND %4 MATCH ?
 			ORDER BY %1 %2, file.name ASC
 			LIMIT ? OFFSET ?;
-		)"_s.arg(sortBy, sortOrder);
+		)"_s.arg(sortBy, sortOrder, relevancy, searchTable);
 		sqlCount = uR"(
 			SELECT COUNT(*) FROM file
-			INNER JOIN file_search ON file_search.ROWID = file.id
+			INNER JOIN %1 ON %1.ROWID = file.id
 			LEFT JOIN file_tag ON file_tag.file_id = file.id
-			WHERE :tags AND file_search MATCH ?;
-		)"_s;
+			WHERE :dir AND :tags AND %1 MATCH ?;
+		)"_s.arg(searchTable);
 	}
 
+	// a subtree is one range of directory_closure
+	const QString dirCondition = m_directory.id() >= 0
+		? u"file.dir_id IN (SELECT descendant_id FROM directory_closure WHERE ancestor_id = ?)"_s
+		: u"1"_s;
+	sql.replace(":dir", dirCondition);
+	sqlCount.replace(":dir", dirCondition);
+
 	QByteArrayList include, exclude;
 	QString condition = parseTags(tags, include, exclude);
 	sql.replace(":tags", condition);
 	sqlCount.replace(":tags", condition);
 
-	QStringList query_parts = query.split(' ', Qt::SkipEmptyParts);
-	for (QString& part : query_parts)
-		part = part + u"*"_s;
-	QByteArray query_bytes = query_parts.join(' ').toUtf8();
-
 	int i = 0;
 	sqlite3_stmt* stmt;
 	QByteArray sql_bytes = sql.toUtf8();
 	sqlite3_prepare_v2(db->con(), sql_bytes.constData(), -1, &stmt, nullptr);
+	if (m_directory.id() >= 0)
+		sqlite3_bind_int64(stmt, ++i, m_directory.id());
 	for (const QByteArray& tag : include)
 		sqlite3_bind_text(stmt, ++i, tag.constData(), -1, SQLITE_STATIC);
 	for (const QByteArray& tag : exclude)
@@ -265,6 +339,8 @@ void FileList::populate()
 	i = 0;
 	QByteArray sqlCount_bytes = sqlCount.toUtf8();
 	sqlite3_prepare_v2(db->con(), sqlCount_bytes.constData(), -1, &stmt, nullptr);
+	if (m_directory.id() >= 0)
+		sqlite3_bind_int64(stmt, ++i, m_directory.id());
 	for (const QByteArray& tag : include)
 		sqlite3_bind_text(stmt, ++i, tag.constData(), -1, SQLITE_STATIC);
 	for (const QByteArray& tag : exclude)
@@ -281,6 +357,27 @@ void FileList::populate()
 	sqlite3_finalize(stmt);
 }
 
+void FileList::checkTagQuery()
+{
+	// unknown tags silently match nothing, so point out likely typos
+	QStringList hints;
+	for (QString name : m_ui->tagLineEdit->text().split(' ', Qt::SkipEmptyParts))
+	{
+		if (name.startsWith('!'))
+			name.remove(0, 1);
+		if (name.isEmpty() || TagDictionary::instance()->contains(name))
+			continue;
+		const QStringList suggestions = TagDictionary::instance()->suggest(name, 1);
+		if (suggestions.isEmpty())
+			hints.append(tr("Unknown tag: %1").arg(name));
+		else
+			hints.append(tr("Unknown tag: %1, did you mean %2?").arg(name, suggestions.first()));
+	}
+	if (hints.isEmpty())
+		return QToolTip::hideText();
+	QToolTip::showText(m_ui->tagLineEdit->mapToGlobal(QPoint(0, m_ui->tagLineEdit->height())), hints.join('\n'), m_ui->tagLineEdit);
+}
+
 QString FileList::parseTags(const QString& query, QByteArrayList& include, QByteArrayList& exclude)
 {
 	if (query.isEmpty())
@@ -337,6 +434,21 @@ void FileList::appendToTagQuery(const QString& text)
 		m_ui->tagLineEdit->setText(existingText + u" "_s + text);
 }
 
+void FileList::setDirectory(const Directory& directory)
+{
+	if (directory == m_directory)
+		return;
+	m_directory = directory;
+	if (m_directory.id() >= 0)
+	{
+		m_ui->directoryButton->setText(m_directory.name());
+		m_ui->directoryButton->setToolTip(tr("Showing files in %1, click to show all").arg(m_directory.path()));
+	}
+	m_ui->directoryButton->setVisible(m_directory.id() >= 0);
+	m_ui->paginator->setPage(0);
+	populate();
+}
+
 void FileList::actionAdd_triggered()
 {
 	NewFileDialog* dialog = new NewFileDialog(this);
@@ -419,6 +531,7 @@ void FileList::clearQuery()
 {
 	m_ui->tagLineEdit->clear();
 	m_ui->nameLineEdit->clear();
+	setDirectory(Directory());
 }
 
 void FileList::readSettings()
@@ -433,6 +546,7 @@ void FileList::readSettings()
 	m_ui->sortBy->setCurrentIndex(settings.value("GUI/FileList/sortBy", 0).toInt());
 	m_ui->sortOrder->setCurrentIndex(settings.value("GUI/FileList/sortOrder", 0).toInt());
 	m_ui->actionSortByRelevancy->setChecked(settings.value("GUI/FileList/sortByRelevancy", true).toBool());
+	m_ui->actionMatchSubstrings->setChecked(settings.value("GUI/FileList/matchSubstrings", false).toBool());
 }
 
 void FileList::writeSettings()
@@ -443,4 +557,5 @@ void FileList::writeSettings()
 	settings.setValue("GUI/FileList/sortBy", m_ui->sortBy->currentIndex());
 	settings.setValue("GUI/FileList/sortOrder", m_ui->sortOrder->currentIndex());
 	settings.setValue("GUI/FileList/sortByRelevancy", m_ui->actionSortByRelevancy->isChecked());
+	settings.setValue("GUI/FileList/matchSubstrings", m_ui->actionMatchSubstrings->isChecked());
 }
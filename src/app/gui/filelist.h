@@ -22,6 +22,8 @@ public:
 	void checkSelected();
 	void deleteSelected();
 	void appendToTagQuery(const QString& text);
+	// limits the list to files inside directory or any of its subdirectories
+	void setDirectory(const Directory& directory);
 
 signals:
 	void selectionChanged(QList<File> selected);
@@ -38,7 +40,9 @@ private slots:
 private:
 	Ui::FileList* m_ui;
 	FileTableModel* m_model;
+	Directory m_directory;
 	void populate();
+	void checkTagQuery();
 	QString parseTags(const QString& query, QByteArrayList& include, QByteArrayList& exclude);
 	void clearQuery();
 	void readSettings();
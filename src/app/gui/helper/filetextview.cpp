@@ -0,0 +1,491 @@
+#include "filetextview.h"
+
+#include <QFontDatabase>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStringDecoder>
+#include <QVarLengthArray>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "app/globals.h"
+
+FileTextView::FileTextView(QWidget* parent)
+	: QAbstractScrollArea(parent)
+	, m_data(nullptr)
+	, m_size(0)
+	, m_mode(Text)
+	, m_encoding(Utf8)
+	, m_start(0)
+	, m_top(0)
+	, m_shift(0)
+	, m_maxLineWidth(0)
+{
+	setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	setFocusPolicy(Qt::StrongFocus);
+	// line and page steps are measured in lines, which have no fixed size in
+	// bytes, so handle them here instead of letting the scroll bar step
+	connect(verticalScrollBar(), &QScrollBar::actionTriggered, this, [this](int action) -> void
+		{
+			switch (action)
+			{
+			case QAbstractSlider::SliderSingleStepAdd: scrollRows(1); break;
+			case QAbstractSlider::SliderSingleStepSub: scrollRows(-1); break;
+			case QAbstractSlider::SliderPageStepAdd: scrollRows(visibleRows()); break;
+			case QAbstractSlider::SliderPageStepSub: scrollRows(-visibleRows()); break;
+			default: return;
+			}
+			verticalScrollBar()->setSliderPosition(verticalScrollBar()->value());
+		});
+}
+
+FileTextView::~FileTextView()
+{
+	clear();
+}
+
+bool FileTextView::setFile(const QString& path)
+{
+	clear();
+	m_file.setFileName(path);
+	if (!m_file.open(QIODevice::ReadOnly))
+		return false;
+	m_size = m_file.size();
+	if (m_size > 0)
+		m_data = m_file.map(0, m_size);
+	if (!m_data)
+	{
+		clear();
+		return false;
+	}
+	sniff();
+	m_top = m_start;
+	horizontalScrollBar()->setValue(0);
+	updateScrollBars();
+	viewport()->update();
+	return true;
+}
+
+void FileTextView::clear()
+{
+	if (m_data)
+		m_file.unmap(m_data);
+	m_data = nullptr;
+	m_file.close();
+	m_size = 0;
+	m_mode = Text;
+	m_encoding = Utf8;
+	m_start = 0;
+	m_top = 0;
+	m_maxLineWidth = 0;
+	updateScrollBars();
+	viewport()->update();
+}
+
+FileTextView::Mode FileTextView::mode() const
+{
+	return m_mode;
+}
+
+FileTextView::Encoding FileTextView::encoding() const
+{
+	return m_encoding;
+}
+
+void FileTextView::sniff()
+{
+	m_mode = Text;
+	m_encoding = Utf8;
+	m_start = 0;
+	const qint64 n = std::min(SNIFF_SIZE, m_size);
+	const uchar* p = m_data;
+	if (n >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+	{
+		m_start = 3;
+		return;
+	}
+	if (n >= 2 && p[0] == 0xFF && p[1] == 0xFE)
+	{
+		m_encoding = Utf16LE;
+		m_start = 2;
+		return;
+	}
+	if (n >= 2 && p[0] == 0xFE && p[1] == 0xFF)
+	{
+		m_encoding = Utf16BE;
+		m_start = 2;
+		return;
+	}
+
+	qint64 nulEven = 0, nulOdd = 0, control = 0;
+	for (qint64 i = 0; i < n; ++i)
+	{
+		const uchar c = p[i];
+		if (c == 0)
+			++(i % 2 ? nulOdd : nulEven);
+		else if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != 0x1B)
+			++control;
+	}
+	if (nulEven + nulOdd > 0)
+	{
+		// mostly-ASCII UTF-16 without a BOM has a zero in every other byte
+		if (nulEven == 0 && nulOdd * 5 > n * 2)
+			m_encoding = Utf16LE;
+		else if (nulOdd == 0 && nulEven * 5 > n * 2)
+			m_encoding = Utf16BE;
+		else
+			m_mode = Hex;
+		return;
+	}
+	if (control * 20 > n)
+	{
+		m_mode = Hex;
+		return;
+	}
+	// a stateful decoder does not flag a sequence cut off by the sniff window.
+	// decode() only decodes once its result is turned into a string, so the
+	// text goes into a scratch buffer that is never looked at
+	QStringDecoder decoder(QStringConverter::Utf8);
+	QVarLengthArray<char16_t, 1024> scratch(decoder.requiredSpace(n));
+	decoder.appendToBuffer(scratch.data(), QByteArrayView(p, n));
+	if (decoder.hasError())
+		m_encoding = Latin1;
+}
+
+int FileTextView::unitSize() const
+{
+	return m_encoding == Utf16LE || m_encoding == Utf16BE ? 2 : 1;
+}
+
+bool FileTextView::isNewline(qint64 pos) const
+{
+	switch (m_encoding)
+	{
+	case Utf16LE:
+		return pos + 1 < m_size && m_data[pos] == '\n' && m_data[pos + 1] == 0;
+	case Utf16BE:
+		return pos + 1 < m_size && m_data[pos] == 0 && m_data[pos + 1] == '\n';
+	default:
+		return m_data[pos] == '\n';
+	}
+}
+
+qint64 FileTextView::lineStart(qint64 pos) const
+{
+	const int unit = unitSize();
+	const qint64 limit = std::max(m_start, pos - MAX_LINE_BYTES);
+	for (qint64 q = pos - unit; q >= limit; q -= unit)
+		if (isNewline(q))
+			return q + unit;
+	// do not start a row in the middle of a character
+	qint64 start = limit;
+	if (m_encoding == Utf8)
+		while (start < pos && (m_data[start] & 0xC0) == 0x80)
+			++start;
+	return start;
+}
+
+qint64 FileTextView::lineEnd(qint64 pos) const
+{
+	const qint64 limit = std::min(m_size, pos + MAX_LINE_BYTES);
+	if (unitSize() == 1)
+	{
+		const void* hit = std::memchr(m_data + pos, '\n', limit - pos);
+		return hit ? static_cast<const uchar*>(hit) - m_data : limit;
+	}
+	for (qint64 q = pos; q + 1 < limit; q += 2)
+		if (isNewline(q))
+			return q;
+	return limit;
+}
+
+qint64 FileTextView::nextLine(qint64 pos) const
+{
+	const qint64 end = lineEnd(pos);
+	if (end < m_size && isNewline(end))
+		return end + unitSize();
+	// lines longer than MAX_LINE_BYTES continue on the next row
+	return end;
+}
+
+qint64 FileTextView::previousLine(qint64 pos) const
+{
+	if (pos <= m_start)
+		return m_start;
+	return lineStart(pos - unitSize());
+}
+
+qint64 FileTextView::lastPageStart() const
+{
+	if (m_mode == Hex)
+	{
+		const qint64 rows = (m_size + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES;
+		return std::max<qint64>(0, rows - visibleRows()) * HEX_ROW_BYTES;
+	}
+	qint64 pos = lineStart(m_size);
+	for (int i = 1; i < visibleRows() && pos > m_start; ++i)
+		pos = previousLine(pos);
+	return pos;
+}
+
+QStringConverter::Encoding FileTextView::converter() const
+{
+	switch (m_encoding)
+	{
+	case Utf16LE:
+		return QStringConverter::Utf16LE;
+	case Utf16BE:
+		return QStringConverter::Utf16BE;
+	case Latin1:
+		return QStringConverter::Latin1;
+	default:
+		return QStringConverter::Utf8;
+	}
+}
+
+QString FileTextView::decode(qint64 from, qint64 to, QStringDecoder& decoder) const
+{
+	qint64 length = to - from;
+	// drop the carriage return of CRLF line endings
+	if (m_encoding == Utf16LE)
+	{
+		if (length >= 2 && m_data[to - 2] == '\r' && m_data[to - 1] == 0)
+			length -= 2;
+	}
+	else if (m_encoding == Utf16BE)
+	{
+		if (length >= 2 && m_data[to - 2] == 0 && m_data[to - 1] == '\r')
+			length -= 2;
+	}
+	else if (length >= 1 && m_data[to - 1] == '\r')
+		length -= 1;
+
+	QString text = decoder.decode(QByteArrayView(m_data + from, length));
+	return text.replace('\t', u"    "_s);
+}
+
+QString FileTextView::hexRow(qint64 offset, int offsetDigits) const
+{
+	static const char digits[] = "0123456789abcdef";
+	const qint64 count = std::min<qint64>(HEX_ROW_BYTES, m_size - offset);
+	QString row = QString::number(offset, 16).rightJustified(offsetDigits, '0') + u"  "_s;
+	QString ascii;
+	for (int i = 0; i < HEX_ROW_BYTES; ++i)
+	{
+		if (i < count)
+		{
+			const uchar c = m_data[offset + i];
+			row += QLatin1Char(digits[c >> 4]);
+			row += QLatin1Char(digits[c & 0xF]);
+			ascii += c >= 0x20 && c < 0x7F ? QLatin1Char(static_cast<char>(c)) : QLatin1Char('.');
+		}
+		else
+			row += u"  "_s;
+		row += i == HEX_ROW_BYTES / 2 - 1 ? u"  "_s : u" "_s;
+	}
+	return row + u" "_s + ascii;
+}
+
+int FileTextView::visibleRows() const
+{
+	return std::max(1, viewport()->height() / fontMetrics().lineSpacing());
+}
+
+void FileTextView::scrollRows(qint64 rows)
+{
+	if (!m_data)
+		return;
+	if (m_mode == Hex)
+	{
+		const qint64 lastRow = lastPageStart() / HEX_ROW_BYTES;
+		m_top = std::clamp(m_top / HEX_ROW_BYTES + rows, qint64(0), lastRow) * HEX_ROW_BYTES;
+	}
+	else if (rows > 0)
+	{
+		const qint64 last = lastPageStart();
+		for (qint64 i = 0; i < rows && m_top < last; ++i)
+			m_top = nextLine(m_top);
+	}
+	else
+	{
+		for (qint64 i = 0; i > rows && m_top > m_start; --i)
+			m_top = previousLine(m_top);
+	}
+	syncScrollBar();
+	viewport()->update();
+}
+
+void FileTextView::updateScrollBars()
+{
+	QScrollBar* bar = verticalScrollBar();
+	const qint64 units = m_mode == Hex
+		? (m_size + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES
+		: m_size;
+	m_shift = 0;
+	while ((units >> m_shift) > std::numeric_limits<int>::max() / 2)
+		++m_shift;
+	bar->blockSignals(true);
+	if (m_mode == Hex)
+	{
+		bar->setRange(0, static_cast<int>((lastPageStart() / HEX_ROW_BYTES) >> m_shift));
+		bar->setPageStep(std::max(1, visibleRows() >> m_shift));
+	}
+	else
+	{
+		// the handle covers the bytes of the page at the top, lines are too
+		// uneven for anything better without reading the whole file
+		qint64 pageEnd = m_top;
+		for (int i = 0; i < visibleRows() && pageEnd < m_size; ++i)
+			pageEnd = nextLine(pageEnd);
+		bar->setRange(0, static_cast<int>(lastPageStart() >> m_shift));
+		bar->setPageStep(std::max(1, static_cast<int>((pageEnd - m_top) >> m_shift)));
+	}
+	bar->blockSignals(false);
+	syncScrollBar();
+	horizontalScrollBar()->setRange(0, std::max(0, m_maxLineWidth - viewport()->width()));
+	horizontalScrollBar()->setPageStep(viewport()->width());
+}
+
+void FileTextView::syncScrollBar()
+{
+	QScrollBar* bar = verticalScrollBar();
+	bar->blockSignals(true);
+	if (m_mode == Hex)
+		bar->setValue(static_cast<int>((m_top / HEX_ROW_BYTES) >> m_shift));
+	else if (m_data && m_top >= lastPageStart())
+		bar->setValue(bar->maximum());
+	else
+		bar->setValue(static_cast<int>(m_top >> m_shift));
+	bar->blockSignals(false);
+}
+
+void FileTextView::scrollContentsBy(int dx, int dy)
+{
+	if (dy != 0 && m_data)
+	{
+		const QScrollBar* bar = verticalScrollBar();
+		const qint64 value = static_cast<qint64>(bar->value()) << m_shift;
+		if (m_mode == Hex)
+			m_top = std::min(value * HEX_ROW_BYTES, lastPageStart());
+		else if (bar->value() >= bar->maximum())
+			m_top = lastPageStart();
+		else
+		{
+			// snap the dragged byte offset to the start of its line
+			const int unit = unitSize();
+			const qint64 pos = m_start + (std::max(value, m_start) - m_start) / unit * unit;
+			m_top = lineStart(std::min(pos, m_size));
+		}
+	}
+	viewport()->update();
+}
+
+void FileTextView::paintEvent(QPaintEvent* event)
+{
+	if (!m_data)
+		return;
+	QPainter painter(viewport());
+	const QFontMetrics metrics = fontMetrics();
+	const int lineHeight = metrics.lineSpacing();
+	const int rows = visibleRows() + 1;
+	const int x = 4 - horizontalScrollBar()->value();
+	int y = metrics.ascent();
+	int maxWidth = m_maxLineWidth;
+	if (m_mode == Hex)
+	{
+		int offsetDigits = 8;
+		while (offsetDigits < 16 && ((m_size - 1) >> (offsetDigits * 4)) > 0)
+			++offsetDigits;
+		for (int i = 0; i < rows; ++i)
+		{
+			const qint64 offset = m_top + static_cast<qint64>(i) * HEX_ROW_BYTES;
+			if (offset >= m_size)
+				break;
+			const QString row = hexRow(offset, offsetDigits);
+			painter.drawText(x, y, row);
+			maxWidth = std::max(maxWidth, metrics.horizontalAdvance(row));
+			y += lineHeight;
+		}
+	}
+	else
+	{
+		// a line longer than MAX_LINE_BYTES is cut into rows wherever the
+		// limit falls, so a character cut in two is carried to the next row
+		QStringDecoder decoder(converter());
+		qint64 pos = m_top;
+		for (int i = 0; i < rows && pos < m_size; ++i)
+		{
+			const qint64 end = lineEnd(pos);
+			const QString line = decode(pos, end, decoder);
+			painter.drawText(x, y, line);
+			maxWidth = std::max(maxWidth, metrics.horizontalAdvance(line));
+			y += lineHeight;
+			pos = nextLine(pos);
+			if (pos != end)
+				decoder.resetState();
+		}
+	}
+	// the widest line is only known once it has been on screen
+	if (maxWidth > m_maxLineWidth)
+	{
+		m_maxLineWidth = maxWidth + 8;
+		horizontalScrollBar()->setRange(0, std::max(0, m_maxLineWidth - viewport()->width()));
+	}
+	event->accept();
+}
+
+void FileTextView::resizeEvent(QResizeEvent* event)
+{
+	QAbstractScrollArea::resizeEvent(event);
+	updateScrollBars();
+}
+
+void FileTextView::wheelEvent(QWheelEvent* event)
+{
+	const int delta = event->angleDelta().y();
+	if (delta == 0 || !m_data)
+		return QAbstractScrollArea::wheelEvent(event);
+	const int rows = -delta * 3 / 120;
+	scrollRows(rows != 0 ? rows : (delta > 0 ? -1 : 1));
+	event->accept();
+}
+
+void FileTextView::keyPressEvent(QKeyEvent* event)
+{
+	if (!m_data)
+		return QAbstractScrollArea::keyPressEvent(event);
+	switch (event->key())
+	{
+	case Qt::Key_Up:
+		scrollRows(-1);
+		break;
+	case Qt::Key_Down:
+		scrollRows(1);
+		break;
+	case Qt::Key_PageUp:
+		scrollRows(-visibleRows());
+		break;
+	case Qt::Key_PageDown:
+		scrollRows(visibleRows());
+		break;
+	case Qt::Key_Home:
+		m_top = m_mode == Hex ? 0 : m_start;
+		syncScrollBar();
+		viewport()->update();
+		break;
+	case Qt::Key_End:
+		m_top = lastPageStart();
+		syncScrollBar();
+		viewport()->update();
+		break;
+	default:
+		return QAbstractScrollArea::keyPressEvent(event);
+	}
+	event->accept();
+}
+
+const qint64 FileTextView::SNIFF_SIZE = 4096;
+const qint64 FileTextView::MAX_LINE_BYTES = 4096;
+const int FileTextView::HEX_ROW_BYTES = 16;
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QAbstractScrollArea>
+#include <QFile>
+#include <QStringDecoder>
+
+/**
+ * Read-only view over a memory-mapped file. Only the rows that fit in the
+ * viewport are decoded, so opening a file costs the same regardless of its
+ * size. Text files are scrolled by byte offset and snapped to line starts,
+ * which avoids having to index every line up front.
+ */
+class FileTextView : public QAbstractScrollArea
+{
+	Q_OBJECT
+
+public:
+	explicit FileTextView(QWidget* parent = nullptr);
+	virtual ~FileTextView() override;
+	enum Mode { Text, Hex };
+	enum Encoding { Utf8, Utf16LE, Utf16BE, Latin1 };
+	bool setFile(const QString& path);
+	void clear();
+	Mode mode() const;
+	Encoding encoding() const;
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+	void resizeEvent(QResizeEvent* event) override;
+	void wheelEvent(QWheelEvent* event) override;
+	void keyPressEvent(QKeyEvent* event) override;
+	void scrollContentsBy(int dx, int dy) override;
+
+private:
+	static const qint64 SNIFF_SIZE;
+	static const qint64 MAX_LINE_BYTES;
+	static const int HEX_ROW_BYTES;
+	QFile m_file;
+	uchar* m_data;
+	qint64 m_size;
+	Mode m_mode;
+	Encoding m_encoding;
+	// length of the byte order mark, if any
+	qint64 m_start;
+	// offset of the first visible line (text) or row (hex)
+	qint64 m_top;
+	// scroll bar values are offsets shifted right by this, to fit in an int
+	int m_shift;
+	int m_maxLineWidth;
+	void sniff();
+	int unitSize() const;
+	bool isNewline(qint64 pos) const;
+	qint64 lineStart(qint64 pos) const;
+	qint64 lineEnd(qint64 pos) const;
+	qint64 nextLine(qint64 pos) const;
+	qint64 previousLine(qint64 pos) const;
+	qint64 lastPageStart() const;
+	QStringConverter::Encoding converter() const;
+	QString decode(qint64 from, qint64 to, QStringDecoder& decoder) const;
+	QString hexRow(qint64 offset, int offsetDigits) const;
+	int visibleRows() const;
+	void scrollRows(qint64 rows);
+	void updateScrollBars();
+	void syncScrollBar();
+};
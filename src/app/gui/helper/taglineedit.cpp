@@ -2,7 +2,7 @@
 
 #include <QCompleter>
 #include "app/globals.h"
-#include "app/tag.h"
+#include "app/tagdictionary.h"
 
 TagLineEdit::TagLineEdit(QWidget* parent)
 	: QLineEdit(parent)
@@ -48,35 +48,30 @@ void TagCompleterModel::updateSuggestions(const QString& text)
 	QString base, prefix;
 	qsizetype i = std::max(text.lastIndexOf(' '), text.lastIndexOf('!'));
 	if (i == -1)
-		prefix = text + u"*"_s;
+		prefix = text;
 	else
 	{
 		base = text.sliced(0, i + 1);
-		prefix = text.sliced(i + 1) + u"*"_s;
-	}	
+		prefix = text.sliced(i + 1);
+	}
 	if (prefix.isEmpty())
 		return clear();
 
-	QStringList tags;
-	sqlite3_stmt* stmt;
-	const char* sql = R"(
-		SELECT name FROM tag_search
-		WHERE tag_search MATCH ?
-		ORDER BY bm25(tag_search, 10.0, 5.0)
-		LIMIT 16;
-	)";
-	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
-	QByteArray completion_bytes = prefix.toUtf8();
-	sqlite3_bind_text(stmt, 1, completion_bytes.constData(), -1, SQLITE_STATIC);
+	TagDictionary* dictionary = TagDictionary::instance();
+	QStringList names = dictionary->complete(prefix, 16);
+	// nothing starts with it, so it may be misspelled
+	if (names.isEmpty())
+		names = dictionary->suggest(prefix, 16);
+	QStringList suggestions;
+	for (const QString& name : names)
+		suggestions.append(base + name);
+	// resetting the model closes and reopens the popup, skip it when nothing
+	// changed
+	if (suggestions == m_suggestions)
+		return;
 	beginResetModel();
-	m_suggestions.clear();
-	while (sqlite3_step(stmt) == SQLITE_ROW)
-	{
-		QString suggestion = QString::fromUtf8((const char*)sqlite3_column_text(stmt, 0), sqlite3_column_bytes(stmt, 0));
-		m_suggestions.append(base + suggestion);
-	}
+	m_suggestions = suggestions;
 	endResetModel();
-	sqlite3_finalize(stmt);
 }
 
 void TagCompleterModel::clear()
@@ -10,6 +10,7 @@
 #include <QSettings>
 
 #include "app/database.h"
+#include "app/tagdictionary.h"
 
 TagSelect::TagSelect(QWidget *parent)
 	: TagSelect(QList<Tag>(), parent)
@@ -76,13 +77,21 @@ void TagSelect::add()
 	const QString query = m_ui->lineEdit->text()
 		.trimmed()
 		.toLower();
-	const Tag tag = Tag::fromName(query);
-	// use this instead of tag.exists because Tag::fromName already performs a
-	// query that verifies the tag does exist
+	// the dictionary only hands out ids of tags that exist
+	Tag tag = TagDictionary::instance()->find(query);
 	if (tag.id() < 0)
 	{
-		QMessageBox::warning(this, qApp->applicationName(), tr("Unknown tag: %1").arg(query));
-		return;
+		const QStringList suggestions = TagDictionary::instance()->suggest(query, 1);
+		if (suggestions.isEmpty())
+		{
+			QMessageBox::warning(this, qApp->applicationName(), tr("Unknown tag: %1").arg(query));
+			return;
+		}
+		QMessageBox::StandardButton button = QMessageBox::question(this, qApp->applicationName()
+			, tr("Unknown tag: %1\nDid you mean %2?").arg(query, suggestions.first()));
+		if (button != QMessageBox::Yes)
+			return;
+		tag = TagDictionary::instance()->find(suggestions.first());
 	}
 	if (m_model->contains(tag))
 	{
@@ -138,16 +147,22 @@ void TagSelect::importTags()
 	if (dialog.exec())
 	{
 		QStringList invalidTags;
-		for (const QString& name : dialog.textValue().trimmed().split(' '))
+		for (const QString& name : dialog.textValue().trimmed().split(' ', Qt::SkipEmptyParts))
 		{
-			Tag tag = Tag::fromName(name);
-			if (tag.exists())
+			Tag tag = TagDictionary::instance()->find(name);
+			if (tag.id() >= 0)
 			{
 				if (!m_model->contains(tag))
 					m_model->addTag(tag);
 			}
 			else
-				invalidTags.append(name);
+			{
+				const QStringList suggestions = TagDictionary::instance()->suggest(name, 1);
+				if (suggestions.isEmpty())
+					invalidTags.append(name);
+				else
+					invalidTags.append(tr("%1 (did you mean %2?)").arg(name, suggestions.first()));
+			}
 		}
 		if (!invalidTags.isEmpty())
 			QMessageBox::warning(this, tr("Some or all tags failed to import")
@@ -0,0 +1,462 @@
+#include "tiledimageview.h"
+
+#include <QFile>
+#include <QImageReader>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Reads regions of one image file, which is opened once and kept open for
+ * as long as tiles of it are wanted.
+ */
+class TiledImageView::TileReader
+{
+public:
+	QImage read(const QString& path, const QRect& clip, const QSize& size)
+	{
+		if (!m_file.isOpen() || m_file.fileName() != path)
+		{
+			m_reader.setDevice(nullptr);
+			m_file.close();
+			m_file.setFileName(path);
+			if (!m_file.open(QIODevice::ReadOnly))
+				return QImage();
+		}
+		// a handler is done with its device after one image, so the file is
+		// rewound and handed over again rather than reopened
+		if (!m_file.seek(0))
+			return QImage();
+		m_reader.setDevice(&m_file);
+		m_reader.setClipRect(clip);
+		m_reader.setScaledSize(size);
+		return m_reader.read();
+	}
+
+private:
+	QFile m_file;
+	QImageReader m_reader;
+};
+
+TiledImageView::TiledImageView(QWidget* parent)
+	: QWidget(parent)
+	, m_maxLevel(0)
+	, m_scale(1.0)
+	, m_fit(true)
+	, m_reader(std::make_unique<TileReader>())
+	, m_generation(0)
+	, m_decoding(false)
+	, m_needsFallback(false)
+	, m_fallbackScale(1.0)
+{
+	m_tiles.setMaxCost(TILE_CACHE_KIB);
+	m_pool.setMaxThreadCount(1);
+	setMouseTracking(false);
+}
+
+TiledImageView::~TiledImageView()
+{
+	m_pending.clear();
+	m_pool.waitForDone();
+}
+
+bool TiledImageView::setImage(const QString& path)
+{
+	clear();
+	QImageReader reader(path);
+	// without the size up front there is no telling what decoding costs
+	const QSize size = reader.size();
+	if (size.isEmpty() || !reader.canRead())
+		return false;
+	const bool tiled = reader.supportsOption(QImageIOHandler::ClipRect)
+		&& reader.supportsOption(QImageIOHandler::ScaledSize);
+	// a handler that cannot scale either decodes every pixel at once
+	if (!tiled && !reader.supportsOption(QImageIOHandler::ScaledSize)
+		&& static_cast<qint64>(size.width()) * size.height() > MAX_FALLBACK_PIXELS)
+		return false;
+
+	m_path = path;
+	m_size = size;
+	m_maxLevel = 0;
+	while ((TILE_SIZE << m_maxLevel) < std::max(m_size.width(), m_size.height()))
+		++m_maxLevel;
+	m_needsFallback = !tiled;
+	if (tiled)
+	{
+		// the coarsest level is a single tile, decode it now so there is
+		// always something to draw while finer tiles are pending. the worker
+		// may still be busy with the previous image, so this one gets a
+		// reader of its own
+		QSize target;
+		const QRect source = tileSource(m_maxLevel, 0, 0, &target);
+		TileReader first;
+		if (!insertTile(tileKey(m_maxLevel, 0, 0), readTile(first, m_path, QImage(), 1.0, source, target)))
+		{
+			clear();
+			return false;
+		}
+	}
+	fitToView();
+	return true;
+}
+
+void TiledImageView::clear()
+{
+	++m_generation;
+	m_decoding = false;
+	m_path.clear();
+	m_size = QSize();
+	m_maxLevel = 0;
+	m_tiles.clear();
+	m_pending.clear();
+	m_needsFallback = false;
+	m_fallback = QImage();
+	m_fallbackScale = 1.0;
+	m_fit = true;
+	update();
+}
+
+bool TiledImageView::isNull() const
+{
+	return m_size.isEmpty();
+}
+
+void TiledImageView::paintEvent(QPaintEvent* event)
+{
+	if (isNull())
+		return;
+	QPainter painter(this);
+	painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+	const QRectF imageRect(QPointF(0, 0), QSizeF(m_size));
+	const QRectF visible = QRectF(mapToImage(QPointF(0, 0)), mapToImage(QPointF(width(), height()))) & imageRect;
+	if (visible.isEmpty())
+		return;
+	const int level = levelForScale(m_scale * devicePixelRatioF());
+	const double span = TILE_SIZE << level;
+	const int x0 = static_cast<int>(std::floor(visible.left() / span));
+	const int y0 = static_cast<int>(std::floor(visible.top() / span));
+	const int x1 = static_cast<int>(std::ceil(visible.right() / span));
+	const int y1 = static_cast<int>(std::ceil(visible.bottom() / span));
+
+	QList<quint64> pending;
+	for (int y = y0; y < y1; ++y)
+		for (int x = x0; x < x1; ++x)
+		{
+			const quint64 key = tileKey(level, x, y);
+			if (const QImage* tile = m_tiles.object(key))
+				painter.drawImage(mapToView(tileRect(level, x, y) & imageRect), *tile);
+			else
+			{
+				drawFromCoarserLevel(painter, level, x, y);
+				pending.append(key);
+			}
+		}
+	if (!m_tiles.contains(tileKey(m_maxLevel, 0, 0)))
+		pending.prepend(tileKey(m_maxLevel, 0, 0));
+
+	// decode from the centre outwards, and forget tiles that are no longer
+	// visible so panning quickly does not queue up stale work
+	const QPointF center = mapToImage(QPointF(width(), height()) / 2);
+	std::stable_sort(pending.begin(), pending.end(), [this, center](quint64 a, quint64 b) -> bool
+		{
+			auto distance = [this, center](quint64 key) -> double
+				{
+					const QPointF d = tileRect(key >> 56, (key >> 28) & 0xFFFFFFF, key & 0xFFFFFFF).center() - center;
+					return d.x() * d.x() + d.y() * d.y();
+				};
+			return distance(a) < distance(b);
+		});
+	m_pending = pending;
+	decodeNext();
+	event->accept();
+}
+
+void TiledImageView::resizeEvent(QResizeEvent* event)
+{
+	if (m_fit)
+		fitToView();
+	else
+		clampCenter();
+	QWidget::resizeEvent(event);
+}
+
+void TiledImageView::wheelEvent(QWheelEvent* event)
+{
+	if (isNull())
+		return;
+	const QPointF anchor = mapToImage(event->position());
+	const double minScale = std::min(fitScale(), 1.0);
+	m_scale = std::clamp(m_scale * std::pow(1.0015, event->angleDelta().y()), minScale, 16.0);
+	// keep the point under the cursor in place
+	m_center = anchor - (event->position() - QPointF(width(), height()) / 2) / m_scale;
+	m_fit = m_scale <= fitScale();
+	clampCenter();
+	update();
+	event->accept();
+}
+
+void TiledImageView::mousePressEvent(QMouseEvent* event)
+{
+	if (event->button() != Qt::LeftButton || isNull())
+		return QWidget::mousePressEvent(event);
+	m_dragPos = event->position().toPoint();
+	setCursor(Qt::ClosedHandCursor);
+	event->accept();
+}
+
+void TiledImageView::mouseMoveEvent(QMouseEvent* event)
+{
+	if (!(event->buttons() & Qt::LeftButton) || isNull())
+		return QWidget::mouseMoveEvent(event);
+	const QPoint pos = event->position().toPoint();
+	m_center -= QPointF(pos - m_dragPos) / m_scale;
+	m_dragPos = pos;
+	m_fit = false;
+	clampCenter();
+	update();
+	event->accept();
+}
+
+void TiledImageView::mouseReleaseEvent(QMouseEvent* event)
+{
+	unsetCursor();
+	QWidget::mouseReleaseEvent(event);
+}
+
+void TiledImageView::mouseDoubleClickEvent(QMouseEvent* event)
+{
+	if (isNull())
+		return;
+	// toggle between fitting the widget and actual size around the cursor
+	if (m_fit)
+	{
+		const QPointF anchor = mapToImage(event->position());
+		m_scale = 1.0;
+		m_center = anchor - (event->position() - QPointF(width(), height()) / 2);
+		m_fit = false;
+		clampCenter();
+		update();
+	}
+	else
+		fitToView();
+	event->accept();
+}
+
+quint64 TiledImageView::tileKey(int level, int x, int y)
+{
+	return (static_cast<quint64>(level) << 56)
+		| (static_cast<quint64>(x & 0xFFFFFFF) << 28)
+		| static_cast<quint64>(y & 0xFFFFFFF);
+}
+
+int TiledImageView::levelForScale(double scale) const
+{
+	if (scale >= 1.0)
+		return 0;
+	return std::clamp(static_cast<int>(std::floor(std::log2(1.0 / scale))), 0, m_maxLevel);
+}
+
+double TiledImageView::fitScale() const
+{
+	if (isNull() || width() <= 0 || height() <= 0)
+		return 1.0;
+	return std::min(static_cast<double>(width()) / m_size.width(), static_cast<double>(height()) / m_size.height());
+}
+
+void TiledImageView::fitToView()
+{
+	m_scale = fitScale();
+	m_center = QPointF(m_size.width(), m_size.height()) / 2;
+	m_fit = true;
+	update();
+}
+
+void TiledImageView::clampCenter()
+{
+	const double halfWidth = width() / (2 * m_scale);
+	const double halfHeight = height() / (2 * m_scale);
+	// centre the image along any axis that fits entirely in the widget
+	if (halfWidth * 2 >= m_size.width())
+		m_center.setX(m_size.width() / 2.0);
+	else
+		m_center.setX(std::clamp(m_center.x(), halfWidth, m_size.width() - halfWidth));
+	if (halfHeight * 2 >= m_size.height())
+		m_center.setY(m_size.height() / 2.0);
+	else
+		m_center.setY(std::clamp(m_center.y(), halfHeight, m_size.height() - halfHeight));
+}
+
+QRectF TiledImageView::tileRect(int level, int x, int y) const
+{
+	const double span = TILE_SIZE << level;
+	return QRectF(x * span, y * span, span, span);
+}
+
+QRectF TiledImageView::mapToView(const QRectF& imageRect) const
+{
+	const QPointF viewCenter = QPointF(width(), height()) / 2;
+	return QRectF((imageRect.topLeft() - m_center) * m_scale + viewCenter, imageRect.size() * m_scale);
+}
+
+QPointF TiledImageView::mapToImage(const QPointF& viewPoint) const
+{
+	return m_center + (viewPoint - QPointF(width(), height()) / 2) / m_scale;
+}
+
+QRect TiledImageView::tileSource(int level, int x, int y, QSize* target) const
+{
+	const QRect source = tileRect(level, x, y).toAlignedRect() & QRect(QPoint(0, 0), m_size);
+	*target = QSize(
+		std::max(1, (source.width() + (1 << level) - 1) >> level),
+		std::max(1, (source.height() + (1 << level) - 1) >> level)
+	);
+	return source;
+}
+
+QImage TiledImageView::readFallback(const QString& path, const QSize& size)
+{
+	// decoded once at a resolution bounded by MAX_FALLBACK_SIZE, tiles are
+	// then cut from that
+	QImageReader reader(path);
+	if (reader.supportsOption(QImageIOHandler::ScaledSize))
+	{
+		int level = 0;
+		while (std::max(size.width(), size.height()) >> level > MAX_FALLBACK_SIZE)
+			++level;
+		reader.setScaledSize(QSize(std::max(1, size.width() >> level), std::max(1, size.height() >> level)));
+	}
+	QImage image = reader.read();
+	// the handler ignored the scaled size, so reduce it ourselves
+	while (std::max(image.width(), image.height()) > MAX_FALLBACK_SIZE)
+		image = image.scaled(std::max(1, image.width() / 2), std::max(1, image.height() / 2)
+			, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	return image;
+}
+
+QImage TiledImageView::readTile(TileReader& reader, const QString& path, const QImage& fallback, double fallbackScale
+	, const QRect& source, const QSize& target)
+{
+	if (source.isEmpty())
+		return QImage();
+	if (fallback.isNull())
+		return reader.read(path, source, target);
+	const QRect region = QRectF(QPointF(source.topLeft()) * fallbackScale, QSizeF(source.size()) * fallbackScale).toAlignedRect()
+		& fallback.rect();
+	QImage image = fallback.copy(region);
+	if (!image.isNull() && image.size() != target)
+		image = image.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	return image;
+}
+
+bool TiledImageView::insertTile(quint64 key, QImage image)
+{
+	if (image.isNull())
+		return false;
+	const qint64 cost = std::max<qint64>(1, image.sizeInBytes() / 1024);
+	return m_tiles.insert(key, new QImage(std::move(image)), cost);
+}
+
+void TiledImageView::decodeNext()
+{
+	// one tile at a time, so the order follows the view as it changes
+	if (m_decoding)
+		return;
+	// every tile is cut from the fallback, so it comes first
+	if (m_needsFallback && m_fallback.isNull())
+	{
+		if (m_pending.isEmpty())
+			return;
+		m_decoding = true;
+		m_pool.start([this, path = m_path, size = m_size, generation = m_generation]() -> void
+			{
+				QImage image = readFallback(path, size);
+				QMetaObject::invokeMethod(this, [this, generation, image = std::move(image)]() mutable -> void
+					{
+						fallbackDecoded(generation, std::move(image));
+					}, Qt::QueuedConnection);
+			});
+		return;
+	}
+	while (!m_pending.isEmpty())
+	{
+		const quint64 key = m_pending.takeFirst();
+		if (m_tiles.contains(key))
+			continue;
+		QSize target;
+		const QRect source = tileSource(key >> 56, (key >> 28) & 0xFFFFFFF, key & 0xFFFFFFF, &target);
+		if (source.isEmpty())
+			continue;
+		m_decoding = true;
+		m_pool.start([this, reader = m_reader.get(), path = m_path, fallback = m_fallback, fallbackScale = m_fallbackScale
+			, generation = m_generation, key, source, target]() -> void
+			{
+				QImage image = readTile(*reader, path, fallback, fallbackScale, source, target);
+				QMetaObject::invokeMethod(this, [this, generation, key, image = std::move(image)]() mutable -> void
+					{
+						tileDecoded(generation, key, std::move(image));
+					}, Qt::QueuedConnection);
+			});
+		return;
+	}
+}
+
+void TiledImageView::tileDecoded(quint64 generation, quint64 key, QImage image)
+{
+	if (generation != m_generation)
+		return;
+	m_decoding = false;
+	// a tile that fails is not asked for again until the next repaint
+	if (insertTile(key, std::move(image)))
+		update();
+	decodeNext();
+}
+
+void TiledImageView::fallbackDecoded(quint64 generation, QImage image)
+{
+	if (generation != m_generation)
+		return;
+	m_decoding = false;
+	if (image.isNull())
+		return clear();
+	// whichever did the reducing, the result says by how much
+	m_fallbackScale = static_cast<double>(image.width()) / m_size.width();
+	m_fallback = std::move(image);
+	update();
+	decodeNext();
+}
+
+bool TiledImageView::drawFromCoarserLevel(QPainter& painter, int level, int x, int y)
+{
+	const QRectF imageRect(QPointF(0, 0), QSizeF(m_size));
+	const QRectF child = tileRect(level, x, y) & imageRect;
+	for (int l = level + 1; l <= m_maxLevel; ++l)
+	{
+		const int shift = l - level;
+		const int px = x >> shift;
+		const int py = y >> shift;
+		const QImage* parent = m_tiles.object(tileKey(l, px, py));
+		if (!parent)
+			continue;
+		const QRectF parentRect = tileRect(l, px, py) & imageRect;
+		const double sx = parent->width() / parentRect.width();
+		const double sy = parent->height() / parentRect.height();
+		const QRectF sourceRect(
+			(child.left() - parentRect.left()) * sx,
+			(child.top() - parentRect.top()) * sy,
+			child.width() * sx,
+			child.height() * sy
+		);
+		painter.drawImage(mapToView(child), *parent, sourceRect);
+		return true;
+	}
+	return false;
+}
+
+const int TiledImageView::TILE_SIZE = 256;
+const int TiledImageView::TILE_CACHE_KIB = 64 * 1024;
+const int TiledImageView::MAX_FALLBACK_SIZE = 4096;
+// 256 MiB at four bytes a pixel
+const qint64 TiledImageView::MAX_FALLBACK_PIXELS = 64 * 1024 * 1024;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QSet>
+#include <QThreadPool>
+#include <QWidget>
+#include <memory>
+
+/**
+ * Displays an image by decoding only the tiles that are visible at the
+ * current zoom level. Each level halves the resolution of the one below it,
+ * so zooming out never decodes more pixels than the widget can show.
+ * Tiles are decoded one at a time on a worker thread, nearest to the centre
+ * first, and drawn from a coarser level until they arrive. Formats that
+ * cannot decode a region are decoded once on the worker instead, and
+ * refused if that would take more than MAX_FALLBACK_PIXELS.
+ */
+class TiledImageView : public QWidget
+{
+	Q_OBJECT
+
+public:
+	explicit TiledImageView(QWidget* parent = nullptr);
+	~TiledImageView() override;
+	bool setImage(const QString& path);
+	void clear();
+	bool isNull() const;
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+	void resizeEvent(QResizeEvent* event) override;
+	void wheelEvent(QWheelEvent* event) override;
+	void mousePressEvent(QMouseEvent* event) override;
+	void mouseMoveEvent(QMouseEvent* event) override;
+	void mouseReleaseEvent(QMouseEvent* event) override;
+	void mouseDoubleClickEvent(QMouseEvent* event) override;
+
+private:
+	class TileReader;
+	static const int TILE_SIZE;
+	static const int TILE_CACHE_KIB;
+	static const int MAX_FALLBACK_SIZE;
+	static const qint64 MAX_FALLBACK_PIXELS;
+	QString m_path;
+	QSize m_size;
+	int m_maxLevel;
+	// view pixels per image pixel
+	double m_scale;
+	// image coordinates shown at the centre of the widget
+	QPointF m_center;
+	bool m_fit;
+	QPoint m_dragPos;
+	QCache<quint64, QImage> m_tiles;
+	QList<quint64> m_pending;
+	// a single thread, so the reader it keeps open is never shared
+	QThreadPool m_pool;
+	std::unique_ptr<TileReader> m_reader;
+	// tiles decoded for an image that is no longer shown are dropped
+	quint64 m_generation;
+	bool m_decoding;
+	// used for formats that cannot decode a sub-region on their own, null
+	// until the worker has decoded it
+	bool m_needsFallback;
+	QImage m_fallback;
+	// fallback pixels per image pixel
+	double m_fallbackScale;
+	static quint64 tileKey(int level, int x, int y);
+	int levelForScale(double scale) const;
+	double fitScale() const;
+	void fitToView();
+	void clampCenter();
+	QRectF tileRect(int level, int x, int y) const;
+	QRectF mapToView(const QRectF& imageRect) const;
+	QPointF mapToImage(const QPointF& viewPoint) const;
+	QRect tileSource(int level, int x, int y, QSize* target) const;
+	static QImage readFallback(const QString& path, const QSize& size);
+	static QImage readTile(TileReader& reader, const QString& path, const QImage& fallback, double fallbackScale
+		, const QRect& source, const QSize& target);
+	bool insertTile(quint64 key, QImage image);
+	void decodeNext();
+	void tileDecoded(quint64 generation, quint64 key, QImage image);
+	void fallbackDecoded(quint64 generation, QImage image);
+	bool drawFromCoarserLevel(QPainter& painter, int level, int x, int y);
+};
@@ -1,12 +1,19 @@
 #include "mainwindow.h"
 
+#include <climits>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QSettings>
 
 #include "app/database.h"
+#include "app/file.h"
+#include "app/maintenance.h"
+#include "app/movetracker.h"
+#include "app/volume.h"
 #include "app/gui/dialog/newtagdialog.h"
 #include "app/gui/dialog/newfiledialog.h"
+#include "app/gui/dialog/relinkdialog.h"
+#include "app/gui/dialog/relocatedialog.h"
 #include "app/gui/docked/properties.h"
 #include "app/gui/docked/filepreview.h"
 #include "app/gui/docked/filters.h"
@@ -36,12 +43,27 @@ MainWindow::MainWindow(QWidget *parent)
 	m_ui.menuView->addAction(m_ui.filePreviewDock->toggleViewAction());
 	m_ui.menuView->addAction(m_ui.propertiesDock->toggleViewAction());
 	// tools
+	connect(m_ui.actionCompactDatabase, &QAction::triggered, this, &MainWindow::actionCompactDatabase_triggered);
+	connect(m_ui.actionRelocate, &QAction::triggered, this, &MainWindow::actionRelocate_triggered);
+	connect(m_ui.actionQuickScan, &QAction::triggered, this, &MainWindow::actionQuickScan_triggered);
+	connect(m_ui.actionRelink, &QAction::triggered, this, &MainWindow::actionRelink_triggered);
 	connect(m_ui.actionOptions, &QAction::triggered, this, &MainWindow::actionOptions_triggered);
 	// help
 	connect(m_ui.actionAboutQt, &QAction::triggered, this, &QApplication::aboutQt);
 
 	connect(db, &Database::opened, this, &MainWindow::unlockUi);
 	connect(db, &Database::closed, this, &MainWindow::lockUi);
+	connect(db, &Database::migrating, this, &MainWindow::showMigrationProgress);
+	connect(MaintenanceScheduler::instance(), &MaintenanceScheduler::started, this, [this]() -> void
+		{
+			statusBar()->showMessage(tr("Running database maintenance..."));
+		});
+	connect(MaintenanceScheduler::instance(), &MaintenanceScheduler::finished, this, [this]() -> void
+		{
+			statusBar()->clearMessage();
+		});
+	// follows files moved inside the watched directories from here on
+	MoveTracker::instance();
 
 	connect(m_ui.tabWidget, &QTabWidget::currentChanged, this, [this]() -> void {emit currentTabChanged((Tab)m_ui.tabWidget->currentIndex()); });
 
@@ -157,6 +179,10 @@ void MainWindow::lockUi()
 	m_ui.actionCheckSelected->setEnabled(false);
 	m_ui.actionDeleteSelected->setEnabled(false);
 	m_ui.actionCloseDatabase->setEnabled(false);
+	m_ui.actionCompactDatabase->setEnabled(false);
+	m_ui.actionRelocate->setEnabled(false);
+	m_ui.actionQuickScan->setEnabled(false);
+	m_ui.actionRelink->setEnabled(false);
 }
 
 void MainWindow::unlockUi()
@@ -168,6 +194,80 @@ void MainWindow::unlockUi()
 	m_ui.actionCheckSelected->setEnabled(true);
 	m_ui.actionDeleteSelected->setEnabled(true);
 	m_ui.actionCloseDatabase->setEnabled(true);
+	m_ui.actionCompactDatabase->setEnabled(true);
+	m_ui.actionRelocate->setEnabled(true);
+	m_ui.actionQuickScan->setEnabled(true);
+	m_ui.actionRelink->setEnabled(true);
+}
+
+void MainWindow::showMigrationProgress(const QString& description, int permille)
+{
+	if (!m_migrationDialog)
+	{
+		// modal so nothing touches the database until open() returns
+		m_migrationDialog = new QProgressDialog(this);
+		m_migrationDialog->setWindowTitle(tr("Updating database"));
+		m_migrationDialog->setWindowModality(Qt::ApplicationModal);
+		m_migrationDialog->setCancelButton(nullptr);
+		m_migrationDialog->setRange(0, 1000);
+		m_migrationDialog->setMinimumDuration(0);
+		m_migrationDialog->setAutoClose(false);
+	}
+	m_migrationDialog->setLabelText(description);
+	m_migrationDialog->setValue(permille);
+}
+
+void MainWindow::actionCompactDatabase_triggered()
+{
+	MaintenanceScheduler::instance()->vacuum();
+}
+
+void MainWindow::actionRelocate_triggered()
+{
+	RelocateDialog dialog(QString(), this);
+	dialog.exec();
+}
+
+void MainWindow::actionQuickScan_triggered()
+{
+	// existence only, one stat per file and no reads, so it stays fast on
+	// large libraries and slow mounts
+	int64_t total = 0;
+	for (const Directory& root : Directory::roots())
+		total += root.totalCount();
+	QProgressDialog progress(tr("Looking for missing files..."), tr("Abort"), 0, static_cast<int>(std::min<int64_t>(total, INT_MAX)), this);
+	progress.setWindowModality(Qt::ApplicationModal);
+	progress.setMinimumDuration(0);
+	int64_t missing = 0;
+	if (DBError error = db->begin())
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to scan files: ") + error.message());
+		return;
+	}
+	DBError error = File::checkAllExistence(&missing, [&progress](qsizetype done) -> bool
+		{
+			progress.setValue(static_cast<int>(std::min<qsizetype>(done, progress.maximum())));
+			return !progress.wasCanceled();
+		});
+	if (error)
+	{
+		db->rollback();
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to scan files: ") + error.message());
+		return;
+	}
+	db->commit();
+	const bool canceled = progress.wasCanceled();
+	progress.reset();
+	if (!canceled)
+		QMessageBox::information(this, qApp->applicationName(), missing
+			? tr("%n file(s) could not be found.", nullptr, static_cast<int>(missing))
+			: tr("All files are where they should be."));
+}
+
+void MainWindow::actionRelink_triggered()
+{
+	RelinkDialog dialog(this);
+	dialog.exec();
 }
 
 void MainWindow::actionOptions_triggered()
@@ -242,7 +342,9 @@ void MainWindow::writeSettings()
 
 void MainWindow::createDatabase(const QString& path)
 {
-	if (DBError error = db->open(path))
+	DBError error = db->open(path);
+	delete m_migrationDialog;
+	if (error)
 		QMessageBox::warning(this, tr("Failed to create new database"), error.message());
 	else
 	{
@@ -253,11 +355,40 @@ void MainWindow::createDatabase(const QString& path)
 
 void MainWindow::openDatabase(const QString& path)
 {
-	if (DBError error = db->open(path))
+	DBError error = db->open(path);
+	delete m_migrationDialog;
+	if (error)
 		QMessageBox::warning(this, tr("Failed to open existing database"), error.message());
 	else
 	{
 		setWindowTitle(qApp->applicationName() + " - " + path);
 		m_ui.statusbar->showMessage(tr("Database opened"), 2000);
+		// directories from before volumes were known, or whose drive was not
+		// there the last time
+		Volume::assignDirectories();
+		resumeImports();
 	}	
 }
+
+void MainWindow::resumeImports()
+{
+	for (const ImportJob& job : ImportJob::unfinished())
+	{
+		QMessageBox::StandardButton btn = QMessageBox::question(this, tr("Resume import")
+			, tr("Adding files from %1 was interrupted after %2 of %3 files. Resume it now?")
+				.arg(job.roots().join(u", "_s))
+				.arg(QLocale().toString(job.cursor()))
+				.arg(QLocale().toString(job.total()))
+			, QMessageBox::Yes | QMessageBox::No | QMessageBox::Discard);
+		if (btn == QMessageBox::Yes)
+			NewFileDialog::runImport(job, this);
+		else if (btn == QMessageBox::Discard)
+		{
+			db->begin();
+			if (job.remove())
+				db->rollback();
+			else
+				db->commit();
+		}
+	}
+}
@@ -4,6 +4,7 @@
 
 #include <QMainWindow>
 #include <QPointer>
+#include <QProgressDialog>
 #include <QCloseEvent>
 
 #include "app/gui/dialog/settingsdialog.h"
@@ -29,17 +30,24 @@ private slots:
 	void actionNewDatabase_triggered();
 	void actionOpenDatabase_triggered();
 	void actionCloseDatabase_triggered();
+	void actionCompactDatabase_triggered();
+	void actionRelocate_triggered();
+	void actionQuickScan_triggered();
+	void actionRelink_triggered();
 	void actionOptions_triggered();
 	void lockUi();
 	void unlockUi();
 	void updateRecentlyOpened();
+	void showMigrationProgress(const QString& description, int permille);
 
 private:
 	Ui::MainWindow m_ui;
 	QPointer<SettingsDialog> m_settingsDialog;
+	QPointer<QProgressDialog> m_migrationDialog;
 	void closeEvent(QCloseEvent* event) override;
 	void readSettings();
 	void writeSettings();
 	void createDatabase(const QString& path);
 	void openDatabase(const QString& path);
+	void resumeImports();
 };
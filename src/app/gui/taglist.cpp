@@ -4,6 +4,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QSettings>
+#include "app/bulkedit.h"
 #include "app/gui/dialog/edittagdialog.h"
 #include "app/gui/dialog/edittagdialogmulti.h"
 #include "app/gui/dialog/newtagdialog.h"
@@ -171,9 +172,21 @@ void TagList::deleteSelected()
 			? tr("Are you sure you want to delete %1 tags?").arg(tags.size())
 			: tr("Are you sure you want to delete '%1'?").arg(tags.first().name())
 	);
-	if (btn == QMessageBox::Yes)
-		for (const Tag& tag : tags)
-			tag.remove();
+	if (btn != QMessageBox::Yes)
+		return;
+	DBError error = db->beginBulk();
+	if (error)
+	{
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to delete tags: ") + error.message());
+		return;
+	}
+	if (error = TagBulkEdit(tags).remove())
+	{
+		db->rollback();
+		QMessageBox::warning(this, qApp->applicationName(), tr("Failed to delete tags: ") + error.message());
+		return;
+	}
+	db->commit();
 }
 
 void TagList::actionCreate_triggered()
@@ -0,0 +1,201 @@
+#include "hashcache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+#include "app/database.h"
+#include "app/globals.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+bool FileIdentity::isValid() const
+{
+	return size >= 0;
+}
+
+FileIdentity FileIdentity::of(const QString& path)
+{
+	FileIdentity identity;
+#ifdef Q_OS_WIN
+	HANDLE handle = CreateFileW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(path).utf16())
+		, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE
+		, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return identity;
+	BY_HANDLE_FILE_INFORMATION info;
+	if (GetFileInformationByHandle(handle, &info))
+	{
+		identity.device = info.dwVolumeSerialNumber;
+		identity.inode = (quint64(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+		identity.size = (qint64(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+		// 100 ns ticks since 1601, which overflow as nanoseconds. moved to
+		// the Unix epoch first, like st_mtim
+		const qint64 ticks = (qint64(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+		identity.mtimeNs = (ticks - 116444736000000000) * 100;
+	}
+	CloseHandle(handle);
+#else
+	struct stat st;
+	if (stat(QFile::encodeName(path).constData(), &st) != 0)
+		return identity;
+	identity.device = st.st_dev;
+	identity.inode = st.st_ino;
+	identity.size = st.st_size;
+#ifdef Q_OS_MACOS
+	identity.mtimeNs = qint64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	identity.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+	return identity;
+}
+
+bool FileIdentity::operator==(const FileIdentity& other) const
+{
+	return device == other.device && inode == other.inode && size == other.size && mtimeNs == other.mtimeNs;
+}
+
+bool FileIdentity::operator!=(const FileIdentity& other) const
+{
+	return !(*this == other);
+}
+
+HashCache::HashCache()
+	: m_con(nullptr)
+	, m_lookupStmt(nullptr)
+	, m_storeStmt(nullptr)
+{
+	const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+	QDir().mkpath(dir);
+	const QString path = QDir(dir).filePath(u"hashes.sqlite"_s);
+	if (int rc = sqlite3_open(path.toUtf8(), &m_con); rc != SQLITE_OK)
+	{
+		qWarning().nospace() << "Failed to open hash cache at " << path << ": " << sqlite3_errstr(rc);
+		sqlite3_close(m_con);
+		m_con = nullptr;
+		return;
+	}
+	sqlite3_busy_timeout(m_con, Database::BUSY_TIMEOUT);
+	// losing the last few entries on a crash only costs reading those files
+	// again
+	const char* sql = R"(
+		PRAGMA journal_mode = 'WAL';
+		PRAGMA synchronous = 'OFF';
+		CREATE TABLE IF NOT EXISTS digest(
+			device   INTEGER NOT NULL,
+			inode    INTEGER NOT NULL,
+			size     INTEGER NOT NULL,
+			mtime_ns INTEGER NOT NULL,
+			sha1     BLOB    NOT NULL,
+
+			PRIMARY KEY (device, inode)
+		) STRICT, WITHOUT ROWID;
+	)";
+	if (int rc = sqlite3_exec(m_con, sql, 0, 0, 0); rc != SQLITE_OK)
+	{
+		qWarning().nospace() << "Failed to set up hash cache at " << path << ": " << sqlite3_errmsg(m_con);
+		sqlite3_close(m_con);
+		m_con = nullptr;
+		return;
+	}
+	sqlite3_prepare_v3(m_con, "SELECT sha1 FROM digest WHERE device = ? AND inode = ? AND size = ? AND mtime_ns = ?;"
+		, -1, SQLITE_PREPARE_PERSISTENT, &m_lookupStmt, nullptr);
+	sqlite3_prepare_v3(m_con, "INSERT OR REPLACE INTO digest(device, inode, size, mtime_ns, sha1) VALUES (?, ?, ?, ?, ?);"
+		, -1, SQLITE_PREPARE_PERSISTENT, &m_storeStmt, nullptr);
+}
+
+HashCache::~HashCache()
+{
+	sqlite3_finalize(m_lookupStmt);
+	sqlite3_finalize(m_storeStmt);
+	sqlite3_close(m_con);
+	s_instance = nullptr;
+}
+
+HashCache* HashCache::instance()
+{
+	static QMutex mutex;
+	QMutexLocker locker(&mutex);
+	if (s_instance == nullptr)
+		s_instance = new HashCache();
+	return s_instance;
+}
+
+QByteArray HashCache::sha1(const QString& path)
+{
+	const FileIdentity before = FileIdentity::of(path);
+	if (!before.isValid())
+		return QByteArray();
+	if (QByteArray cached = lookup(before); !cached.isNull())
+		return cached;
+	const QByteArray sha1 = digest(path);
+	// only keep the digest if the file did not change while it was read
+	if (!sha1.isNull() && FileIdentity::of(path) == before)
+		store(before, sha1);
+	return sha1;
+}
+
+QByteArray HashCache::refresh(const QString& path)
+{
+	const FileIdentity before = FileIdentity::of(path);
+	const QByteArray sha1 = digest(path);
+	if (!sha1.isNull() && before.isValid() && FileIdentity::of(path) == before)
+		store(before, sha1);
+	return sha1;
+}
+
+QByteArray HashCache::lookup(const FileIdentity& identity)
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_con || !identity.isValid())
+		return QByteArray();
+	sqlite3_bind_int64(m_lookupStmt, 1, static_cast<sqlite3_int64>(identity.device));
+	sqlite3_bind_int64(m_lookupStmt, 2, static_cast<sqlite3_int64>(identity.inode));
+	sqlite3_bind_int64(m_lookupStmt, 3, identity.size);
+	sqlite3_bind_int64(m_lookupStmt, 4, identity.mtimeNs);
+	QByteArray sha1;
+	if (sqlite3_step(m_lookupStmt) == SQLITE_ROW)
+		sha1 = QByteArray(reinterpret_cast<const char*>(sqlite3_column_blob(m_lookupStmt, 0)), sqlite3_column_bytes(m_lookupStmt, 0));
+	sqlite3_reset(m_lookupStmt);
+	return sha1;
+}
+
+void HashCache::store(const FileIdentity& identity, const QByteArray& sha1)
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_con || !identity.isValid())
+		return;
+	sqlite3_bind_int64(m_storeStmt, 1, static_cast<sqlite3_int64>(identity.device));
+	sqlite3_bind_int64(m_storeStmt, 2, static_cast<sqlite3_int64>(identity.inode));
+	sqlite3_bind_int64(m_storeStmt, 3, identity.size);
+	sqlite3_bind_int64(m_storeStmt, 4, identity.mtimeNs);
+	sqlite3_bind_blob(m_storeStmt, 5, sha1.constData(), sha1.size(), SQLITE_STATIC);
+	sqlite3_step(m_storeStmt);
+	sqlite3_reset(m_storeStmt);
+}
+
+QByteArray HashCache::digest(const QString& path)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	char buff[4096];
+	while (!file.atEnd())
+	{
+		qint64 bytes = file.read(buff, 4096);
+		if (bytes < 0)
+			return QByteArray();
+		hash.addData(buff, bytes);
+	}
+	return hash.result();
+}
+
+HashCache* HashCache::s_instance = nullptr;
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include "sqlite3.h"
+
+/**
+ * What identifies the contents of a file without reading it: the device and
+ * inode (volume serial and file index on Windows), the size and the
+ * modification time. Hard links to one file share an identity.
+ */
+struct FileIdentity
+{
+	quint64 device = 0;
+	quint64 inode = 0;
+	qint64 size = -1;
+	qint64 mtimeNs = 0;
+	bool isValid() const;
+	static FileIdentity of(const QString& path);
+	bool operator==(const FileIdentity& other) const;
+	bool operator!=(const FileIdentity& other) const;
+};
+
+/**
+ * Digests of files already read, kept in a cache database of their own next
+ * to the other application caches, so a file that has not changed is never
+ * read twice, not by a later import or check and not by another database.
+ * Safe to use from several threads.
+ */
+class HashCache
+{
+public:
+	static HashCache* instance();
+	~HashCache();
+	// the SHA-1 of the file at path, from the cache if its identity is
+	// unchanged. a null array if the file could not be read
+	QByteArray sha1(const QString& path);
+	QByteArray lookup(const FileIdentity& identity);
+	void store(const FileIdentity& identity, const QByteArray& sha1);
+	// reads the file even if its identity is cached, and replaces the entry
+	// with what was read. for checks, which are what finds a stale entry
+	QByteArray refresh(const QString& path);
+	// reads the whole file, bypassing the cache
+	static QByteArray digest(const QString& path);
+
+private:
+	HashCache();
+	static HashCache* s_instance;
+	QMutex m_mutex;
+	sqlite3* m_con;
+	sqlite3_stmt* m_lookupStmt;
+	sqlite3_stmt* m_storeStmt;
+};
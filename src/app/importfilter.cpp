@@ -0,0 +1,142 @@
+#include "importfilter.h"
+
+#include <QFileInfo>
+#include <QHash>
+#include <QtEndian>
+#include <algorithm>
+
+#include "app/globals.h"
+
+BloomFilter::BloomFilter(qsizetype expected)
+{
+	addLayer(std::max<qsizetype>(64, expected));
+}
+
+void BloomFilter::addLayer(qsizetype capacity)
+{
+	Layer layer;
+	layer.bitCount = quint64(capacity) * BITS_PER_ITEM;
+	layer.bits.resize((layer.bitCount + 63) / 64);
+	layer.capacity = capacity;
+	layer.count = 0;
+	m_layers.push_back(std::move(layer));
+}
+
+void BloomFilter::add(QStringView value)
+{
+	if (m_layers.back().count >= m_layers.back().capacity)
+		addLayer(m_layers.back().capacity * 2);
+	Layer& layer = m_layers.back();
+	// double hashing, every probe is h1 + i * h2
+	const quint64 h1 = qHash(value, 0x9e3779b9);
+	const quint64 h2 = qHash(value, 0x85ebca6b) | 1;
+	for (int i = 0; i < HASH_COUNT; ++i)
+	{
+		const quint64 bit = (h1 + i * h2) % layer.bitCount;
+		layer.bits[bit / 64] |= quint64(1) << (bit % 64);
+	}
+	++layer.count;
+}
+
+bool BloomFilter::mayContain(QStringView value) const
+{
+	const quint64 h1 = qHash(value, 0x9e3779b9);
+	const quint64 h2 = qHash(value, 0x85ebca6b) | 1;
+	for (const Layer& layer : m_layers)
+	{
+		bool found = true;
+		for (int i = 0; i < HASH_COUNT && found; ++i)
+		{
+			const quint64 bit = (h1 + i * h2) % layer.bitCount;
+			found = layer.bits[bit / 64] & (quint64(1) << (bit % 64));
+		}
+		if (found)
+			return true;
+	}
+	return false;
+}
+
+ImportFilter::ImportFilter(qsizetype expected)
+{
+	if (db->isClosed())
+		return;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT COUNT(*) FROM file;", -1, &stmt, nullptr);
+	qsizetype count = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	// leave room for what the import adds, the filter grows past it when
+	// the walk finds more than was known up front
+	m_paths = BloomFilter(count + expected + 1024);
+	m_digests.reserve(count);
+	sqlite3_prepare_v2(db->con(), "SELECT dir, name, sha1 FROM file;", -1, &stmt, nullptr);
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		const QString dir = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+		const QString name = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1));
+		m_paths.add(joinPath(dir, name));
+		const QByteArray sha1(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, 2)), sqlite3_column_bytes(stmt, 2));
+		m_digests.push_back(prefix(sha1));
+	}
+	sqlite3_finalize(stmt);
+	std::sort(m_digests.begin(), m_digests.end());
+}
+
+bool ImportFilter::knownPath(const QString& path) const
+{
+	const QFileInfo fileInfo(path);
+	const QString dir = fileInfo.dir().absolutePath();
+	const QString name = fileInfo.fileName();
+	if (!m_paths.mayContain(joinPath(dir, name)))
+		return false;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT EXISTS(SELECT 1 FROM file WHERE name = ? AND dir = ?);", -1, &stmt, nullptr);
+	const QByteArray name_bytes = name.toUtf8();
+	const QByteArray dir_bytes = dir.toUtf8();
+	sqlite3_bind_text(stmt, 1, name_bytes.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, dir_bytes.constData(), -1, SQLITE_STATIC);
+	bool known = false;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		known = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return known;
+}
+
+File ImportFilter::duplicateOf(const QByteArray& sha1) const
+{
+	const quint64 key = prefix(sha1);
+	if (!std::binary_search(m_digests.begin(), m_digests.end(), key) && !m_added.contains(key))
+		return File();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id FROM file WHERE sha1 = ? ORDER BY id LIMIT 1;", -1, &stmt, nullptr);
+	sqlite3_bind_blob(stmt, 1, sha1.constData(), sha1.size(), SQLITE_STATIC);
+	File file;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		file = File(sqlite3_column_int64(stmt, 0));
+	sqlite3_finalize(stmt);
+	return file;
+}
+
+void ImportFilter::add(const QString& path, const QByteArray& sha1)
+{
+	const QFileInfo fileInfo(path);
+	m_paths.add(joinPath(fileInfo.dir().absolutePath(), fileInfo.fileName()));
+	m_added.insert(prefix(sha1));
+}
+
+QString ImportFilter::joinPath(const QString& dir, const QString& name)
+{
+	return dir.endsWith('/') ? dir + name : dir + '/' + name;
+}
+
+quint64 ImportFilter::prefix(const QByteArray& sha1)
+{
+	if (sha1.size() < 8)
+		return 0;
+	return qFromBigEndian<quint64>(sha1.constData());
+}
+
+const int BloomFilter::HASH_COUNT = 7;
+const int BloomFilter::BITS_PER_ITEM = 10;
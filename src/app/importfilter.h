@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+#include <vector>
+
+#include "app/file.h"
+
+/**
+ * A set of strings that answers "maybe" or "certainly not". Sized for an
+ * expected number of items at about one false positive in a hundred. Once
+ * more than that are added a layer twice the size is started, so the rate
+ * stays about the same however far off the guess was.
+ */
+class BloomFilter
+{
+public:
+	explicit BloomFilter(qsizetype expected = 0);
+	void add(QStringView value);
+	bool mayContain(QStringView value) const;
+
+private:
+	struct Layer
+	{
+		std::vector<quint64> bits;
+		quint64 bitCount;
+		qsizetype capacity;
+		qsizetype count;
+	};
+	static const int HASH_COUNT;
+	static const int BITS_PER_ITEM;
+	// only the last one is added to
+	std::vector<Layer> m_layers;
+	void addLayer(qsizetype capacity);
+};
+
+/**
+ * What an import already knows about, loaded once before it starts: the
+ * path of every stored file in a Bloom filter and the first eight bytes of
+ * every digest in a sorted array. Both only say when something is certainly
+ * new, a hit is confirmed against the database.
+ */
+class ImportFilter
+{
+public:
+	// expected is the number of files the import may still add
+	explicit ImportFilter(qsizetype expected = 0);
+	// true if path is stored already, without touching the disk
+	bool knownPath(const QString& path) const;
+	// a stored file with this digest, or an invalid File
+	File duplicateOf(const QByteArray& sha1) const;
+	// remembers a file added during the import
+	void add(const QString& path, const QByteArray& sha1);
+	static QString joinPath(const QString& dir, const QString& name);
+
+private:
+	BloomFilter m_paths;
+	std::vector<quint64> m_digests;
+	QSet<quint64> m_added;
+	static quint64 prefix(const QByteArray& sha1);
+};
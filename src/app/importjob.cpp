@@ -0,0 +1,281 @@
+#include "importjob.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "app/globals.h"
+
+ImportJob::ImportJob()
+	: m_id(-1)
+{}
+
+ImportJob::ImportJob(int64_t id)
+	: m_id(id)
+{}
+
+DBError ImportJob::create(const QStringList& roots, const ImportOptions& options, ImportJob* out)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	const QByteArray roots_json = QJsonDocument(QJsonArray::fromStringList(roots)).toJson(QJsonDocument::Compact);
+	const QByteArray options_json = QJsonDocument(QJsonObject{
+		{ u"alias"_s, options.alias },
+		{ u"comment"_s, options.comment },
+		{ u"source"_s, options.source },
+		{ u"recursive"_s, options.recursive },
+		{ u"ignoreHidden"_s, options.ignoreHidden },
+		{ u"ignore"_s, QJsonArray::fromStringList(options.ignore) },
+		{ u"duplicates"_s, options.duplicates },
+	}).toJson(QJsonDocument::Compact);
+	QJsonArray tags;
+	for (const Tag& tag : options.tags)
+		tags.append(tag.id());
+	const QByteArray tags_json = QJsonDocument(tags).toJson(QJsonDocument::Compact);
+
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "INSERT INTO import_job(roots, options, tags) VALUES (?, ?, ?);", -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, roots_json.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, options_json.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 3, tags_json.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	if (out)
+		*out = ImportJob(sqlite3_last_insert_rowid(db->con()));
+	return DBError();
+}
+
+QList<ImportJob> ImportJob::unfinished()
+{
+	if (db->isClosed())
+		return QList<ImportJob>();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id FROM import_job ORDER BY id;", -1, &stmt, nullptr);
+	QList<ImportJob> jobs;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		jobs.append(ImportJob(sqlite3_column_int64(stmt, 0)));
+	sqlite3_finalize(stmt);
+	return jobs;
+}
+
+int64_t ImportJob::id() const
+{
+	return m_id;
+}
+
+QStringList ImportJob::roots() const
+{
+	if (db->isClosed())
+		return QStringList();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT roots FROM import_job WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QStringList roots;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		const QByteArray json(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+		for (const QJsonValue& value : QJsonDocument::fromJson(json).array())
+			roots.append(value.toString());
+	}
+	sqlite3_finalize(stmt);
+	return roots;
+}
+
+ImportOptions ImportJob::options() const
+{
+	if (db->isClosed())
+		return ImportOptions();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT options, tags FROM import_job WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	ImportOptions options;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		const QByteArray options_json(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+		const QByteArray tags_json(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1));
+		const QJsonObject object = QJsonDocument::fromJson(options_json).object();
+		options.alias = object[u"alias"_s].toString();
+		options.comment = object[u"comment"_s].toString();
+		options.source = object[u"source"_s].toString();
+		options.recursive = object[u"recursive"_s].toBool(true);
+		options.ignoreHidden = object[u"ignoreHidden"_s].toBool(true);
+		for (const QJsonValue& value : object[u"ignore"_s].toArray())
+			options.ignore.append(value.toString());
+		options.duplicates = static_cast<ImportOptions::DuplicatePolicy>(object[u"duplicates"_s].toInt(ImportOptions::ImportDuplicates));
+		// tags deleted since the job started are dropped
+		for (const QJsonValue& value : QJsonDocument::fromJson(tags_json).array())
+			if (Tag tag(value.toInteger()); tag.exists())
+				options.tags.append(tag);
+	}
+	sqlite3_finalize(stmt);
+	return options;
+}
+
+int64_t ImportJob::total() const
+{
+	if (db->isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT total FROM import_job WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int64_t total = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		total = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return total;
+}
+
+int64_t ImportJob::cursor() const
+{
+	if (db->isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT cursor FROM import_job WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int64_t cursor = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		cursor = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return cursor;
+}
+
+DBError ImportJob::setCursor(int64_t seq) const
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	// handled paths are dropped as the cursor passes them
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "UPDATE import_job SET cursor = ? WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, seq);
+	sqlite3_bind_int64(stmt, 2, m_id);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	sqlite3_prepare_v2(db->con(), "DELETE FROM import_job_path WHERE job_id = ? AND seq <= ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	sqlite3_bind_int64(stmt, 2, seq);
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+bool ImportJob::walked() const
+{
+	if (db->isClosed())
+		return false;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT walked FROM import_job WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	bool walked = false;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		walked = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return walked;
+}
+
+DBError ImportJob::setWalked() const
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "UPDATE import_job SET walked = 1 WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+DBError ImportJob::appendPaths(const QStringList& paths) const
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (paths.isEmpty())
+		return DBError();
+	// seq continues after every path appended so far, handled or not
+	const int64_t first = total() + 1;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "INSERT INTO import_job_path(job_id, seq, path) VALUES (?, ?, ?);", -1, &stmt, nullptr);
+	int rc = SQLITE_DONE;
+	for (qsizetype i = 0; i < paths.size(); ++i)
+	{
+		const QByteArray path_bytes = paths[i].toUtf8();
+		sqlite3_bind_int64(stmt, 1, m_id);
+		sqlite3_bind_int64(stmt, 2, first + i);
+		sqlite3_bind_text(stmt, 3, path_bytes.constData(), -1, SQLITE_STATIC);
+		rc = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_DONE)
+			break;
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	sqlite3_prepare_v2(db->con(), "UPDATE import_job SET total = total + ? WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, paths.size());
+	sqlite3_bind_int64(stmt, 2, m_id);
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+DBError ImportJob::clearPending() const
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "DELETE FROM import_job_path WHERE job_id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	sqlite3_prepare_v2(db->con(), "UPDATE import_job SET total = cursor WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+QList<std::pair<int64_t, QString>> ImportJob::paths(int64_t after, int limit) const
+{
+	if (db->isClosed())
+		return {};
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT seq, path FROM import_job_path WHERE job_id = ? AND seq > ? ORDER BY seq LIMIT ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	sqlite3_bind_int64(stmt, 2, after);
+	sqlite3_bind_int(stmt, 3, limit);
+	QList<std::pair<int64_t, QString>> paths;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		paths.append({
+			sqlite3_column_int64(stmt, 0),
+			QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1))
+		});
+	sqlite3_finalize(stmt);
+	return paths;
+}
+
+DBError ImportJob::remove() const
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "DELETE FROM import_job WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
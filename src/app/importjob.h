@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "app/database.h"
+#include "app/tag.h"
+
+struct ImportOptions
+{
+	// what to do with a file whose content is already stored under another
+	// path. linking adds the import's tags to the stored file instead
+	enum DuplicatePolicy { ImportDuplicates = 0, SkipDuplicates, LinkDuplicates };
+	QString alias;
+	QString comment;
+	QString source;
+	QList<Tag> tags;
+	bool recursive = true;
+	bool ignoreHidden = true;
+	// wildcard patterns of file and directory names to leave out
+	QStringList ignore;
+	DuplicatePolicy duplicates = ImportDuplicates;
+};
+
+/**
+ * An import of many files that survives an abort or crash. The files found
+ * under the chosen roots are appended to the job as the walk finds them, and
+ * the cursor is advanced in the same transaction that adds them, so resuming
+ * starts right after the last committed file without hashing anything twice.
+ * A job interrupted before its walk ended walks again, skipping what is
+ * stored already. The job is removed once every file was handled.
+ */
+struct ImportJob
+{
+public:
+	ImportJob();
+	ImportJob(int64_t id);
+	static DBError create(const QStringList& roots, const ImportOptions& options, ImportJob* out = nullptr);
+	// jobs that were started but not finished, oldest first
+	static QList<ImportJob> unfinished();
+	int64_t id() const;
+	QStringList roots() const;
+	ImportOptions options() const;
+	int64_t total() const;
+	int64_t cursor() const;
+	DBError setCursor(int64_t seq) const;
+	bool walked() const;
+	DBError setWalked() const;
+	DBError appendPaths(const QStringList& paths) const;
+	// forgets the paths after the cursor, to walk the roots again
+	DBError clearPending() const;
+	// up to limit paths after seq, in walk order
+	QList<std::pair<int64_t, QString>> paths(int64_t after, int limit) const;
+	DBError remove() const;
+	bool operator==(const ImportJob& other) const
+	{
+		return this->id() == other.id();
+	}
+	bool operator!=(const ImportJob& other) const
+	{
+		return this->id() != other.id();
+	}
+
+private:
+	int64_t m_id;
+};
@@ -0,0 +1,243 @@
+#include "maintenance.h"
+
+#include <QFileInfo>
+#include "app/database.h"
+#include "app/globals.h"
+
+MaintenanceWorker::MaintenanceWorker(std::atomic_bool* cancel, QMutex* runLock, QObject* parent)
+	: QObject(parent)
+	, m_con(nullptr)
+	, m_cancel(cancel)
+	, m_runLock(runLock)
+{}
+
+void MaintenanceWorker::run(const QString& path, bool vacuum)
+{
+	QMutexLocker locker(m_runLock);
+	// stopped before this got to run
+	if (m_cancel->load())
+	{
+		emit finished(false);
+		return;
+	}
+	if (int rc = sqlite3_open_v2(path.toUtf8(), &m_con, SQLITE_OPEN_READWRITE, nullptr); rc != SQLITE_OK)
+	{
+		qWarning().nospace() << "Maintenance could not open " << path << ": " << sqlite3_errstr(rc);
+		sqlite3_close(m_con);
+		m_con = nullptr;
+		emit finished(false);
+		return;
+	}
+	if (int rc = Database::prepareConnection(m_con); rc != SQLITE_OK)
+	{
+		qWarning() << "Maintenance could not prepare its connection:" << sqlite3_errstr(rc);
+		sqlite3_close(m_con);
+		m_con = nullptr;
+		emit finished(false);
+		return;
+	}
+	// give way to the application rather than make it wait on us
+	sqlite3_busy_timeout(m_con, 100);
+	sqlite3_progress_handler(m_con, 1000, [](void* arg) -> int
+		{
+			return static_cast<MaintenanceWorker*>(arg)->interrupted() ? 1 : 0;
+		}, this);
+
+	// running out of budget only cuts a task short, cancelling stops them all
+	convertAutoVacuum(vacuum);
+	if (!m_cancel->load())
+		optimize();
+	for (const char* table : { "file_search", "file_search_trigram", "tag_search" })
+		if (!m_cancel->load())
+			merge(table);
+	if (!m_cancel->load())
+		incrementalVacuum();
+	// last, so it also covers what the tasks above wrote
+	if (!m_cancel->load())
+		checkpoint(path);
+
+	sqlite3_close(m_con);
+	m_con = nullptr;
+	emit finished(!m_cancel->load());
+}
+
+bool MaintenanceWorker::interrupted() const
+{
+	return m_cancel->load() || m_deadline.hasExpired();
+}
+
+qint64 MaintenanceWorker::pragma(const char* sql)
+{
+	qint64 value = -1;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(m_con, sql, -1, &stmt, nullptr);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		value = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return value;
+}
+
+void MaintenanceWorker::optimize()
+{
+	m_deadline.setRemainingTime(OPTIMIZE_BUDGET);
+	// sample rather than scan whole indexes when statistics are refreshed
+	sqlite3_exec(m_con, "PRAGMA analysis_limit = 400;", 0, 0, 0);
+	sqlite3_exec(m_con, "PRAGMA optimize;", 0, 0, 0);
+}
+
+void MaintenanceWorker::merge(const char* table)
+{
+	m_deadline.setRemainingTime(MERGE_BUDGET);
+	const QByteArray sql = QByteArray("INSERT INTO ") + table + "(" + table + ", rank) VALUES ('merge', 500);";
+	while (!interrupted())
+	{
+		const int before = sqlite3_total_changes(m_con);
+		if (sqlite3_exec(m_con, sql.constData(), 0, 0, 0) != SQLITE_OK)
+			return;
+		// fewer than two changes means there was nothing left to merge
+		if (sqlite3_total_changes(m_con) - before < 2)
+			return;
+	}
+}
+
+void MaintenanceWorker::checkpoint(const QString& path)
+{
+	const qint64 size = QFileInfo(path + u"-wal"_s).size();
+	if (size < PASSIVE_CHECKPOINT_SIZE)
+		return;
+	// truncating also gives the space back, but has to wait for readers
+	const int mode = size >= TRUNCATE_CHECKPOINT_SIZE ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE;
+	int logFrames, checkpointedFrames;
+	int rc = sqlite3_wal_checkpoint_v2(m_con, nullptr, mode, &logFrames, &checkpointedFrames);
+	if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+		qWarning() << "WAL checkpoint failed:" << sqlite3_errmsg(m_con);
+}
+
+void MaintenanceWorker::incrementalVacuum()
+{
+	if (pragma("PRAGMA auto_vacuum;") != 2) // INCREMENTAL
+		return;
+	m_deadline.setRemainingTime(VACUUM_BUDGET);
+	while (!interrupted() && pragma("PRAGMA freelist_count;") > 0)
+		if (sqlite3_exec(m_con, "PRAGMA incremental_vacuum(256);", 0, 0, 0) != SQLITE_OK)
+			return;
+}
+
+void MaintenanceWorker::convertAutoVacuum(bool force)
+{
+	// switching auto_vacuum needs a full VACUUM, which cannot be done in
+	// steps, so only small databases are converted without being asked
+	const qint64 size = pragma("PRAGMA page_count;") * pragma("PRAGMA page_size;");
+	if (!force && (pragma("PRAGMA auto_vacuum;") == 2 || size > AUTO_CONVERT_SIZE))
+		return;
+	m_deadline.setRemainingTime(-1);
+	sqlite3_exec(m_con, "PRAGMA auto_vacuum = INCREMENTAL;", 0, 0, 0);
+	if (sqlite3_exec(m_con, "VACUUM;", 0, 0, 0) != SQLITE_OK && !m_cancel->load())
+		qWarning() << "VACUUM failed:" << sqlite3_errmsg(m_con);
+}
+
+MaintenanceScheduler::MaintenanceScheduler(QObject* parent)
+	: QObject(parent)
+	, m_cancel(false)
+	, m_running(false)
+	, m_vacuumRequested(false)
+{
+	m_thread = new QThread(this);
+	m_worker = new MaintenanceWorker(&m_cancel, &m_runLock);
+	m_worker->moveToThread(m_thread);
+	connect(m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+	connect(m_worker, &MaintenanceWorker::finished, this, [this](bool completed) -> void
+		{
+			m_running = false;
+			emit finished(completed);
+			if (m_vacuumRequested)
+				start();
+		});
+	m_thread->start(QThread::IdlePriority);
+
+	m_idleTimer = new QTimer(this);
+	m_idleTimer->setSingleShot(true);
+	m_idleTimer->setInterval(IDLE_INTERVAL);
+	connect(m_idleTimer, &QTimer::timeout, this, &MaintenanceScheduler::start);
+	connect(db, &Database::opened, m_idleTimer, qOverload<>(&QTimer::start));
+	connect(db, &Database::updated, m_idleTimer, qOverload<>(&QTimer::start));
+	connect(db, &Database::beginning, this, &MaintenanceScheduler::cancel);
+	// writes outside a transaction only show up once they are kept waiting
+	connect(db, &Database::busy, this, &MaintenanceScheduler::cancel);
+	connect(db, &Database::closed, this, [this]() -> void
+		{
+			m_idleTimer->stop();
+			m_cancel = true;
+		});
+	if (db->isOpen())
+		m_idleTimer->start();
+}
+
+MaintenanceScheduler::~MaintenanceScheduler()
+{
+	m_cancel = true;
+	m_thread->quit();
+	m_thread->wait();
+	s_instance = nullptr;
+}
+
+MaintenanceScheduler* MaintenanceScheduler::instance()
+{
+	if (s_instance == nullptr)
+		s_instance = new MaintenanceScheduler(db);
+	return s_instance;
+}
+
+bool MaintenanceScheduler::isRunning() const
+{
+	return m_running;
+}
+
+void MaintenanceScheduler::cancel()
+{
+	m_cancel = true;
+	// try again once the application has gone quiet
+	if (db->isOpen())
+		m_idleTimer->start();
+}
+
+void MaintenanceScheduler::stop()
+{
+	cancel();
+	// a run that is queued but has not started yet sees the cancel and
+	// returns without opening anything
+	QMutexLocker locker(&m_runLock);
+}
+
+void MaintenanceScheduler::vacuum()
+{
+	m_vacuumRequested = true;
+	// the running pass is stopped, and finishing starts the vacuum
+	if (m_running)
+		m_cancel = true;
+	else
+		start();
+}
+
+void MaintenanceScheduler::start()
+{
+	if (m_running || db->isClosed())
+		return;
+	m_idleTimer->stop();
+	m_cancel = false;
+	m_running = true;
+	const QString path = db->path();
+	const bool vacuum = m_vacuumRequested;
+	m_vacuumRequested = false;
+	emit started();
+	QMetaObject::invokeMethod(m_worker, [this, path, vacuum]() -> void { m_worker->run(path, vacuum); }, Qt::QueuedConnection);
+}
+
+MaintenanceScheduler* MaintenanceScheduler::s_instance = nullptr;
+const int MaintenanceScheduler::IDLE_INTERVAL = 60 * 1000;
+const int MaintenanceWorker::OPTIMIZE_BUDGET = 2000;
+const int MaintenanceWorker::MERGE_BUDGET = 3000;
+const int MaintenanceWorker::VACUUM_BUDGET = 2000;
+const qint64 MaintenanceWorker::PASSIVE_CHECKPOINT_SIZE = 4 * 1024 * 1024;
+const qint64 MaintenanceWorker::TRUNCATE_CHECKPOINT_SIZE = 64 * 1024 * 1024;
+const qint64 MaintenanceWorker::AUTO_CONVERT_SIZE = 256 * 1024 * 1024;
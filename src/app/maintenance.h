@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include "sqlite3.h"
+
+/**
+ * Runs the maintenance tasks on its own connection. Lives on the
+ * scheduler's thread.
+ */
+class MaintenanceWorker : public QObject
+{
+	Q_OBJECT
+
+public:
+	// runLock is held for as long as the worker's connection is open
+	explicit MaintenanceWorker(std::atomic_bool* cancel, QMutex* runLock, QObject* parent = nullptr);
+
+public slots:
+	void run(const QString& path, bool vacuum);
+
+signals:
+	void finished(bool completed);
+
+private:
+	static const int OPTIMIZE_BUDGET;
+	static const int MERGE_BUDGET;
+	static const int VACUUM_BUDGET;
+	static const qint64 PASSIVE_CHECKPOINT_SIZE;
+	static const qint64 TRUNCATE_CHECKPOINT_SIZE;
+	static const qint64 AUTO_CONVERT_SIZE;
+	sqlite3* m_con;
+	std::atomic_bool* m_cancel;
+	QMutex* m_runLock;
+	QDeadlineTimer m_deadline;
+	bool interrupted() const;
+	qint64 pragma(const char* sql);
+	void optimize();
+	void merge(const char* table);
+	void checkpoint(const QString& path);
+	void incrementalVacuum();
+	void convertAutoVacuum(bool force);
+};
+
+/**
+ * Keeps the database file healthy while the application is idle: refreshes
+ * query planner statistics, merges FTS segments, checkpoints the WAL and
+ * returns free pages to the file system. Every task has a time budget and
+ * everything is cancelled as soon as the application starts a transaction
+ * or has to wait on the lock maintenance holds.
+ */
+class MaintenanceScheduler final : public QObject
+{
+	Q_OBJECT
+
+public:
+	static MaintenanceScheduler* instance();
+	~MaintenanceScheduler() override;
+	bool isRunning() const;
+	void cancel();
+	/**
+	 * Cancels like cancel(), then blocks until the worker has closed its
+	 * connection, for work that needs to be the only one on the database.
+	 */
+	void stop();
+	/**
+	 * Rewrites the whole file on the next run, switching it to incremental
+	 * auto vacuum. Starts right away rather than waiting for idle time.
+	 */
+	void vacuum();
+
+signals:
+	void started();
+	void finished(bool completed);
+
+private:
+	explicit MaintenanceScheduler(QObject* parent = nullptr);
+	static MaintenanceScheduler* s_instance;
+	static const int IDLE_INTERVAL;
+	QThread* m_thread;
+	MaintenanceWorker* m_worker;
+	QTimer* m_idleTimer;
+	std::atomic_bool m_cancel;
+	QMutex m_runLock;
+	bool m_running;
+	bool m_vacuumRequested;
+	void start();
+};
@@ -0,0 +1,836 @@
+#include "migration.h"
+
+#include <QDebug>
+#include <string>
+#include "app/database.h"
+
+Migrator::Migrator(const QString& path, QObject* parent)
+	: QObject(parent)
+	, m_path(path)
+	, m_con(nullptr)
+	, m_stepCount(0)
+	, m_stepsDone(0)
+{}
+
+int Migrator::latestVersion()
+{
+	return STEPS.last().version;
+}
+
+int Migrator::version(sqlite3* con)
+{
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(con, "PRAGMA user_version;", -1, &stmt, nullptr);
+	int version = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		version = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return version;
+}
+
+int Migrator::run()
+{
+	if (int rc = sqlite3_open_v2(m_path.toUtf8(), &m_con, SQLITE_OPEN_READWRITE, nullptr); rc != SQLITE_OK)
+	{
+		sqlite3_close(m_con);
+		m_con = nullptr;
+		return rc;
+	}
+	int rc = Database::prepareConnection(m_con);
+	if (rc == SQLITE_OK)
+		rc = exec("CREATE TABLE IF NOT EXISTS migration_state(version INTEGER PRIMARY KEY, cursor INTEGER NOT NULL) STRICT;");
+
+	const int from = version(m_con);
+	int first = 0;
+	while (first < STEPS.size() && STEPS[first].version <= from)
+		++first;
+	m_stepCount = STEPS.size() - first;
+	m_stepsDone = 0;
+	for (int i = first; i < STEPS.size() && rc == SQLITE_OK; ++i)
+	{
+		rc = runStep(i);
+		++m_stepsDone;
+	}
+	sqlite3_close(m_con);
+	m_con = nullptr;
+	return rc;
+}
+
+int Migrator::runStep(int index)
+{
+	const MigrationStep& step = STEPS[index];
+	const int from = index > 0 ? STEPS[index - 1].version : 0;
+	report(step, 0);
+
+	// a stored cursor means setup was committed by an earlier, interrupted run
+	int64_t cursor = this->cursor(step.version);
+	int rc = SQLITE_OK;
+	if (cursor < 0)
+	{
+		rc = exec("BEGIN TRANSACTION;");
+		if (rc == SQLITE_OK)
+			rc = exec(step.setup);
+		if (rc == SQLITE_OK && step.backfill)
+		{
+			const std::string sql = "INSERT INTO migration_state(version, cursor) VALUES (" + std::to_string(step.version) + ", 0);";
+			rc = exec(sql.c_str());
+		}
+		cursor = 0;
+	}
+	else
+		rc = exec("BEGIN TRANSACTION;");
+
+	if (rc == SQLITE_OK && step.backfill)
+	{
+		// each chunk is its own transaction
+		rc = exec("COMMIT TRANSACTION;");
+		if (rc == SQLITE_OK)
+			rc = backfill(step, cursor);
+		if (rc == SQLITE_OK)
+			rc = exec("BEGIN TRANSACTION;");
+	}
+
+	if (rc == SQLITE_OK && step.finish)
+		rc = exec(step.finish);
+	if (rc == SQLITE_OK)
+	{
+		const std::string sql =
+			"DELETE FROM migration_state WHERE version = " + std::to_string(step.version) + ";"
+			"PRAGMA user_version = " + std::to_string(step.version) + ";";
+		rc = exec(sql.c_str());
+	}
+	if (rc == SQLITE_OK)
+		rc = exec("COMMIT TRANSACTION;");
+	if (rc != SQLITE_OK)
+	{
+		qCritical().nospace() << "Failed updating database from user_version " << from << " to " << step.version << ": " << sqlite3_errmsg(m_con);
+		sqlite3_exec(m_con, "ROLLBACK TRANSACTION;", 0, 0, 0);
+	}
+	return rc;
+}
+
+int Migrator::backfill(const MigrationStep& step, int64_t cursor)
+{
+	int64_t last = 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(m_con, "SELECT coalesce(max(id), 0) FROM file;", -1, &stmt, nullptr);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		last = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	int rc = SQLITE_OK;
+	QList<sqlite3_stmt*> fillStmts;
+	for (const char* sql = step.backfill; rc == SQLITE_OK && *sql != '\0';)
+	{
+		sqlite3_stmt* fillStmt = nullptr;
+		rc = sqlite3_prepare_v2(m_con, sql, -1, &fillStmt, &sql);
+		// trailing whitespace prepares to no statement
+		if (fillStmt)
+			fillStmts.append(fillStmt);
+	}
+	sqlite3_stmt* boundStmt;
+	sqlite3_stmt* saveStmt;
+	sqlite3_prepare_v2(m_con, "SELECT max(id) FROM (SELECT id FROM file WHERE id > ? ORDER BY id LIMIT ?);", -1, &boundStmt, nullptr);
+	sqlite3_prepare_v2(m_con, "UPDATE migration_state SET cursor = ? WHERE version = ?;", -1, &saveStmt, nullptr);
+	while (rc == SQLITE_OK)
+	{
+		sqlite3_bind_int64(boundStmt, 1, cursor);
+		sqlite3_bind_int(boundStmt, 2, CHUNK_SIZE);
+		if (sqlite3_step(boundStmt) != SQLITE_ROW || sqlite3_column_type(boundStmt, 0) == SQLITE_NULL)
+		{
+			sqlite3_reset(boundStmt);
+			break;
+		}
+		const int64_t bound = sqlite3_column_int64(boundStmt, 0);
+		sqlite3_reset(boundStmt);
+
+		rc = exec("BEGIN TRANSACTION;");
+		if (rc != SQLITE_OK)
+			break;
+		rc = SQLITE_DONE;
+		for (sqlite3_stmt* fillStmt : fillStmts)
+		{
+			sqlite3_bind_int64(fillStmt, 1, cursor);
+			sqlite3_bind_int64(fillStmt, 2, bound);
+			rc = sqlite3_step(fillStmt);
+			sqlite3_reset(fillStmt);
+			if (rc != SQLITE_DONE)
+				break;
+		}
+		if (rc == SQLITE_DONE)
+		{
+			sqlite3_bind_int64(saveStmt, 1, bound);
+			sqlite3_bind_int(saveStmt, 2, step.version);
+			rc = sqlite3_step(saveStmt);
+			sqlite3_reset(saveStmt);
+		}
+		if (rc == SQLITE_DONE)
+			rc = exec("COMMIT TRANSACTION;");
+		if (rc != SQLITE_OK)
+			break;
+		cursor = bound;
+		report(step, last > 0 ? static_cast<double>(cursor) / last : 1);
+	}
+	sqlite3_finalize(boundStmt);
+	for (sqlite3_stmt* fillStmt : fillStmts)
+		sqlite3_finalize(fillStmt);
+	sqlite3_finalize(saveStmt);
+	return rc;
+}
+
+int Migrator::exec(const char* sql)
+{
+	return sqlite3_exec(m_con, sql, 0, 0, 0);
+}
+
+int64_t Migrator::cursor(int version)
+{
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(m_con, "SELECT cursor FROM migration_state WHERE version = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int(stmt, 1, version);
+	int64_t cursor = -1;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		cursor = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return cursor;
+}
+
+void Migrator::report(const MigrationStep& step, double fraction)
+{
+	if (m_stepCount == 0)
+		return;
+	const int permille = static_cast<int>((m_stepsDone + fraction) * 1000 / m_stepCount);
+	emit progress(tr(step.description), permille);
+}
+
+const QList<MigrationStep> Migrator::STEPS
+{
+	{
+		1,
+		QT_TRANSLATE_NOOP("Migrator", "Creating tables"),
+		R"(
+		CREATE TABLE file(
+			id       INTEGER PRIMARY KEY AUTOINCREMENT,
+			name     TEXT    NOT NULL,
+			dir      TEXT    NOT NULL,
+			alias    TEXT    NOT NULL DEFAULT '',
+			state    INTEGER NOT NULL DEFAULT 0, -- Ok
+			comment  TEXT    NOT NULL DEFAULT '',
+			source   TEXT    NOT NULL DEFAULT '',
+			sha1     BLOB    NOT NULL,
+			created  INTEGER NOT NULL DEFAULT (unixepoch()),
+			modified INTEGER NOT NULL DEFAULT (unixepoch()),
+			checked  INTEGER NOT NULL DEFAULT (unixepoch()),
+
+			UNIQUE (name, dir)
+		) STRICT;
+
+		CREATE INDEX file_alias ON file(alias);
+		CREATE INDEX file_state ON file(state);
+		CREATE INDEX file_created ON file(created);
+		CREATE INDEX file_modified ON file(modified);
+		CREATE INDEX file_checked ON file(checked);
+
+		CREATE VIRTUAL TABLE file_search USING fts5(name, alias, dir, comment, content='file', content_rowid='id');
+		CREATE TRIGGER file_ai AFTER INSERT ON file
+		BEGIN
+			INSERT INTO file_search(rowid, name, alias, dir, comment)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
+		END;
+		CREATE TRIGGER file_ad AFTER DELETE ON file
+		BEGIN
+			INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
+		END;
+		CREATE TRIGGER file_au AFTER UPDATE ON file
+		BEGIN
+			INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
+			INSERT INTO file_search(rowid, name, alias, dir, comment)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
+		END;
+
+		CREATE TABLE tag(
+			id          INTEGER PRIMARY KEY AUTOINCREMENT,
+			name        TEXT    NOT NULL UNIQUE,
+			description TEXT    NOT NULL DEFAULT '',
+			degree      INTEGER NOT NULL DEFAULT 0,
+			created     INTEGER NOT NULL DEFAULT (unixepoch()),
+			modified    INTEGER NOT NULL DEFAULT (unixepoch())
+		) STRICT;
+
+		CREATE INDEX tag_name ON tag(name);
+		CREATE INDEX tag_degree ON tag(degree);
+		CREATE INDEX tag_created ON tag(created);
+		CREATE INDEX tag_modified ON tag(modified);
+
+		CREATE VIRTUAL TABLE tag_search USING fts5(name, description, content='tag', content_rowid='id');
+		CREATE TRIGGER tag_ai AFTER INSERT ON tag
+		BEGIN
+			INSERT INTO tag_search(rowid, name, description)
+			VALUES (NEW.id, NEW.name, NEW.description);
+		END;
+		CREATE TRIGGER tag_ad AFTER DELETE ON tag
+		BEGIN
+			INSERT INTO tag_search(tag_search, rowid, name, description)
+			VALUES ('delete', OLD.id, old.name, old.description);
+		END;
+		CREATE TRIGGER tag_au AFTER UPDATE ON tag
+		BEGIN
+			INSERT INTO tag_search(tag_search, rowid, name, description)
+			VALUES ('delete', OLD.id, OLD.name, OLD.description);
+			INSERT INTO tag_search(rowid, name, description)
+			VALUES (NEW.id, NEW.name, NEW.description);
+		END;
+
+		CREATE TABLE tag_url(
+			tag_id INTEGER NOT NULL,
+			url    TEXT    NOT NULL,
+
+			PRIMARY KEY (tag_id, url),
+			FOREIGN KEY (tag_id) REFERENCES tag(id) ON DELETE CASCADE
+		) STRICT;
+
+		CREATE TABLE file_tag(
+			file_id INTEGER NOT NULL,
+			tag_id  INTEGER NOT NULL,
+			created INTEGER NOT NULL DEFAULT (unixepoch()),
+			PRIMARY KEY (file_id, tag_id),
+			FOREIGN KEY (file_id) REFERENCES file(id) ON DELETE CASCADE,
+			FOREIGN KEY (tag_id)  REFERENCES tag(id)  ON DELETE CASCADE
+		) STRICT;
+
+		CREATE TRIGGER file_tag_ai AFTER INSERT ON file_tag
+		BEGIN
+			UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
+		END;
+
+		CREATE TRIGGER file_tag_ad AFTER DELETE ON file_tag
+		BEGIN
+			UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
+		END;
+
+		CREATE TRIGGER file_tag_au AFTER UPDATE ON file_tag
+		BEGIN
+			UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
+			UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
+		END;
+		)"
+	},
+	// trigram index so that any part of a name can be searched, not just the
+	// start of a word
+	{
+		2,
+		QT_TRANSLATE_NOOP("Migrator", "Building the substring index"),
+		R"(
+		CREATE VIRTUAL TABLE file_search_trigram USING fts5(name, alias, dir, content='file', content_rowid='id', tokenize='trigram');
+		)",
+		R"(
+		INSERT INTO file_search_trigram(rowid, name, alias, dir)
+		SELECT id, name, alias, dir FROM file WHERE id > ?1 AND id <= ?2;
+		)",
+		R"(
+		CREATE TRIGGER file_trigram_ai AFTER INSERT ON file
+		BEGIN
+			INSERT INTO file_search_trigram(rowid, name, alias, dir)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir);
+		END;
+		CREATE TRIGGER file_trigram_ad AFTER DELETE ON file
+		BEGIN
+			INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir);
+		END;
+		CREATE TRIGGER file_trigram_au AFTER UPDATE OF name, alias, dir ON file
+		BEGIN
+			INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir);
+			INSERT INTO file_search_trigram(rowid, name, alias, dir)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir);
+		END;
+		)"
+	},
+	// rebuild file_search with the filename tokenizer and prefix indexes for
+	// the short prefixes typed into the search box
+	{
+		3,
+		QT_TRANSLATE_NOOP("Migrator", "Rebuilding the search index"),
+		R"(
+		DROP TRIGGER file_ai;
+		DROP TRIGGER file_ad;
+		DROP TRIGGER file_au;
+		DROP TABLE file_search;
+		CREATE VIRTUAL TABLE file_search USING fts5(name, alias, dir, comment, content='file', content_rowid='id', tokenize='filename', prefix='2 3 4');
+		)",
+		R"(
+		INSERT INTO file_search(rowid, name, alias, dir, comment)
+		SELECT id, name, alias, dir, comment FROM file WHERE id > ?1 AND id <= ?2;
+		)",
+		R"(
+		CREATE TRIGGER file_ai AFTER INSERT ON file
+		BEGIN
+			INSERT INTO file_search(rowid, name, alias, dir, comment)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
+		END;
+		CREATE TRIGGER file_ad AFTER DELETE ON file
+		BEGIN
+			INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
+		END;
+		CREATE TRIGGER file_au AFTER UPDATE OF name, alias, dir, comment ON file
+		BEGIN
+			INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
+			INSERT INTO file_search(rowid, name, alias, dir, comment)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
+		END;
+		)"
+	},
+	// file_search gains the names of each file's tags so text and tags are
+	// matched in one probe. the tags are not stored in file, so the index
+	// becomes contentless and rows are replaced whole from file_search_source
+	{
+		4,
+		QT_TRANSLATE_NOOP("Migrator", "Adding tags to the search index"),
+		R"(
+		DROP TRIGGER file_ai;
+		DROP TRIGGER file_ad;
+		DROP TRIGGER file_au;
+		DROP TABLE file_search;
+		CREATE VIEW file_search_source AS
+			SELECT
+				file.id, file.name, file.alias, file.dir, file.comment,
+				coalesce((
+					SELECT group_concat(name, ' ') FROM (
+						SELECT tag.name FROM file_tag
+						INNER JOIN tag ON tag.id = file_tag.tag_id
+						WHERE file_tag.file_id = file.id
+						ORDER BY tag.name
+					)
+				), '') AS tags
+			FROM file;
+		CREATE VIRTUAL TABLE file_search USING fts5(name, alias, dir, comment, tags, content='', contentless_delete=1, tokenize='filename', prefix='2 3 4');
+		)",
+		R"(
+		INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+		SELECT * FROM file_search_source WHERE id > ?1 AND id <= ?2;
+		)",
+		R"(
+		CREATE TRIGGER file_ai AFTER INSERT ON file
+		BEGIN
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment, '');
+		END;
+		CREATE TRIGGER file_ad AFTER DELETE ON file
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.id;
+		END;
+		CREATE TRIGGER file_au AFTER UPDATE OF name, alias, dir, comment ON file
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.id;
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id = NEW.id;
+		END;
+		CREATE TRIGGER file_tag_search_ai AFTER INSERT ON file_tag
+		BEGIN
+			DELETE FROM file_search WHERE rowid = NEW.file_id;
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id = NEW.file_id;
+		END;
+		CREATE TRIGGER file_tag_search_ad AFTER DELETE ON file_tag
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.file_id;
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id = OLD.file_id;
+		END;
+		CREATE TRIGGER file_tag_search_au AFTER UPDATE ON file_tag
+		BEGIN
+			DELETE FROM file_search WHERE rowid IN (OLD.file_id, NEW.file_id);
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id IN (OLD.file_id, NEW.file_id);
+		END;
+		CREATE TRIGGER tag_search_au AFTER UPDATE OF name ON tag
+		BEGIN
+			DELETE FROM file_search WHERE rowid IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id);
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id);
+		END;
+		)"
+	},
+	// every index and degree trigger gets a twin that only records which
+	// rows changed while Database::beginBulk() is in effect
+	{
+		5,
+		QT_TRANSLATE_NOOP("Migrator", "Updating triggers"),
+		R"(
+		CREATE TABLE deferred_search(id INTEGER PRIMARY KEY) STRICT;
+		CREATE TABLE deferred_trigram(id INTEGER PRIMARY KEY) STRICT;
+		CREATE TABLE deferred_tag(id INTEGER PRIMARY KEY) STRICT;
+
+		DROP TRIGGER file_ai;
+		DROP TRIGGER file_ad;
+		DROP TRIGGER file_au;
+		DROP TRIGGER file_tag_search_ai;
+		DROP TRIGGER file_tag_search_ad;
+		DROP TRIGGER file_tag_search_au;
+		DROP TRIGGER tag_search_au;
+		DROP TRIGGER file_trigram_ai;
+		DROP TRIGGER file_trigram_ad;
+		DROP TRIGGER file_trigram_au;
+		DROP TRIGGER file_tag_ai;
+		DROP TRIGGER file_tag_ad;
+		DROP TRIGGER file_tag_au;
+		DROP TRIGGER tag_au;
+
+		CREATE TRIGGER file_ai AFTER INSERT ON file WHEN NOT deferred_writes()
+		BEGIN
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment, '');
+		END;
+		CREATE TRIGGER file_ad AFTER DELETE ON file WHEN NOT deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.id;
+		END;
+		CREATE TRIGGER file_au AFTER UPDATE OF name, alias, dir, comment ON file WHEN NOT deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.id;
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id = NEW.id;
+		END;
+		CREATE TRIGGER file_tag_search_ai AFTER INSERT ON file_tag WHEN NOT deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = NEW.file_id;
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id = NEW.file_id;
+		END;
+		CREATE TRIGGER file_tag_search_ad AFTER DELETE ON file_tag WHEN NOT deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.file_id;
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id = OLD.file_id;
+		END;
+		CREATE TRIGGER file_tag_search_au AFTER UPDATE ON file_tag WHEN NOT deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid IN (OLD.file_id, NEW.file_id);
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id IN (OLD.file_id, NEW.file_id);
+		END;
+		CREATE TRIGGER tag_search_au AFTER UPDATE OF name ON tag WHEN NOT deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id);
+			INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+			SELECT * FROM file_search_source WHERE id IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id);
+		END;
+		CREATE TRIGGER file_trigram_ai AFTER INSERT ON file WHEN NOT deferred_writes()
+		BEGIN
+			INSERT INTO file_search_trigram(rowid, name, alias, dir)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir);
+		END;
+		CREATE TRIGGER file_trigram_ad AFTER DELETE ON file WHEN NOT deferred_writes()
+		BEGIN
+			INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir);
+		END;
+		CREATE TRIGGER file_trigram_au AFTER UPDATE OF name, alias, dir ON file WHEN NOT deferred_writes()
+		BEGIN
+			INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+			VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir);
+			INSERT INTO file_search_trigram(rowid, name, alias, dir)
+			VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir);
+		END;
+		-- degree changes no longer re-index tag_search
+		CREATE TRIGGER tag_au AFTER UPDATE OF name, description ON tag
+		BEGIN
+			INSERT INTO tag_search(tag_search, rowid, name, description)
+			VALUES ('delete', OLD.id, OLD.name, OLD.description);
+			INSERT INTO tag_search(rowid, name, description)
+			VALUES (NEW.id, NEW.name, NEW.description);
+		END;
+		CREATE TRIGGER file_tag_ai AFTER INSERT ON file_tag WHEN NOT deferred_writes()
+		BEGIN
+			UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
+		END;
+		CREATE TRIGGER file_tag_ad AFTER DELETE ON file_tag WHEN NOT deferred_writes()
+		BEGIN
+			UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
+		END;
+		CREATE TRIGGER file_tag_au AFTER UPDATE ON file_tag WHEN NOT deferred_writes()
+		BEGIN
+			UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
+			UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
+		END;
+
+		-- while writes are deferred, rows are only taken out of the indexes
+		-- once, and the ids to re-index or recount are collected for
+		-- Database::flushDeferred
+		CREATE TRIGGER file_ai_deferred AFTER INSERT ON file WHEN deferred_writes()
+		BEGIN
+			INSERT OR IGNORE INTO deferred_search(id) VALUES (NEW.id);
+			INSERT OR IGNORE INTO deferred_trigram(id) VALUES (NEW.id);
+		END;
+		CREATE TRIGGER file_ad_deferred AFTER DELETE ON file WHEN deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.id
+				AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = OLD.id);
+			INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+			SELECT 'delete', OLD.id, OLD.name, OLD.alias, OLD.dir
+			WHERE NOT EXISTS (SELECT 1 FROM deferred_trigram WHERE id = OLD.id);
+			INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.id);
+			INSERT OR IGNORE INTO deferred_trigram(id) VALUES (OLD.id);
+		END;
+		CREATE TRIGGER file_au_deferred AFTER UPDATE OF name, alias, dir, comment ON file WHEN deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.id
+				AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = OLD.id);
+			INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.id);
+		END;
+		CREATE TRIGGER file_trigram_au_deferred AFTER UPDATE OF name, alias, dir ON file WHEN deferred_writes()
+		BEGIN
+			INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+			SELECT 'delete', OLD.id, OLD.name, OLD.alias, OLD.dir
+			WHERE NOT EXISTS (SELECT 1 FROM deferred_trigram WHERE id = OLD.id);
+			INSERT OR IGNORE INTO deferred_trigram(id) VALUES (OLD.id);
+		END;
+		CREATE TRIGGER file_tag_ai_deferred AFTER INSERT ON file_tag WHEN deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = NEW.file_id
+				AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = NEW.file_id);
+			INSERT OR IGNORE INTO deferred_search(id) VALUES (NEW.file_id);
+			INSERT OR IGNORE INTO deferred_tag(id) VALUES (NEW.tag_id);
+		END;
+		CREATE TRIGGER file_tag_ad_deferred AFTER DELETE ON file_tag WHEN deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid = OLD.file_id
+				AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = OLD.file_id);
+			INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.file_id);
+			INSERT OR IGNORE INTO deferred_tag(id) VALUES (OLD.tag_id);
+		END;
+		CREATE TRIGGER file_tag_au_deferred AFTER UPDATE ON file_tag WHEN deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid IN (OLD.file_id, NEW.file_id)
+				AND rowid NOT IN (SELECT id FROM deferred_search);
+			INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.file_id), (NEW.file_id);
+			INSERT OR IGNORE INTO deferred_tag(id) VALUES (OLD.tag_id), (NEW.tag_id);
+		END;
+		CREATE TRIGGER tag_search_au_deferred AFTER UPDATE OF name ON tag WHEN deferred_writes()
+		BEGIN
+			DELETE FROM file_search WHERE rowid IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id)
+				AND rowid NOT IN (SELECT id FROM deferred_search);
+			INSERT OR IGNORE INTO deferred_search(id) SELECT file_id FROM file_tag WHERE tag_id = NEW.id;
+		END;
+		)"
+	},
+	// files point at a directory table so subtrees are an index range in
+	// directory_closure instead of a scan over every dir string. file.dir
+	// stays, the search indexes and UNIQUE (name, dir) still read it
+	{
+		6,
+		QT_TRANSLATE_NOOP("Migrator", "Indexing directories"),
+		R"(
+		CREATE TABLE directory(
+			id          INTEGER PRIMARY KEY AUTOINCREMENT,
+			parent_id   INTEGER,
+			name        TEXT    NOT NULL,
+			path        TEXT    NOT NULL UNIQUE,
+			file_count  INTEGER NOT NULL DEFAULT 0, -- files directly inside
+			total_count INTEGER NOT NULL DEFAULT 0, -- files anywhere below
+
+			FOREIGN KEY (parent_id) REFERENCES directory(id) ON DELETE CASCADE
+		) STRICT;
+
+		CREATE INDEX directory_parent ON directory(parent_id, name);
+
+		-- one row per ancestor of every directory, itself included at depth 0
+		CREATE TABLE directory_closure(
+			ancestor_id   INTEGER NOT NULL,
+			descendant_id INTEGER NOT NULL,
+			depth         INTEGER NOT NULL,
+
+			PRIMARY KEY (ancestor_id, descendant_id),
+			FOREIGN KEY (ancestor_id)   REFERENCES directory(id) ON DELETE CASCADE,
+			FOREIGN KEY (descendant_id) REFERENCES directory(id) ON DELETE CASCADE
+		) STRICT, WITHOUT ROWID;
+
+		CREATE INDEX directory_closure_descendant ON directory_closure(descendant_id, depth);
+
+		CREATE TABLE deferred_directory(id INTEGER PRIMARY KEY) STRICT;
+
+		ALTER TABLE file ADD COLUMN dir_id INTEGER REFERENCES directory(id);
+		)",
+		// the parent of a path is everything before its last '/', found by
+		// trimming the characters that are not '/' off the end. roots keep
+		// their trailing '/', the same rules as Directory::parentPath
+		R"(
+		WITH RECURSIVE chain(path) AS (
+			SELECT DISTINCT dir FROM file WHERE id > ?1 AND id <= ?2
+			UNION
+			SELECT CASE
+				WHEN instr(rtrim(rtrim(path, replace(path, '/', '')), '/'), '/') > 0
+					THEN rtrim(rtrim(path, replace(path, '/', '')), '/')
+				ELSE rtrim(path, replace(path, '/', ''))
+			END
+			FROM chain WHERE path NOT LIKE '%/' AND instr(path, '/') > 0
+		)
+		INSERT OR IGNORE INTO directory(path, name)
+		SELECT path, CASE
+			WHEN path LIKE '%/' THEN path
+			ELSE substr(path, length(rtrim(path, replace(path, '/', ''))) + 1)
+		END
+		FROM chain ORDER BY length(path);
+
+		UPDATE directory SET parent_id = (
+			SELECT parent.id FROM directory AS parent WHERE parent.path = CASE
+				WHEN instr(rtrim(rtrim(directory.path, replace(directory.path, '/', '')), '/'), '/') > 0
+					THEN rtrim(rtrim(directory.path, replace(directory.path, '/', '')), '/')
+				ELSE rtrim(directory.path, replace(directory.path, '/', ''))
+			END
+		)
+		WHERE id > (SELECT coalesce(max(descendant_id), 0) FROM directory_closure)
+			AND path NOT LIKE '%/' AND instr(path, '/') > 0;
+
+		WITH RECURSIVE up(descendant_id, ancestor_id, depth) AS (
+			SELECT id, id, 0 FROM directory
+			WHERE id > (SELECT coalesce(max(descendant_id), 0) FROM directory_closure)
+			UNION ALL
+			SELECT up.descendant_id, directory.parent_id, up.depth + 1 FROM up
+			INNER JOIN directory ON directory.id = up.ancestor_id
+			WHERE directory.parent_id IS NOT NULL
+		)
+		INSERT INTO directory_closure(ancestor_id, descendant_id, depth)
+		SELECT ancestor_id, descendant_id, depth FROM up;
+
+		UPDATE file SET dir_id = (SELECT directory.id FROM directory WHERE directory.path = file.dir)
+		WHERE file.id > ?1 AND file.id <= ?2;
+		)",
+		R"(
+		CREATE INDEX file_dir ON file(dir_id, name);
+
+		UPDATE directory SET file_count = counts.n
+		FROM (SELECT dir_id, count(*) AS n FROM file GROUP BY dir_id) AS counts
+		WHERE counts.dir_id = directory.id;
+		UPDATE directory SET total_count = totals.n
+		FROM (
+			SELECT c.ancestor_id, sum(d.file_count) AS n FROM directory_closure AS c
+			INNER JOIN directory AS d ON d.id = c.descendant_id
+			GROUP BY c.ancestor_id
+		) AS totals
+		WHERE totals.ancestor_id = directory.id;
+
+		-- the new location is counted first, so ancestors shared by both
+		-- never drop to zero and get pruned
+		CREATE TRIGGER file_directory_ai AFTER INSERT ON file WHEN NOT deferred_writes()
+		BEGIN
+			UPDATE directory SET file_count = file_count + 1 WHERE id = NEW.dir_id;
+			UPDATE directory SET total_count = total_count + 1
+			WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = NEW.dir_id);
+		END;
+		CREATE TRIGGER file_directory_ad AFTER DELETE ON file WHEN NOT deferred_writes()
+		BEGIN
+			UPDATE directory SET file_count = file_count - 1 WHERE id = OLD.dir_id;
+			UPDATE directory SET total_count = total_count - 1
+			WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+			DELETE FROM directory WHERE total_count = 0
+				AND id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+		END;
+		CREATE TRIGGER file_directory_au AFTER UPDATE OF dir_id ON file
+		WHEN NOT deferred_writes() AND OLD.dir_id IS NOT NEW.dir_id
+		BEGIN
+			UPDATE directory SET file_count = file_count + 1 WHERE id = NEW.dir_id;
+			UPDATE directory SET total_count = total_count + 1
+			WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = NEW.dir_id);
+			UPDATE directory SET file_count = file_count - 1 WHERE id = OLD.dir_id;
+			UPDATE directory SET total_count = total_count - 1
+			WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+			DELETE FROM directory WHERE total_count = 0
+				AND id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+		END;
+
+		CREATE TRIGGER file_directory_ai_deferred AFTER INSERT ON file WHEN deferred_writes()
+		BEGIN
+			INSERT OR IGNORE INTO deferred_directory(id) SELECT NEW.dir_id WHERE NEW.dir_id IS NOT NULL;
+		END;
+		CREATE TRIGGER file_directory_ad_deferred AFTER DELETE ON file WHEN deferred_writes()
+		BEGIN
+			INSERT OR IGNORE INTO deferred_directory(id) SELECT OLD.dir_id WHERE OLD.dir_id IS NOT NULL;
+		END;
+		CREATE TRIGGER file_directory_au_deferred AFTER UPDATE OF dir_id ON file
+		WHEN deferred_writes() AND OLD.dir_id IS NOT NEW.dir_id
+		BEGIN
+			INSERT OR IGNORE INTO deferred_directory(id) SELECT OLD.dir_id WHERE OLD.dir_id IS NOT NULL;
+			INSERT OR IGNORE INTO deferred_directory(id) SELECT NEW.dir_id WHERE NEW.dir_id IS NOT NULL;
+		END;
+		)"
+	},
+	// imports keep the list of files they still have to add, so an aborted
+	// import resumes without walking and hashing everything again
+	{
+		7,
+		QT_TRANSLATE_NOOP("Migrator", "Adding import jobs"),
+		R"(
+		CREATE TABLE import_job(
+			id      INTEGER PRIMARY KEY AUTOINCREMENT,
+			roots   TEXT    NOT NULL, -- JSON array of the chosen paths
+			options TEXT    NOT NULL DEFAULT '{}', -- JSON object, see ImportOptions
+			tags    TEXT    NOT NULL DEFAULT '[]', -- JSON array of tag ids
+			total   INTEGER NOT NULL DEFAULT 0,
+			cursor  INTEGER NOT NULL DEFAULT 0, -- seq of the last path handled
+			created INTEGER NOT NULL DEFAULT (unixepoch())
+		) STRICT;
+
+		CREATE TABLE import_job_path(
+			job_id INTEGER NOT NULL,
+			seq    INTEGER NOT NULL,
+			path   TEXT    NOT NULL,
+
+			PRIMARY KEY (job_id, seq),
+			FOREIGN KEY (job_id) REFERENCES import_job(id) ON DELETE CASCADE
+		) STRICT, WITHOUT ROWID;
+		)"
+	},
+	// lets an import find files with the same content
+	{
+		8,
+		QT_TRANSLATE_NOOP("Migrator", "Indexing checksums"),
+		R"(
+		CREATE INDEX file_sha1 ON file(sha1);
+		)"
+	},
+	// imports start adding files while their roots are still being walked.
+	// jobs from before were walked in full when they were created
+	{
+		9,
+		QT_TRANSLATE_NOOP("Migrator", "Updating import jobs"),
+		R"(
+		ALTER TABLE import_job ADD COLUMN walked INTEGER NOT NULL DEFAULT 0;
+		UPDATE import_job SET walked = 1;
+		)"
+	},
+	// the size lets missing files be matched by relinking without hashing
+	// every candidate. it is unknown for files added before, until their
+	// next check
+	{
+		10,
+		QT_TRANSLATE_NOOP("Migrator", "Adding file sizes"),
+		R"(
+		ALTER TABLE file ADD COLUMN size INTEGER;
+		)"
+	},
+	// directories learn which file system they are on, so files on a drive
+	// that is not mounted can be told from missing ones. what is there
+	// already is assigned by Volume::assignDirectories() once opened
+	{
+		11,
+		QT_TRANSLATE_NOOP("Migrator", "Adding volumes"),
+		R"(
+		CREATE TABLE volume(
+			id       INTEGER PRIMARY KEY AUTOINCREMENT,
+			identity TEXT    NOT NULL UNIQUE,
+			root     TEXT    NOT NULL,
+			label    TEXT    NOT NULL DEFAULT ''
+		) STRICT;
+		ALTER TABLE directory ADD COLUMN volume_id INTEGER REFERENCES volume(id) ON DELETE SET NULL;
+		CREATE INDEX directory_volume ON directory(volume_id);
+		)"
+	},
+};
+
+const int Migrator::CHUNK_SIZE = 2000;
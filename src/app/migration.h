@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include "sqlite3.h"
+
+/**
+ * One change to the schema, raising user_version to version. Steps that
+ * have to fill something from every file run in three parts, each committed
+ * on its own: setup, then backfill over the file ids in chunks, then finish.
+ * The last file id backfilled is kept in migration_state, so an interrupted
+ * migration continues where it stopped rather than starting over.
+ */
+struct MigrationStep
+{
+	int version;
+	const char* description;
+	const char* setup;
+	// statements run with ?1 and ?2 bound to a range of file ids, the lower
+	// bound excluded
+	const char* backfill = nullptr;
+	const char* finish = nullptr;
+};
+
+/**
+ * Brings a database up to the latest schema on its own connection, so it
+ * can be run off the UI thread.
+ */
+class Migrator final : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit Migrator(const QString& path, QObject* parent = nullptr);
+	static int latestVersion();
+	static int version(sqlite3* con);
+	// runs every step newer than the database, returns an SQLite result code
+	int run();
+
+signals:
+	// progress over all remaining steps, in thousandths
+	void progress(const QString& description, int permille);
+
+private:
+	static const QList<MigrationStep> STEPS;
+	static const int CHUNK_SIZE;
+	QString m_path;
+	sqlite3* m_con;
+	int m_stepCount;
+	int m_stepsDone;
+	int runStep(int index);
+	int backfill(const MigrationStep& step, int64_t cursor);
+	int exec(const char* sql);
+	int64_t cursor(int version);
+	void report(const MigrationStep& step, double fraction);
+};
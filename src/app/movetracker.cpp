@@ -0,0 +1,435 @@
+#include "movetracker.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSettings>
+
+#include "app/database.h"
+#include "app/directory.h"
+#include "app/file.h"
+#include "app/globals.h"
+#include "app/relinker.h"
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static const uint32_t WATCH_MASK = IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+#endif
+
+WatchSettings WatchSettings::load(const QString& configPath)
+{
+	WatchSettings settings;
+	if (configPath.isEmpty())
+		return settings;
+	QSettings ini(configPath, QSettings::IniFormat);
+	ini.beginGroup("Watch");
+	settings.directories = ini.value("directories", settings.directories).toStringList();
+	settings.recursive = ini.value("recursive", settings.recursive).toBool();
+	settings.ignoreHidden = ini.value("ignoreHidden", settings.ignoreHidden).toBool();
+	ini.endGroup();
+	return settings;
+}
+
+void WatchSettings::save(const QString& configPath) const
+{
+	QSettings ini(configPath, QSettings::IniFormat);
+	ini.beginGroup("Watch");
+	ini.setValue("directories", directories);
+	ini.setValue("recursive", recursive);
+	ini.setValue("ignoreHidden", ignoreHidden);
+	ini.endGroup();
+}
+
+MoveTracker::MoveTracker(QObject* parent)
+	: QObject(parent)
+	, m_fd(-1)
+	, m_notifier(nullptr)
+	, m_overflowed(false)
+	, m_job(nullptr)
+	, m_generation(0)
+	, m_cancel(false)
+{
+	m_applyTimer = new QTimer(this);
+	m_applyTimer->setSingleShot(true);
+	m_applyTimer->setInterval(APPLY_DELAY);
+	connect(m_applyTimer, &QTimer::timeout, this, &MoveTracker::apply);
+	connect(db, &Database::opened, this, [this]() -> void { watch(WatchSettings::load(db->configPath())); });
+	connect(db, &Database::closed, this, &MoveTracker::stop);
+	if (db->isOpen())
+		watch(WatchSettings::load(db->configPath()));
+}
+
+MoveTracker::~MoveTracker()
+{
+	stop();
+	s_instance = nullptr;
+}
+
+MoveTracker* MoveTracker::instance()
+{
+	if (s_instance == nullptr)
+		s_instance = new MoveTracker(db);
+	return s_instance;
+}
+
+bool MoveTracker::isSupported()
+{
+#ifdef Q_OS_LINUX
+	return true;
+#else
+	return false;
+#endif
+}
+
+void MoveTracker::watch(const WatchSettings& settings)
+{
+	stop();
+	m_settings = settings;
+#ifdef Q_OS_LINUX
+	if (settings.directories.isEmpty())
+		return;
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_fd < 0)
+	{
+		qWarning() << "Failed to start watching directories:" << strerror(errno);
+		return;
+	}
+	m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+	connect(m_notifier, &QSocketNotifier::activated, this, &MoveTracker::readEvents);
+	for (const QString& directory : settings.directories)
+		addWatches(QDir::cleanPath(QDir(QDir::fromNativeSeparators(directory)).absolutePath()));
+#endif
+}
+
+void MoveTracker::stop()
+{
+	m_applyTimer->stop();
+	// the job's results are dropped with the generation
+	m_cancel = true;
+	if (m_job)
+		m_job->wait();
+	m_job = nullptr;
+	++m_generation;
+	m_sweep.reset();
+	m_relinked.clear();
+	delete m_notifier;
+	m_notifier = nullptr;
+#ifdef Q_OS_LINUX
+	// closing drops every watch with it
+	if (m_fd >= 0)
+		close(m_fd);
+#endif
+	m_fd = -1;
+	m_watches.clear();
+	m_pending.clear();
+	m_moves.clear();
+	m_lost.clear();
+	m_arrived.clear();
+	m_overflowed = false;
+}
+
+void MoveTracker::addWatches(const QString& root)
+{
+#ifdef Q_OS_LINUX
+	QStringList directories = { root };
+	if (m_settings.recursive)
+	{
+		QDirIterator it(root, QDir::Dirs | QDir::NoDotAndDotDot | (m_settings.ignoreHidden ? QDir::Filters() : QDir::Filters(QDir::Hidden))
+			, QDirIterator::Subdirectories);
+		while (it.hasNext())
+		{
+			const QFileInfo info = it.nextFileInfo();
+			if (!info.isSymLink())
+				directories.append(info.absoluteFilePath());
+		}
+	}
+	for (const QString& directory : directories)
+	{
+		const int wd = inotify_add_watch(m_fd, QFile::encodeName(directory).constData(), WATCH_MASK);
+		if (wd < 0)
+		{
+			// most likely fs.inotify.max_user_watches, the rest would fail too
+			qWarning().nospace() << "Failed to watch " << directory << ": " << strerror(errno);
+			return;
+		}
+		m_watches.insert(wd, directory);
+	}
+#else
+	Q_UNUSED(root);
+#endif
+}
+
+void MoveTracker::removeWatches(const QString& root)
+{
+#ifdef Q_OS_LINUX
+	for (auto it = m_watches.begin(); it != m_watches.end();)
+	{
+		if (*it == root || it->startsWith(root + '/'))
+		{
+			inotify_rm_watch(m_fd, it.key());
+			it = m_watches.erase(it);
+		}
+		else
+			++it;
+	}
+#else
+	Q_UNUSED(root);
+#endif
+}
+
+void MoveTracker::renameWatches(const QString& from, const QString& to)
+{
+	// the watches follow the directories, only the paths they stand for change
+	for (QString& path : m_watches)
+		if (path == from || path.startsWith(from + '/'))
+			path = to + path.mid(from.size());
+}
+
+void MoveTracker::readEvents()
+{
+#ifdef Q_OS_LINUX
+	alignas(struct inotify_event) char buffer[64 * 1024];
+	ssize_t length;
+	while ((length = read(m_fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (char* p = buffer; p < buffer + length;)
+		{
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+			p += sizeof(struct inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				m_overflowed = true;
+				continue;
+			}
+			if (event->mask & IN_IGNORED)
+			{
+				m_watches.remove(event->wd);
+				continue;
+			}
+			const auto parent = m_watches.constFind(event->wd);
+			if (parent == m_watches.cend() || event->len == 0)
+				continue;
+			const QString path = *parent + '/' + QFile::decodeName(event->name);
+			const bool isDir = event->mask & IN_ISDIR;
+
+			if (event->mask & IN_MOVED_FROM)
+				m_pending.insert(event->cookie, { path, isDir, QDeadlineTimer(PAIR_TIMEOUT) });
+			else if (event->mask & IN_MOVED_TO)
+			{
+				if (m_pending.contains(event->cookie))
+				{
+					const Pending from = m_pending.take(event->cookie);
+					m_moves.append({ from.path, path, isDir });
+					if (isDir)
+						renameWatches(from.path, path);
+				}
+				else
+				{
+					m_arrived.append(path);
+					if (isDir && m_settings.recursive)
+						addWatches(path);
+				}
+			}
+			else if (event->mask & IN_CREATE)
+			{
+				if (isDir && m_settings.recursive)
+					addWatches(path);
+			}
+			else if ((event->mask & IN_DELETE) && !isDir)
+				m_lost.append(path);
+		}
+	}
+	if (!m_applyTimer->isActive())
+		m_applyTimer->start();
+#endif
+}
+
+void MoveTracker::apply()
+{
+	if (db->isClosed())
+		return stop();
+	// events keep being collected while the disk is read, the job starts
+	// the timer again once it is done
+	if (m_job)
+		return;
+	// the application is in the middle of a write, wait for it
+	if (!sqlite3_get_autocommit(db->con()))
+		return m_applyTimer->start();
+
+	if (m_sweep)
+	{
+		if (db->begin())
+			return m_applyTimer->start();
+		if (DBError error = m_sweep->apply())
+		{
+			qWarning() << "Failed to mark files as missing:" << error.message();
+			db->rollback();
+		}
+		else
+			db->commit();
+		m_sweep.reset();
+	}
+	if (!m_relinked.isEmpty())
+	{
+		if (DBError error = Relinker::relink(m_relinked))
+			qWarning() << "Failed to relink moved files:" << error.message();
+		m_relinked.clear();
+	}
+
+	if (m_overflowed)
+	{
+		// events were dropped, so anything could have happened. what has
+		// not been paired yet is settled by looking at every file
+		m_overflowed = false;
+		m_pending.clear();
+		m_lost.clear();
+		return probe(ExistenceSweep::all());
+	}
+
+	if (!m_moves.isEmpty())
+	{
+		if (DBError error = db->beginBulk())
+		{
+			qWarning() << "Failed to apply moves:" << error.message();
+			return m_applyTimer->start();
+		}
+		for (const Move& move : m_moves)
+		{
+			DBError error;
+			if (move.isDir)
+			{
+				// a directory nothing is stored in is no error
+				if (Directory::fromPath(move.from).id() >= 0)
+					error = Directory::relocate(move.from, move.to);
+			}
+			else if (const File file = File::fromPath(move.from); file.id() >= 0)
+				error = file.edit().path(move.to).commit();
+			if (error)
+				qWarning().nospace() << "Failed to move " << move.from << " to " << move.to << ": " << error.message();
+		}
+		db->commit();
+		m_moves.clear();
+	}
+
+	// moved away and never seen again
+	for (auto it = m_pending.begin(); it != m_pending.end();)
+	{
+		if (it->expires.hasExpired())
+		{
+			if (it->isDir)
+				removeWatches(it->path);
+			m_lost.append(it->path);
+			it = m_pending.erase(it);
+		}
+		else
+			++it;
+	}
+	if (!m_lost.isEmpty())
+	{
+		markLost(m_lost);
+		m_lost.clear();
+		if (m_job)
+			return;
+	}
+	// only once the files that left are marked missing can what came in be
+	// matched against them
+	if (!m_arrived.isEmpty())
+	{
+		relinkArrived(m_arrived);
+		m_arrived.clear();
+		if (m_job)
+			return;
+	}
+
+	if (!m_pending.isEmpty())
+		m_applyTimer->start();
+}
+
+void MoveTracker::markLost(const QStringList& paths)
+{
+	QList<File> files;
+	for (const QString& path : paths)
+	{
+		if (const File file = File::fromPath(path); file.id() >= 0)
+		{
+			files.append(file);
+			continue;
+		}
+		const Directory directory = Directory::fromPath(path);
+		if (directory.id() < 0)
+			continue;
+		sqlite3_stmt* stmt;
+		const char* sql = R"(
+			SELECT id FROM file WHERE dir_id IN (
+				SELECT descendant_id FROM directory_closure WHERE ancestor_id = ?
+			);
+		)";
+		sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+		sqlite3_bind_int64(stmt, 1, directory.id());
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+			files.append(File(sqlite3_column_int64(stmt, 0)));
+		sqlite3_finalize(stmt);
+	}
+	if (files.isEmpty())
+		return;
+	// the files are only looked up, one that is back already stays Ok. the
+	// states are written by the next apply()
+	probe(ExistenceSweep::of(files));
+}
+
+void MoveTracker::relinkArrived(const QStringList& paths)
+{
+	const auto relinker = std::make_shared<Relinker>(WalkOptions{ m_settings.recursive, m_settings.ignoreHidden, QStringList() });
+	if (relinker->load() == 0)
+		return;
+	// one file per missing entry, the first arrival to match keeps it
+	const auto matches = std::make_shared<QHash<int64_t, Relinker::Match>>();
+	runJob([this, relinker, matches, paths]() -> void
+		{
+			for (const QString& path : paths)
+			{
+				if (m_cancel)
+					return;
+				const auto progress = [this](qsizetype, qsizetype) -> bool { return !m_cancel; };
+				for (const Relinker::Match& match : relinker->find(path, progress))
+					if (!matches->contains(match.file.id()))
+						matches->insert(match.file.id(), match);
+			}
+		}, [this, matches]() -> void { m_relinked = matches->values(); });
+}
+
+void MoveTracker::probe(ExistenceSweep sweep)
+{
+	const auto probed = std::make_shared<ExistenceSweep>(std::move(sweep));
+	runJob([this, probed]() -> void
+		{
+			probed->probe([this](qsizetype) -> bool { return !m_cancel; });
+		}, [this, probed]() -> void { m_sweep = probed; });
+}
+
+void MoveTracker::runJob(const std::function<void()>& work, const std::function<void()>& done)
+{
+	m_cancel = false;
+	const int generation = m_generation;
+	m_job = QThread::create(work);
+	m_job->setParent(this);
+	connect(m_job, &QThread::finished, m_job, &QObject::deleteLater);
+	connect(m_job, &QThread::finished, this, [this, generation, done]() -> void
+		{
+			// stopped, or the database was closed in the meantime
+			if (generation != m_generation)
+				return;
+			m_job = nullptr;
+			done();
+			m_applyTimer->start();
+		});
+	m_job->start(QThread::LowPriority);
+}
+
+MoveTracker* MoveTracker::s_instance = nullptr;
+const int MoveTracker::PAIR_TIMEOUT = 1000;
+const int MoveTracker::APPLY_DELAY = 200;
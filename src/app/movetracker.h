@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "app/file.h"
+#include "app/relinker.h"
+
+/**
+ * The directories of a database that are watched for moves, kept in its
+ * .ini file next to the PerformanceProfile.
+ */
+struct WatchSettings
+{
+	QStringList directories;
+	bool recursive = true;
+	bool ignoreHidden = true;
+	static WatchSettings load(const QString& configPath);
+	void save(const QString& configPath) const;
+};
+
+/**
+ * Follows files that are moved or renamed inside the watched directories
+ * while the application runs. Moves are paired by their inotify cookie and
+ * applied as path rewrites without reading anything, a moved directory as
+ * one Directory::relocate(). Only what cannot be paired falls back to the
+ * contents: files moved out are marked missing and files moved in are
+ * matched against the missing ones by Relinker. Whatever has to read the
+ * disk, hashing arrivals and the full sweep after dropped events, runs on
+ * a thread of its own and is written once it is done. Tracking needs
+ * inotify, elsewhere nothing is watched.
+ */
+class MoveTracker final : public QObject
+{
+	Q_OBJECT
+
+public:
+	static MoveTracker* instance();
+	~MoveTracker() override;
+	static bool isSupported();
+	// replaces the watched directories
+	void watch(const WatchSettings& settings);
+	void stop();
+
+private:
+	struct Move
+	{
+		QString from;
+		QString to;
+		bool isDir;
+	};
+	struct Pending
+	{
+		QString path;
+		bool isDir;
+		QDeadlineTimer expires;
+	};
+	explicit MoveTracker(QObject* parent = nullptr);
+	static MoveTracker* s_instance;
+	static const int PAIR_TIMEOUT;
+	static const int APPLY_DELAY;
+	int m_fd;
+	QSocketNotifier* m_notifier;
+	QTimer* m_applyTimer;
+	WatchSettings m_settings;
+	// watch descriptor to the directory it was added for
+	QHash<int, QString> m_watches;
+	// moved away and waiting for their other half, by cookie
+	QHash<quint32, Pending> m_pending;
+	QList<Move> m_moves;
+	QStringList m_lost;
+	QStringList m_arrived;
+	bool m_overflowed;
+	// reading the disk, at most one at a time
+	QThread* m_job;
+	int m_generation;
+	std::atomic_bool m_cancel;
+	// what the last job found, waiting to be written
+	std::shared_ptr<ExistenceSweep> m_sweep;
+	QList<Relinker::Match> m_relinked;
+	void addWatches(const QString& root);
+	void removeWatches(const QString& root);
+	void renameWatches(const QString& from, const QString& to);
+	void readEvents();
+	void apply();
+	void markLost(const QStringList& paths);
+	void relinkArrived(const QStringList& paths);
+	// stats the files of sweep on the job thread, apply() writes it
+	void probe(ExistenceSweep sweep);
+	// runs work on the job thread, then done back on this one
+	void runJob(const std::function<void()>& work, const std::function<void()>& done);
+};
@@ -0,0 +1,86 @@
+#include "performanceprofile.h"
+
+#include <QCoreApplication>
+#include <QSettings>
+#include <string>
+
+PerformanceProfile PerformanceProfile::load(const QString& configPath)
+{
+	PerformanceProfile profile;
+	if (configPath.isEmpty())
+		return profile;
+	QSettings settings(configPath, QSettings::IniFormat);
+	settings.beginGroup("Performance");
+	profile.cacheSizeMiB = settings.value("cacheSize", profile.cacheSizeMiB).toInt();
+	profile.mmapSizeMiB = settings.value("mmapSize", profile.mmapSizeMiB).toInt();
+	profile.synchronous = static_cast<Synchronous>(settings.value("synchronous", profile.synchronous).toInt());
+	profile.tempStore = static_cast<TempStore>(settings.value("tempStore", profile.tempStore).toInt());
+	profile.pageSize = settings.value("pageSize", profile.pageSize).toInt();
+	profile.busyTimeout = settings.value("busyTimeout", profile.busyTimeout).toInt();
+	settings.endGroup();
+	return profile;
+}
+
+void PerformanceProfile::save(const QString& configPath) const
+{
+	QSettings settings(configPath, QSettings::IniFormat);
+	settings.beginGroup("Performance");
+	settings.setValue("cacheSize", cacheSizeMiB);
+	settings.setValue("mmapSize", mmapSizeMiB);
+	settings.setValue("synchronous", synchronous);
+	settings.setValue("tempStore", tempStore);
+	settings.setValue("pageSize", pageSize);
+	settings.setValue("busyTimeout", busyTimeout);
+	settings.endGroup();
+}
+
+void PerformanceProfile::apply(sqlite3* con) const
+{
+	// a negative cache_size is in KiB rather than pages
+	const std::string sql =
+		"PRAGMA cache_size = " + std::to_string(-static_cast<qint64>(cacheSizeMiB) * 1024) + ";"
+		"PRAGMA mmap_size = " + std::to_string(static_cast<qint64>(mmapSizeMiB) * 1024 * 1024) + ";"
+		"PRAGMA synchronous = " + std::to_string(synchronous) + ";"
+		"PRAGMA temp_store = " + std::to_string(tempStore) + ";";
+	sqlite3_exec(con, sql.c_str(), 0, 0, 0);
+}
+
+QList<PerformanceProfile::Preset> PerformanceProfile::presets()
+{
+	PerformanceProfile fast;
+	fast.cacheSizeMiB = 256;
+	fast.mmapSizeMiB = 1024;
+	fast.synchronous = Normal;
+	fast.tempStore = MemoryStore;
+
+	// memory mapping is unsafe over network file systems, and larger pages
+	// mean fewer round trips
+	PerformanceProfile network;
+	network.cacheSizeMiB = 64;
+	network.mmapSizeMiB = 0;
+	network.synchronous = Full;
+	network.tempStore = MemoryStore;
+	network.pageSize = 32768;
+	network.busyTimeout = 30000;
+
+	return {
+		{ QCoreApplication::translate("PerformanceProfile", "Default"), PerformanceProfile() },
+		{ QCoreApplication::translate("PerformanceProfile", "SSD, large RAM"), fast },
+		{ QCoreApplication::translate("PerformanceProfile", "Network share"), network },
+	};
+}
+
+bool PerformanceProfile::operator==(const PerformanceProfile& other) const
+{
+	return cacheSizeMiB == other.cacheSizeMiB
+		&& mmapSizeMiB == other.mmapSizeMiB
+		&& synchronous == other.synchronous
+		&& tempStore == other.tempStore
+		&& pageSize == other.pageSize
+		&& busyTimeout == other.busyTimeout;
+}
+
+bool PerformanceProfile::operator!=(const PerformanceProfile& other) const
+{
+	return !(*this == other);
+}
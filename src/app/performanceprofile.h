@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include "sqlite3.h"
+
+/**
+ * Connection tuning for one database, stored in the [Performance] group of
+ * the file returned by Database::configPath().
+ */
+struct PerformanceProfile
+{
+	enum Synchronous { Normal = 1, Full = 2 };
+	enum TempStore { DefaultStore = 0, FileStore = 1, MemoryStore = 2 };
+	struct Preset
+	{
+		QString name;
+		PerformanceProfile profile;
+	};
+
+	int cacheSizeMiB = 2;
+	int mmapSizeMiB = 0;
+	// NORMAL is durable against application crashes under WAL, FULL also
+	// against power loss
+	Synchronous synchronous = Full;
+	TempStore tempStore = DefaultStore;
+	// only changes when the database is rewritten, see Database::setPageSize
+	int pageSize = 4096;
+	int busyTimeout = 5000;
+
+	static PerformanceProfile load(const QString& configPath);
+	void save(const QString& configPath) const;
+	// sets the per-connection pragmas, everything except pageSize. the busy
+	// timeout is left to the owner of the connection, see
+	// Database::applyProfile
+	void apply(sqlite3* con) const;
+	static QList<Preset> presets();
+	bool operator==(const PerformanceProfile& other) const;
+	bool operator!=(const PerformanceProfile& other) const;
+};
@@ -0,0 +1,164 @@
+#include "relinker.h"
+
+#include "app/globals.h"
+#include "app/hashcache.h"
+#include "app/writebatcher.h"
+
+Relinker::Relinker(const WalkOptions& options, int threads)
+	: m_options(options)
+	, m_cancel(false)
+	, m_scanned(0)
+{
+	m_pool.setMaxThreadCount(std::max(1, threads));
+}
+
+Relinker::~Relinker()
+{
+	m_cancel = true;
+	m_pool.waitForDone();
+}
+
+int64_t Relinker::load()
+{
+	m_bySha1.clear();
+	m_sizes.clear();
+	m_names.clear();
+	if (db->isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id, name, size, sha1 FROM file WHERE state = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int(stmt, 1, File::FileMissing);
+	int64_t count = 0;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		Missing missing = {
+			sqlite3_column_int64(stmt, 0),
+			QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1)),
+			sqlite3_column_type(stmt, 2) == SQLITE_NULL ? -1 : sqlite3_column_int64(stmt, 2)
+		};
+		const QByteArray sha1(static_cast<const char*>(sqlite3_column_blob(stmt, 3)), sqlite3_column_bytes(stmt, 3));
+		// without a size only a file of the same name is worth hashing
+		if (missing.size >= 0)
+			m_sizes.insert(missing.size);
+		else
+			m_names.insert(missing.name);
+		m_bySha1[sha1].append(missing);
+		++count;
+	}
+	sqlite3_finalize(stmt);
+	return count;
+}
+
+QList<Relinker::Match> Relinker::find(const QString& root, const std::function<bool(qsizetype, qsizetype)>& progress)
+{
+	m_cancel = false;
+	m_scanned = 0;
+	m_matched.clear();
+	if (m_bySha1.isEmpty())
+		return QList<Match>();
+
+	const auto matched = [this]() -> qsizetype
+	{
+		QMutexLocker locker(&m_mutex);
+		return m_matched.size();
+	};
+	// the walk and the hashing overlap, each batch of paths found is hashed
+	// while the walker keeps reading directories
+	DirectoryWalker walker(m_options);
+	walker.start({ root });
+	QStringList found;
+	bool more = true;
+	while (more && !m_cancel)
+	{
+		found.clear();
+		more = walker.take(found);
+		for (qsizetype i = 0; i < found.size(); i += CHUNK_SIZE)
+		{
+			const QStringList chunk = found.mid(i, CHUNK_SIZE);
+			m_pool.start([this, chunk]() { scan(chunk); });
+		}
+		if (progress && !progress(m_scanned, matched()))
+			m_cancel = true;
+	}
+	walker.cancel();
+	while (!m_pool.waitForDone(50))
+		if (progress && !progress(m_scanned, matched()))
+			m_cancel = true;
+
+	QList<Match> matches;
+	QMutexLocker locker(&m_mutex);
+	matches.reserve(m_matched.size());
+	for (auto it = m_matched.cbegin(); it != m_matched.cend(); ++it)
+		matches.append({ File(it.key()), it.value() });
+	return matches;
+}
+
+DBError Relinker::relink(const QList<Match>& matches, int64_t* relinked)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	// the same rows are updated, so tags and every other field stay. a match
+	// whose new path is already taken by another file fails alone
+	WriteBatcher batcher;
+	int64_t count = 0;
+	for (const Match& match : matches)
+	{
+		const DBError error = batcher.write([&match]() -> DBError
+			{
+				if (DBError error = match.file.edit().path(match.path).commit())
+					return error;
+				return match.file.setState(File::Ok);
+			});
+		if (!error)
+			++count;
+	}
+	if (DBError error = batcher.finish())
+		return error;
+	if (relinked)
+		*relinked = count;
+	return DBError();
+}
+
+void Relinker::scan(const QStringList& paths)
+{
+	for (const QString& path : paths)
+	{
+		if (m_cancel)
+			return;
+		++m_scanned;
+		const QString name = path.mid(path.lastIndexOf('/') + 1);
+		const FileIdentity identity = FileIdentity::of(path);
+		if (!identity.isValid() || !candidate(name, identity.size))
+			continue;
+		const QByteArray sha1 = HashCache::instance()->sha1(path);
+		if (sha1.isNull())
+			continue;
+		const auto it = m_bySha1.constFind(sha1);
+		if (it == m_bySha1.cend())
+			continue;
+
+		// identical copies are handed out one each, those with the same
+		// name first
+		QMutexLocker locker(&m_mutex);
+		const Missing* pick = nullptr;
+		for (const Missing& missing : *it)
+		{
+			if (m_matched.contains(missing.id))
+				continue;
+			if (missing.size >= 0 && missing.size != identity.size)
+				continue;
+			if (!pick || (missing.name == name && pick->name != name))
+				pick = &missing;
+		}
+		if (pick)
+			m_matched.insert(pick->id, path);
+	}
+}
+
+bool Relinker::candidate(const QString& name, int64_t size) const
+{
+	return m_sizes.contains(size) || m_names.contains(name);
+}
+
+const int Relinker::THREADS = 8;
+const int Relinker::CHUNK_SIZE = 64;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+
+#include "app/database.h"
+#include "app/directorywalker.h"
+#include "app/file.h"
+
+/**
+ * Finds files marked FileMissing again below a search root. The root is
+ * walked in parallel, candidates are narrowed down by size, or by name for
+ * files whose size was never recorded, and only those are hashed and
+ * matched against the stored digests. Matches are repointed with relink(),
+ * which keeps the rows and so every tag and field of the files.
+ */
+class Relinker
+{
+public:
+	struct Match
+	{
+		File file;
+		QString path;
+	};
+	explicit Relinker(const WalkOptions& options = WalkOptions(), int threads = THREADS);
+	// cancels and waits for the threads
+	~Relinker();
+	// loads the missing files to look for, returns their number
+	int64_t load();
+	/**
+	 * Walks root and returns the matches found. progress is called with the
+	 * number of files looked at and matched so far, returning false stops
+	 * early with what was matched until then.
+	 */
+	QList<Match> find(const QString& root, const std::function<bool(qsizetype, qsizetype)>& progress = nullptr);
+	// repoints the matches in bulk transactions and marks them Ok
+	static DBError relink(const QList<Match>& matches, int64_t* relinked = nullptr);
+
+	static const int THREADS;
+	static const int CHUNK_SIZE;
+
+private:
+	struct Missing
+	{
+		int64_t id;
+		QString name;
+		// -1 if unknown
+		int64_t size;
+	};
+	WalkOptions m_options;
+	QThreadPool m_pool;
+	std::atomic_bool m_cancel;
+	std::atomic<qsizetype> m_scanned;
+	QHash<QByteArray, QList<Missing>> m_bySha1;
+	QSet<int64_t> m_sizes;
+	QSet<QString> m_names;
+	QMutex m_mutex;
+	QHash<int64_t, QString> m_matched;
+	void scan(const QStringList& paths);
+	bool candidate(const QString& name, int64_t size) const;
+};
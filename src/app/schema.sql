@@ -10,6 +10,8 @@ CREATE TABLE file(
 	created  INTEGER NOT NULL DEFAULT (unixepoch()),
 	modified INTEGER NOT NULL DEFAULT (unixepoch()),
 	checked  INTEGER NOT NULL DEFAULT (unixepoch()),
+	dir_id   INTEGER REFERENCES directory(id),
+	size     INTEGER, -- in bytes, NULL until known
 
 	UNIQUE (name, dir)
 ) STRICT;
@@ -19,25 +21,47 @@ CREATE INDEX file_state ON file(state);
 CREATE INDEX file_created ON file(created);
 CREATE INDEX file_modified ON file(modified);
 CREATE INDEX file_checked ON file(checked);
+CREATE INDEX file_dir ON file(dir_id, name);
+CREATE INDEX file_sha1 ON file(sha1);
 
-CREATE VIRTUAL TABLE file_search USING fts5(name, alias, dir, comment, content='file', content_rowid='id');
-CREATE TRIGGER file_ai AFTER INSERT ON file
-BEGIN
-	INSERT INTO file_search(rowid, name, alias, dir, comment)
-	VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
-END;
-CREATE TRIGGER file_ad AFTER DELETE ON file
-BEGIN
-	INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
-	VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
-END;
-CREATE TRIGGER file_au AFTER UPDATE ON file
-BEGIN
-	INSERT INTO file_search(file_search, rowid, name, alias, dir, comment)
-	VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir, OLD.comment);
-	INSERT INTO file_search(rowid, name, alias, dir, comment)
-	VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment);
-END;
+CREATE TABLE directory(
+	id          INTEGER PRIMARY KEY AUTOINCREMENT,
+	parent_id   INTEGER,
+	name        TEXT    NOT NULL,
+	path        TEXT    NOT NULL UNIQUE,
+	file_count  INTEGER NOT NULL DEFAULT 0, -- files directly inside
+	total_count INTEGER NOT NULL DEFAULT 0, -- files anywhere below
+	volume_id   INTEGER,
+
+	FOREIGN KEY (parent_id) REFERENCES directory(id) ON DELETE CASCADE,
+	FOREIGN KEY (volume_id) REFERENCES volume(id) ON DELETE SET NULL
+) STRICT;
+
+CREATE INDEX directory_parent ON directory(parent_id, name);
+CREATE INDEX directory_volume ON directory(volume_id);
+
+-- a file system, by its UUID or else its device
+CREATE TABLE volume(
+	id       INTEGER PRIMARY KEY AUTOINCREMENT,
+	identity TEXT    NOT NULL UNIQUE,
+	root     TEXT    NOT NULL, -- where it was last mounted
+	label    TEXT    NOT NULL DEFAULT ''
+) STRICT;
+
+-- one row per ancestor of every directory, itself included at depth 0
+CREATE TABLE directory_closure(
+	ancestor_id   INTEGER NOT NULL,
+	descendant_id INTEGER NOT NULL,
+	depth         INTEGER NOT NULL,
+
+	PRIMARY KEY (ancestor_id, descendant_id),
+	FOREIGN KEY (ancestor_id)   REFERENCES directory(id) ON DELETE CASCADE,
+	FOREIGN KEY (descendant_id) REFERENCES directory(id) ON DELETE CASCADE
+) STRICT, WITHOUT ROWID;
+
+CREATE INDEX directory_closure_descendant ON directory_closure(descendant_id, depth);
+
+CREATE VIRTUAL TABLE file_search_trigram USING fts5(name, alias, dir, content='file', content_rowid='id', tokenize='trigram');
 
 CREATE TABLE tag(
 	id          INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -64,13 +88,6 @@ BEGIN
 	INSERT INTO tag_search(tag_search, rowid, name, description)
 	VALUES ('delete', OLD.id, old.name, old.description);
 END;
-CREATE TRIGGER tag_au AFTER UPDATE ON tag
-BEGIN
-	INSERT INTO tag_search(tag_search, rowid, name, description)
-	VALUES ('delete', OLD.id, OLD.name, OLD.description);
-	INSERT INTO tag_search(rowid, name, description)
-	VALUES (NEW.id, NEW.name, NEW.description);
-END;
 
 CREATE TABLE tag_url(
 	tag_id INTEGER NOT NULL,
@@ -89,18 +106,226 @@ CREATE TABLE file_tag(
 	FOREIGN KEY (tag_id)  REFERENCES tag(id)  ON DELETE CASCADE
 ) STRICT;
 
-CREATE TRIGGER file_tag_ai AFTER INSERT ON file_tag
+CREATE VIEW file_search_source AS
+	SELECT
+		file.id, file.name, file.alias, file.dir, file.comment,
+		coalesce((
+			SELECT group_concat(name, ' ') FROM (
+				SELECT tag.name FROM file_tag
+				INNER JOIN tag ON tag.id = file_tag.tag_id
+				WHERE file_tag.file_id = file.id
+				ORDER BY tag.name
+			)
+		), '') AS tags
+	FROM file;
+
+-- tokenize='filename' is registered by the application, see FilenameTokenizer
+CREATE VIRTUAL TABLE file_search USING fts5(name, alias, dir, comment, tags, content='', contentless_delete=1, tokenize='filename', prefix='2 3 4');
+
+CREATE TABLE deferred_search(id INTEGER PRIMARY KEY) STRICT;
+CREATE TABLE deferred_trigram(id INTEGER PRIMARY KEY) STRICT;
+CREATE TABLE deferred_tag(id INTEGER PRIMARY KEY) STRICT;
+CREATE TABLE deferred_directory(id INTEGER PRIMARY KEY) STRICT;
+
+CREATE TRIGGER file_ai AFTER INSERT ON file WHEN NOT deferred_writes()
+BEGIN
+	INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+	VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir, NEW.comment, '');
+END;
+CREATE TRIGGER file_ad AFTER DELETE ON file WHEN NOT deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = OLD.id;
+END;
+CREATE TRIGGER file_au AFTER UPDATE OF name, alias, dir, comment ON file WHEN NOT deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = OLD.id;
+	INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+	SELECT * FROM file_search_source WHERE id = NEW.id;
+END;
+CREATE TRIGGER file_tag_search_ai AFTER INSERT ON file_tag WHEN NOT deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = NEW.file_id;
+	INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+	SELECT * FROM file_search_source WHERE id = NEW.file_id;
+END;
+CREATE TRIGGER file_tag_search_ad AFTER DELETE ON file_tag WHEN NOT deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = OLD.file_id;
+	INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+	SELECT * FROM file_search_source WHERE id = OLD.file_id;
+END;
+CREATE TRIGGER file_tag_search_au AFTER UPDATE ON file_tag WHEN NOT deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid IN (OLD.file_id, NEW.file_id);
+	INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+	SELECT * FROM file_search_source WHERE id IN (OLD.file_id, NEW.file_id);
+END;
+CREATE TRIGGER tag_search_au AFTER UPDATE OF name ON tag WHEN NOT deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id);
+	INSERT INTO file_search(rowid, name, alias, dir, comment, tags)
+	SELECT * FROM file_search_source WHERE id IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id);
+END;
+CREATE TRIGGER file_trigram_ai AFTER INSERT ON file WHEN NOT deferred_writes()
+BEGIN
+	INSERT INTO file_search_trigram(rowid, name, alias, dir)
+	VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir);
+END;
+CREATE TRIGGER file_trigram_ad AFTER DELETE ON file WHEN NOT deferred_writes()
+BEGIN
+	INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+	VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir);
+END;
+CREATE TRIGGER file_trigram_au AFTER UPDATE OF name, alias, dir ON file WHEN NOT deferred_writes()
+BEGIN
+	INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+	VALUES ('delete', OLD.id, OLD.name, OLD.alias, OLD.dir);
+	INSERT INTO file_search_trigram(rowid, name, alias, dir)
+	VALUES (NEW.id, NEW.name, NEW.alias, NEW.dir);
+END;
+-- degree changes no longer re-index tag_search
+CREATE TRIGGER tag_au AFTER UPDATE OF name, description ON tag
+BEGIN
+	INSERT INTO tag_search(tag_search, rowid, name, description)
+	VALUES ('delete', OLD.id, OLD.name, OLD.description);
+	INSERT INTO tag_search(rowid, name, description)
+	VALUES (NEW.id, NEW.name, NEW.description);
+END;
+CREATE TRIGGER file_tag_ai AFTER INSERT ON file_tag WHEN NOT deferred_writes()
 BEGIN
 	UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
 END;
-
-CREATE TRIGGER file_tag_ad AFTER DELETE ON file_tag
+CREATE TRIGGER file_tag_ad AFTER DELETE ON file_tag WHEN NOT deferred_writes()
 BEGIN
 	UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
 END;
-
-CREATE TRIGGER file_tag_au AFTER UPDATE ON file_tag
+CREATE TRIGGER file_tag_au AFTER UPDATE ON file_tag WHEN NOT deferred_writes()
 BEGIN
 	UPDATE tag SET degree = degree - 1 WHERE id = OLD.tag_id;
 	UPDATE tag SET degree = degree + 1 WHERE id = NEW.tag_id;
 END;
+
+-- the new location is counted first, so ancestors shared by both
+-- never drop to zero and get pruned
+CREATE TRIGGER file_directory_ai AFTER INSERT ON file WHEN NOT deferred_writes()
+BEGIN
+	UPDATE directory SET file_count = file_count + 1 WHERE id = NEW.dir_id;
+	UPDATE directory SET total_count = total_count + 1
+	WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = NEW.dir_id);
+END;
+CREATE TRIGGER file_directory_ad AFTER DELETE ON file WHEN NOT deferred_writes()
+BEGIN
+	UPDATE directory SET file_count = file_count - 1 WHERE id = OLD.dir_id;
+	UPDATE directory SET total_count = total_count - 1
+	WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+	DELETE FROM directory WHERE total_count = 0
+		AND id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+END;
+CREATE TRIGGER file_directory_au AFTER UPDATE OF dir_id ON file
+WHEN NOT deferred_writes() AND OLD.dir_id IS NOT NEW.dir_id
+BEGIN
+	UPDATE directory SET file_count = file_count + 1 WHERE id = NEW.dir_id;
+	UPDATE directory SET total_count = total_count + 1
+	WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = NEW.dir_id);
+	UPDATE directory SET file_count = file_count - 1 WHERE id = OLD.dir_id;
+	UPDATE directory SET total_count = total_count - 1
+	WHERE id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+	DELETE FROM directory WHERE total_count = 0
+		AND id IN (SELECT ancestor_id FROM directory_closure WHERE descendant_id = OLD.dir_id);
+END;
+
+-- while writes are deferred, rows are only taken out of the indexes
+-- once, and the ids to re-index or recount are collected for
+-- Database::flushDeferred
+CREATE TRIGGER file_ai_deferred AFTER INSERT ON file WHEN deferred_writes()
+BEGIN
+	INSERT OR IGNORE INTO deferred_search(id) VALUES (NEW.id);
+	INSERT OR IGNORE INTO deferred_trigram(id) VALUES (NEW.id);
+END;
+CREATE TRIGGER file_ad_deferred AFTER DELETE ON file WHEN deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = OLD.id
+		AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = OLD.id);
+	INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+	SELECT 'delete', OLD.id, OLD.name, OLD.alias, OLD.dir
+	WHERE NOT EXISTS (SELECT 1 FROM deferred_trigram WHERE id = OLD.id);
+	INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.id);
+	INSERT OR IGNORE INTO deferred_trigram(id) VALUES (OLD.id);
+END;
+CREATE TRIGGER file_au_deferred AFTER UPDATE OF name, alias, dir, comment ON file WHEN deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = OLD.id
+		AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = OLD.id);
+	INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.id);
+END;
+CREATE TRIGGER file_trigram_au_deferred AFTER UPDATE OF name, alias, dir ON file WHEN deferred_writes()
+BEGIN
+	INSERT INTO file_search_trigram(file_search_trigram, rowid, name, alias, dir)
+	SELECT 'delete', OLD.id, OLD.name, OLD.alias, OLD.dir
+	WHERE NOT EXISTS (SELECT 1 FROM deferred_trigram WHERE id = OLD.id);
+	INSERT OR IGNORE INTO deferred_trigram(id) VALUES (OLD.id);
+END;
+CREATE TRIGGER file_tag_ai_deferred AFTER INSERT ON file_tag WHEN deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = NEW.file_id
+		AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = NEW.file_id);
+	INSERT OR IGNORE INTO deferred_search(id) VALUES (NEW.file_id);
+	INSERT OR IGNORE INTO deferred_tag(id) VALUES (NEW.tag_id);
+END;
+CREATE TRIGGER file_tag_ad_deferred AFTER DELETE ON file_tag WHEN deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid = OLD.file_id
+		AND NOT EXISTS (SELECT 1 FROM deferred_search WHERE id = OLD.file_id);
+	INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.file_id);
+	INSERT OR IGNORE INTO deferred_tag(id) VALUES (OLD.tag_id);
+END;
+CREATE TRIGGER file_tag_au_deferred AFTER UPDATE ON file_tag WHEN deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid IN (OLD.file_id, NEW.file_id)
+		AND rowid NOT IN (SELECT id FROM deferred_search);
+	INSERT OR IGNORE INTO deferred_search(id) VALUES (OLD.file_id), (NEW.file_id);
+	INSERT OR IGNORE INTO deferred_tag(id) VALUES (OLD.tag_id), (NEW.tag_id);
+END;
+CREATE TRIGGER tag_search_au_deferred AFTER UPDATE OF name ON tag WHEN deferred_writes()
+BEGIN
+	DELETE FROM file_search WHERE rowid IN (SELECT file_id FROM file_tag WHERE tag_id = NEW.id)
+		AND rowid NOT IN (SELECT id FROM deferred_search);
+	INSERT OR IGNORE INTO deferred_search(id) SELECT file_id FROM file_tag WHERE tag_id = NEW.id;
+END;
+CREATE TRIGGER file_directory_ai_deferred AFTER INSERT ON file WHEN deferred_writes()
+BEGIN
+	INSERT OR IGNORE INTO deferred_directory(id) SELECT NEW.dir_id WHERE NEW.dir_id IS NOT NULL;
+END;
+CREATE TRIGGER file_directory_ad_deferred AFTER DELETE ON file WHEN deferred_writes()
+BEGIN
+	INSERT OR IGNORE INTO deferred_directory(id) SELECT OLD.dir_id WHERE OLD.dir_id IS NOT NULL;
+END;
+CREATE TRIGGER file_directory_au_deferred AFTER UPDATE OF dir_id ON file
+WHEN deferred_writes() AND OLD.dir_id IS NOT NEW.dir_id
+BEGIN
+	INSERT OR IGNORE INTO deferred_directory(id) SELECT OLD.dir_id WHERE OLD.dir_id IS NOT NULL;
+	INSERT OR IGNORE INTO deferred_directory(id) SELECT NEW.dir_id WHERE NEW.dir_id IS NOT NULL;
+END;
+
+-- cursor of a backfill that has not finished yet, see Migrator
+CREATE TABLE migration_state(version INTEGER PRIMARY KEY, cursor INTEGER NOT NULL) STRICT;
+
+CREATE TABLE import_job(
+	id      INTEGER PRIMARY KEY AUTOINCREMENT,
+	roots   TEXT    NOT NULL, -- JSON array of the chosen paths
+	options TEXT    NOT NULL DEFAULT '{}', -- JSON object, see ImportOptions
+	tags    TEXT    NOT NULL DEFAULT '[]', -- JSON array of tag ids
+	total   INTEGER NOT NULL DEFAULT 0,
+	cursor  INTEGER NOT NULL DEFAULT 0, -- seq of the last path handled
+	created INTEGER NOT NULL DEFAULT (unixepoch()),
+	walked  INTEGER NOT NULL DEFAULT 0 -- whether every path has been found
+) STRICT;
+
+CREATE TABLE import_job_path(
+	job_id INTEGER NOT NULL,
+	seq    INTEGER NOT NULL,
+	path   TEXT    NOT NULL,
+
+	PRIMARY KEY (job_id, seq),
+	FOREIGN KEY (job_id) REFERENCES import_job(id) ON DELETE CASCADE
+) STRICT, WITHOUT ROWID;
@@ -1,6 +1,9 @@
 #include "tag.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QUrl>
+#include "app/bulkedit.h"
 #include "app/globals.h"
 
 Tag::Tag()
@@ -97,61 +100,17 @@ DBError Tag::remove() const
 
 DBError Tag::setName(const QString& name) const
 {
-	if (db->isClosed())
-		return DBError(DBError::DatabaseClosed);
-	QString name_norm = normalizeName(name);
-	if (name.isEmpty())
-		return DBError(DBError::ValueError, "Name cannot be empty");
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE tag SET name = ? WHERE id = ?;", -1, &stmt, nullptr);
-	QByteArray name_bytes = name_norm.toUtf8();
-	sqlite3_bind_text(stmt, 1, name_bytes.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 2, m_id);
-	int rc = sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	if (rc != SQLITE_DONE)
-		return DBError(rc);
-	if (DBError error = updateModified())
-		return error;
-	return DBError();
+	return TagEdit(*this).name(name).commit();
 }
 
 DBError Tag::setDescription(const QString& description) const
 {
-	if (db->isClosed())
-		return DBError(DBError::DatabaseClosed);
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(db->con(), "UPDATE tag SET description = ? WHERE id = ?;", -1, &stmt, nullptr);
-	QByteArray description_bytes = description.trimmed().toUtf8();
-	sqlite3_bind_text(stmt, 1, description_bytes.constData(), -1, SQLITE_STATIC);
-	sqlite3_bind_int64(stmt, 2, m_id);
-	int rc = sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	if (rc != SQLITE_DONE)
-		return DBError(rc);
-	if (DBError error = updateModified())
-		return error;
-	return DBError();
+	return TagEdit(*this).description(description).commit();
 }
 
 DBError Tag::setURLs(const QStringList& urls) const
 {
-	if (db->isClosed())
-		return DBError(DBError::DatabaseClosed);
-	QList<QString> oldURLsList = this->urls();
-	QSet<QString> oldURLs(oldURLsList.begin(), oldURLsList.end());
-	QSet<QString> newURLs(urls.begin(), urls.end());
-
-	QSet<QString> toDelete = oldURLs - newURLs;
-	QSet<QString> toInsert = newURLs - oldURLs;
-
-	for (const QString& url : toDelete.values())
-		if (DBError error = removeURL(url))
-			return error;
-	for (const QString& url : toInsert.values())
-		if (DBError error = addURL(url))
-			return error;
-	return DBError();
+	return TagEdit(*this).urls(urls).commit();
 }
 
 DBError Tag::addURL(const QString& url) const
@@ -320,6 +279,11 @@ DBError Tag::updateModified() const
 	return DBError();
 }
 
+TagEdit Tag::edit() const
+{
+	return TagEdit(*this);
+}
+
 QString Tag::normalizeName(const QString& name)
 {
 	return name
@@ -327,3 +291,76 @@ QString Tag::normalizeName(const QString& name)
 		.toLower()
 		.replace(' ', '_');
 }
+
+TagEdit::TagEdit(const Tag& tag)
+	: m_tag(tag)
+{}
+
+TagEdit& TagEdit::name(const QString& name)
+{
+	m_name = name;
+	return *this;
+}
+
+TagEdit& TagEdit::description(const QString& description)
+{
+	m_description = description;
+	return *this;
+}
+
+TagEdit& TagEdit::urls(const QStringList& urls)
+{
+	m_urls = urls;
+	return *this;
+}
+
+DBError TagEdit::commit()
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	sqlite3_stmt* stmt;
+	int rc;
+	bool changed = false;
+
+	if (m_urls)
+	{
+		QByteArray urls_json;
+		if (DBError error = urlsToJson(*m_urls, &urls_json))
+			return error;
+		const QByteArray owner_json = QJsonDocument(QJsonArray{ static_cast<qint64>(m_tag.id()) }).toJson(QJsonDocument::Compact);
+		if (DBError error = replaceLinks("tag_url", "tag_id", "url", owner_json, urls_json, &changed))
+			return error;
+	}
+
+	QByteArray name_bytes;
+	if (m_name)
+	{
+		const QString name_norm = Tag::normalizeName(*m_name);
+		if (name_norm.isEmpty())
+			return DBError(DBError::ValueError, "Name cannot be empty");
+		name_bytes = name_norm.toUtf8();
+	}
+	const QByteArray description_bytes = m_description ? m_description->trimmed().toUtf8() : QByteArray();
+	if (!m_name && !m_description && !changed)
+		return DBError();
+
+	QStringList columns{ u"modified = ?"_s };
+	if (m_name)
+		columns.append(u"name = ?"_s);
+	if (m_description)
+		columns.append(u"description = ?"_s);
+	const QByteArray sql = u"UPDATE tag SET %1 WHERE id = ?;"_s.arg(columns.join(u", "_s)).toUtf8();
+	sqlite3_prepare_v2(db->con(), sql.constData(), -1, &stmt, nullptr);
+	int i = 1;
+	sqlite3_bind_int64(stmt, i++, QDateTime::currentSecsSinceEpoch());
+	if (m_name)
+		sqlite3_bind_text(stmt, i++, name_bytes.constData(), -1, SQLITE_STATIC);
+	if (m_description)
+		sqlite3_bind_text(stmt, i++, description_bytes.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, i, m_tag.id());
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
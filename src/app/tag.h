@@ -1,9 +1,12 @@
 #pragma once
 
 #include <QDateTime>
+#include <optional>
 
 #include "database.h"
 
+class TagEdit;
+
 struct Tag
 {
 public:
@@ -11,6 +14,7 @@ public:
 	Tag(int64_t id);
 	static DBError create(const QString& name, const QString& description = QString(), const QList<QString>& urls = QList<QString>(), Tag* out = nullptr);
 	static Tag fromName(const QString& name);
+	static QString normalizeName(const QString& name);
 	bool exists() const;
 	int64_t id() const;
 	QString name() const;
@@ -25,6 +29,8 @@ public:
 	DBError removeURL(const QString& url) const;
 	DBError setURLs(const QStringList& urls) const;
 	DBError remove() const;
+	// collects several changes to write at once, see TagEdit
+	TagEdit edit() const;
 	bool operator==(const Tag& other) const
 	{
 		return this->id() == other.id();
@@ -35,11 +41,31 @@ public:
 	}
 
 private:
-	static inline QString normalizeName(const QString& name);
 	int64_t m_id;
 	DBError updateModified() const;
 };
 
+/**
+ * Changes to one tag, written by commit() as a single UPDATE plus a
+ * set-based diff of the URLs, with modified stamped once. Fields that are
+ * not set are left alone.
+ */
+class TagEdit
+{
+public:
+	explicit TagEdit(const Tag& tag);
+	TagEdit& name(const QString& name);
+	TagEdit& description(const QString& description);
+	TagEdit& urls(const QStringList& urls);
+	DBError commit();
+
+private:
+	Tag m_tag;
+	std::optional<QString> m_name;
+	std::optional<QString> m_description;
+	std::optional<QStringList> m_urls;
+};
+
 namespace std
 {
 	template <>
@@ -0,0 +1,271 @@
+#include "tagdictionary.h"
+
+#include <algorithm>
+#include <queue>
+#include "app/database.h"
+
+TagDictionary::TagDictionary(QObject* parent)
+	: QObject(parent)
+{
+	connect(db, &Database::opened, this, &TagDictionary::load);
+	connect(db, &Database::closed, this, &TagDictionary::clear);
+	connect(db, &Database::tagsUpdated, this, &TagDictionary::update);
+	if (db->isOpen())
+		load();
+}
+
+TagDictionary::~TagDictionary()
+{
+	s_instance = nullptr;
+}
+
+TagDictionary* TagDictionary::instance()
+{
+	// parented to the database so both go away together
+	if (s_instance == nullptr)
+		s_instance = new TagDictionary(db);
+	return s_instance;
+}
+
+Tag TagDictionary::find(const QString& name) const
+{
+	const QString normalized = Tag::normalizeName(name);
+	if (const auto it = m_ids.constFind(normalized); it != m_ids.cend())
+		return Tag(*it);
+	if (m_unknown.contains(normalized))
+		return Tag();
+	// a tag created by another connection, or too recently for tagsUpdated
+	// to have arrived, is only in the database so far
+	const Tag tag = Tag::fromName(normalized);
+	if (tag.id() < 0)
+		m_unknown.insert(normalized);
+	return tag;
+}
+
+bool TagDictionary::contains(const QString& name) const
+{
+	return find(name).id() >= 0;
+}
+
+QStringList TagDictionary::complete(const QString& prefix, int limit) const
+{
+	const QString needle = Tag::normalizeName(prefix);
+	if (needle.isEmpty() || limit <= 0 || m_keys.isEmpty())
+		return QStringList();
+	auto lower = std::lower_bound(m_keys.cbegin(), m_keys.cend(), needle
+		, [](const Key& key, const QString& value) -> bool { return key.text < value; });
+	auto upper = std::partition_point(lower, m_keys.cend()
+		, [&needle](const Key& key) -> bool { return key.text.startsWith(needle); });
+	if (lower == upper)
+		return QStringList();
+
+	// pop the best key of a range, then split the range around it, so only
+	// O(limit) ranges are ever visited no matter how many keys match
+	struct Range
+	{
+		qsizetype best, from, to;
+	};
+	auto worse = [this](const Range& a, const Range& b) -> bool { return better(a.best, b.best) == b.best; };
+	std::priority_queue<Range, std::vector<Range>, decltype(worse)> queue(worse);
+	const qsizetype from = lower - m_keys.cbegin();
+	const qsizetype to = upper - m_keys.cbegin();
+	queue.push({ best(from, to), from, to });
+
+	QStringList names;
+	QSet<int64_t> seen;
+	while (!queue.empty() && names.size() < limit)
+	{
+		const Range range = queue.top();
+		queue.pop();
+		const int64_t id = m_keys.at(range.best).id;
+		if (!seen.contains(id))
+		{
+			seen.insert(id);
+			names.append(m_tags.value(id).name);
+		}
+		if (range.from < range.best)
+			queue.push({ best(range.from, range.best), range.from, range.best });
+		if (range.best + 1 < range.to)
+			queue.push({ best(range.best + 1, range.to), range.best + 1, range.to });
+	}
+	return names;
+}
+
+QStringList TagDictionary::suggest(const QString& name, int limit) const
+{
+	const QString needle = Tag::normalizeName(name);
+	if (needle.isEmpty() || limit <= 0 || m_ids.contains(needle))
+		return QStringList();
+	QList<FuzzyMatcher::Match> matches = m_fuzzy.search(needle, FuzzyMatcher::defaultDistance(needle.size()));
+	std::sort(matches.begin(), matches.end(), [this](const FuzzyMatcher::Match& a, const FuzzyMatcher::Match& b) -> bool
+		{
+			if (a.distance != b.distance)
+				return a.distance < b.distance;
+			const auto entryA = m_tags.constFind(a.id);
+			const auto entryB = m_tags.constFind(b.id);
+			if (entryA->degree != entryB->degree)
+				return entryA->degree > entryB->degree;
+			return entryA->name < entryB->name;
+		});
+	QStringList names;
+	for (const FuzzyMatcher::Match& match : matches.first(std::min<qsizetype>(limit, matches.size())))
+		names.append(m_tags.value(match.id).name);
+	return names;
+}
+
+qsizetype TagDictionary::size() const
+{
+	return m_tags.size();
+}
+
+void TagDictionary::load()
+{
+	m_tags.clear();
+	m_ids.clear();
+	m_unknown.clear();
+	if (db->isOpen())
+	{
+		sqlite3_stmt* stmt;
+		sqlite3_prepare_v2(db->con(), "SELECT id, name, degree FROM tag;", -1, &stmt, nullptr);
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const int64_t id = sqlite3_column_int64(stmt, 0);
+			const QString name = QString::fromUtf8((const char*)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+			m_tags.insert(id, { name, sqlite3_column_int64(stmt, 2) });
+			m_ids.insert(name, id);
+		}
+		sqlite3_finalize(stmt);
+	}
+	buildKeys();
+	emit changed();
+}
+
+void TagDictionary::update(const QList<int64_t>& ids)
+{
+	if (db->isClosed())
+		return;
+	m_unknown.clear();
+	// re-reading everything is cheaper than many point lookups
+	if (ids.size() > m_tags.size() / 4)
+		return load();
+
+	bool renamed = false;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT name, degree FROM tag WHERE id = ?;", -1, &stmt, nullptr);
+	for (int64_t id : ids)
+	{
+		sqlite3_bind_int64(stmt, 1, id);
+		auto it = m_tags.find(id);
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const QString name = QString::fromUtf8((const char*)sqlite3_column_text(stmt, 0), sqlite3_column_bytes(stmt, 0));
+			const int64_t degree = sqlite3_column_int64(stmt, 1);
+			if (it == m_tags.end())
+			{
+				m_tags.insert(id, { name, degree });
+				m_ids.insert(name, id);
+				renamed = true;
+			}
+			else
+			{
+				if (it->name != name)
+				{
+					m_ids.remove(it->name);
+					m_ids.insert(name, id);
+					it->name = name;
+					renamed = true;
+				}
+				it->degree = degree;
+			}
+		}
+		else if (it != m_tags.end())
+		{
+			m_ids.remove(it->name);
+			m_tags.erase(it);
+			renamed = true;
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+
+	if (renamed)
+		buildKeys();
+	else
+	{
+		// only degrees moved, the key order still holds
+		for (Key& key : m_keys)
+			key.degree = m_tags.value(key.id).degree;
+		buildTree();
+	}
+	emit changed();
+}
+
+void TagDictionary::clear()
+{
+	m_tags.clear();
+	m_ids.clear();
+	m_unknown.clear();
+	m_keys.clear();
+	m_tree.clear();
+	m_fuzzy.clear();
+	emit changed();
+}
+
+void TagDictionary::buildKeys()
+{
+	m_keys.clear();
+	m_keys.reserve(m_tags.size() * 2);
+	m_fuzzy.clear();
+	for (auto it = m_tags.cbegin(); it != m_tags.cend(); ++it)
+	{
+		const QString& name = it->name;
+		m_fuzzy.insert(it.key(), name);
+		m_keys.append({ name, it.key(), it->degree });
+		for (qsizetype i = name.indexOf('_'); i != -1; i = name.indexOf('_', i + 1))
+			if (i + 1 < name.size() && name.at(i + 1) != '_')
+				m_keys.append({ name.sliced(i + 1), it.key(), it->degree });
+	}
+	std::sort(m_keys.begin(), m_keys.end(), [](const Key& a, const Key& b) -> bool { return a.text < b.text; });
+	m_fuzzy.squeeze();
+	buildTree();
+}
+
+void TagDictionary::buildTree()
+{
+	const qsizetype n = m_keys.size();
+	m_tree.resize(2 * n);
+	for (qsizetype i = 0; i < n; ++i)
+		m_tree[n + i] = i;
+	for (qsizetype i = n - 1; i > 0; --i)
+		m_tree[i] = better(m_tree.at(2 * i), m_tree.at(2 * i + 1));
+}
+
+qsizetype TagDictionary::better(qsizetype a, qsizetype b) const
+{
+	if (a < 0)
+		return b;
+	if (b < 0)
+		return a;
+	// ties go to the key that sorts first
+	const int64_t degreeA = m_keys.at(a).degree;
+	const int64_t degreeB = m_keys.at(b).degree;
+	if (degreeA != degreeB)
+		return degreeA > degreeB ? a : b;
+	return std::min(a, b);
+}
+
+qsizetype TagDictionary::best(qsizetype from, qsizetype to) const
+{
+	const qsizetype n = m_keys.size();
+	qsizetype result = -1;
+	for (from += n, to += n; from < to; from >>= 1, to >>= 1)
+	{
+		if (from & 1)
+			result = better(result, m_tree.at(from++));
+		if (to & 1)
+			result = better(result, m_tree.at(--to));
+	}
+	return result;
+}
+
+TagDictionary* TagDictionary::s_instance = nullptr;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include "app/fuzzymatcher.h"
+#include "app/tag.h"
+
+/**
+ * In-memory copy of every tag's name and degree, kept current from the
+ * database's update notifications. Completion and name lookups are answered
+ * from here so typing in a tag box never has to wait on SQLite.
+ */
+class TagDictionary final : public QObject
+{
+	Q_OBJECT
+
+public:
+	static TagDictionary* instance();
+	~TagDictionary() override;
+	/**
+	 * name is normalized the same way Tag::create stores it. A name that is
+	 * not here yet is looked up in the database before it is called unknown,
+	 * once until the tags change again.
+	 */
+	Tag find(const QString& name) const;
+	bool contains(const QString& name) const;
+	/**
+	 * Returns up to limit tag names where the whole name, or any part of it
+	 * following an underscore, starts with prefix, normalized like the
+	 * names. Ordered by degree.
+	 */
+	QStringList complete(const QString& prefix, int limit) const;
+	/**
+	 * Returns up to limit existing tag names that are a few typos away from
+	 * name, closest and most used first. Empty if name is itself a tag.
+	 */
+	QStringList suggest(const QString& name, int limit) const;
+	qsizetype size() const;
+
+signals:
+	void changed();
+
+private:
+	explicit TagDictionary(QObject* parent = nullptr);
+	static TagDictionary* s_instance;
+	struct Entry
+	{
+		QString name;
+		int64_t degree;
+	};
+	struct Key
+	{
+		QString text;
+		int64_t id;
+		int64_t degree;
+	};
+	QHash<int64_t, Entry> m_tags;
+	QHash<QString, int64_t> m_ids;
+	// names the database did not know either, forgotten whenever the tags
+	// change, so repeated lookups while typing stay in memory
+	mutable QSet<QString> m_unknown;
+	// every name and each of its underscore separated suffixes, sorted so that
+	// the keys sharing a prefix form one contiguous range
+	QList<Key> m_keys;
+	// segment tree over m_keys, each node holds the key index with the
+	// highest degree in its range
+	QList<qsizetype> m_tree;
+	FuzzyMatcher m_fuzzy;
+	void load();
+	void update(const QList<int64_t>& ids);
+	void clear();
+	void buildKeys();
+	void buildTree();
+	qsizetype better(qsizetype a, qsizetype b) const;
+	qsizetype best(qsizetype from, qsizetype to) const;
+};
@@ -0,0 +1,369 @@
+#include "volume.h"
+
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "app/globals.h"
+
+// one per volume for as long as the application runs, so a hung mount
+// holds at most one thread however often it is asked about
+struct Prober
+{
+	QMutex mutex;
+	QWaitCondition answered;
+	bool running = false;
+	bool online = false;
+};
+static QMutex s_probersLock;
+static QHash<std::pair<QString, QString>, std::shared_ptr<Prober>> s_probers;
+
+Volume::Identities::Identities()
+{
+#ifdef Q_OS_LINUX
+	// udev links every file system that has a UUID from /dev/disk/by-uuid
+	for (const QFileInfo& link : QDir(u"/dev/disk/by-uuid"_s).entryInfoList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot))
+		if (const QString device = link.canonicalFilePath(); !device.isEmpty())
+			m_uuids.insert(device, link.fileName());
+#endif
+}
+
+QString Volume::Identities::of(const QStorageInfo& storage) const
+{
+	const QString device = QString::fromUtf8(storage.device());
+#ifdef Q_OS_LINUX
+	const QString canonicalDevice = QFileInfo(device).canonicalFilePath();
+	if (const auto it = m_uuids.constFind(canonicalDevice); !canonicalDevice.isEmpty() && it != m_uuids.cend())
+		return u"uuid:"_s + *it;
+#endif
+	// a volume GUID path on Windows, the share for network mounts
+	return device;
+}
+
+Volume::Volume()
+	: m_id(-1)
+{}
+
+Volume::Volume(int64_t id)
+	: m_id(id)
+{}
+
+DBError Volume::ensure(const QStorageInfo& storage, Volume* out, const Identities* identities)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (!storage.isValid())
+	{
+		if (out)
+			*out = Volume();
+		return DBError();
+	}
+	const QByteArray identity_bytes = (identities ? *identities : Identities()).of(storage).toUtf8();
+	const QByteArray root_bytes = QDir::fromNativeSeparators(storage.rootPath()).toUtf8();
+	const QByteArray label_bytes = storage.displayName().toUtf8();
+
+	// the mount point and label may have changed since it was last seen
+	sqlite3_stmt* stmt;
+	const char* sql = R"(
+		INSERT INTO volume(identity, root, label) VALUES (?, ?, ?)
+		ON CONFLICT (identity) DO UPDATE SET root = excluded.root, label = excluded.label
+		WHERE root IS NOT excluded.root OR label IS NOT excluded.label;
+	)";
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, identity_bytes.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, root_bytes.constData(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 3, label_bytes.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	if (out)
+	{
+		sqlite3_prepare_v2(db->con(), "SELECT id FROM volume WHERE identity = ?;", -1, &stmt, nullptr);
+		sqlite3_bind_text(stmt, 1, identity_bytes.constData(), -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+			*out = Volume(sqlite3_column_int64(stmt, 0));
+		sqlite3_finalize(stmt);
+	}
+	return DBError();
+}
+
+QList<Volume> Volume::all()
+{
+	if (db->isClosed())
+		return QList<Volume>();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id FROM volume ORDER BY root;", -1, &stmt, nullptr);
+	QList<Volume> volumes;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		volumes.append(Volume(sqlite3_column_int64(stmt, 0)));
+	sqlite3_finalize(stmt);
+	return volumes;
+}
+
+void Volume::assignDirectories()
+{
+	if (db->isClosed())
+		return;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id, path FROM directory WHERE volume_id IS NULL;", -1, &stmt, nullptr);
+	QList<std::pair<int64_t, QString>> unassigned;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		unassigned.append({
+			sqlite3_column_int64(stmt, 0),
+			QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1))
+		});
+	sqlite3_finalize(stmt);
+	if (unassigned.isEmpty())
+		return;
+
+	// every directory has to be looked for, which can take long on a slow
+	// mount and never returns on a hung one
+	const QString databasePath = db->path();
+	const auto found = std::make_shared<QList<std::pair<int64_t, QStorageInfo>>>();
+	QThread* thread = QThread::create([unassigned, found]() -> void
+		{
+			// the deepest mount point holding a path is the volume it is on,
+			// so the mounts are listed once rather than asked about every
+			// directory
+			QList<QStorageInfo> mounts = QStorageInfo::mountedVolumes();
+			std::sort(mounts.begin(), mounts.end(), [](const QStorageInfo& a, const QStorageInfo& b) -> bool
+				{
+					return a.rootPath().size() > b.rootPath().size();
+				});
+			for (const auto& [id, path] : unassigned)
+			{
+				// an unmounted drive leaves its mount point behind, or
+				// nothing at all, so only what is there can be told apart
+				if (!QFileInfo::exists(path))
+					continue;
+				for (const QStorageInfo& mount : mounts)
+				{
+					const QString root = QDir::fromNativeSeparators(mount.rootPath());
+					if (path != root && !path.startsWith(root.endsWith('/') ? root : root + '/'))
+						continue;
+					found->append({ id, mount });
+					break;
+				}
+			}
+		});
+	QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+	QObject::connect(thread, &QThread::finished, db, [databasePath, found]() -> void
+		{
+			if (db->isClosed() || db->path() != databasePath || found->isEmpty())
+				return;
+			// left for the next time the database is opened
+			if (DBError error = db->begin())
+			{
+				qWarning() << "Failed to assign directories to volumes:" << error.message();
+				return;
+			}
+			if (DBError error = assign(*found))
+			{
+				qWarning() << "Failed to assign directories to volumes:" << error.message();
+				db->rollback();
+			}
+			else
+				db->commit();
+		});
+	thread->start(QThread::LowPriority);
+}
+
+DBError Volume::assign(const QList<std::pair<int64_t, QStorageInfo>>& found)
+{
+	const Identities identities;
+	QHash<QString, int64_t> volumeIds;
+	QJsonArray assignments;
+	for (const auto& [id, mount] : found)
+	{
+		const QString root = QDir::fromNativeSeparators(mount.rootPath());
+		if (!volumeIds.contains(root))
+		{
+			Volume volume;
+			if (DBError error = ensure(mount, &volume, &identities))
+				return error;
+			volumeIds.insert(root, volume.id());
+		}
+		assignments.append(QJsonArray{ static_cast<qint64>(id), static_cast<qint64>(volumeIds.value(root)) });
+	}
+	const QByteArray assignments_json = QJsonDocument(assignments).toJson(QJsonDocument::Compact);
+	const char* sql = R"(
+		UPDATE directory SET volume_id = assignment.value ->> 1
+		FROM json_each(?) AS assignment
+		WHERE directory.id = assignment.value ->> 0;
+	)";
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), sql, -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, assignments_json.constData(), -1, SQLITE_STATIC);
+	int rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+		return DBError(rc);
+	return DBError();
+}
+
+QList<Volume::Mount> Volume::mounts()
+{
+	QList<Mount> mounts;
+	if (db->isClosed())
+		return mounts;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT id, identity, root FROM volume;", -1, &stmt, nullptr);
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		mounts.append({
+			sqlite3_column_int64(stmt, 0),
+			QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), sqlite3_column_bytes(stmt, 1)),
+			QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)), sqlite3_column_bytes(stmt, 2))
+		});
+	sqlite3_finalize(stmt);
+	return mounts;
+}
+
+QSet<int64_t> Volume::offline(int timeout)
+{
+	return offline(mounts(), timeout);
+}
+
+QSet<int64_t> Volume::offline(const QList<Mount>& mounts, int timeout)
+{
+	QSet<int64_t> offline;
+	if (mounts.isEmpty())
+		return offline;
+	QList<std::pair<int64_t, std::shared_ptr<Prober>>> volumes;
+	const auto identities = std::make_shared<const Identities>();
+	for (const Mount& mount : mounts)
+	{
+		std::shared_ptr<Prober> prober;
+		{
+			QMutexLocker locker(&s_probersLock);
+			std::shared_ptr<Prober>& slot = s_probers[{ mount.identity, mount.root }];
+			if (!slot)
+				slot = std::make_shared<Prober>();
+			prober = slot;
+		}
+		volumes.append({ mount.id, prober });
+
+		// a hung network mount can block whoever asks for minutes, so the
+		// probe runs on a thread of its own that is left behind if it does
+		// not answer in time. one that is still out is waited on again
+		QMutexLocker locker(&prober->mutex);
+		if (prober->running)
+			continue;
+		prober->running = true;
+		std::thread([prober, identities, identity = mount.identity, root = mount.root]() -> void
+			{
+				const QStorageInfo storage(root);
+				const bool online = storage.isValid() && storage.isReady()
+					&& QDir::fromNativeSeparators(storage.rootPath()) == root
+					&& identities->of(storage) == identity;
+				QMutexLocker locker(&prober->mutex);
+				prober->online = online;
+				prober->running = false;
+				prober->answered.wakeAll();
+			}).detach();
+	}
+
+	const QDeadlineTimer deadline(timeout);
+	for (const auto& [id, prober] : volumes)
+	{
+		QMutexLocker locker(&prober->mutex);
+		while (prober->running && !deadline.hasExpired())
+			prober->answered.wait(&prober->mutex, deadline);
+		if (prober->running || !prober->online)
+			offline.insert(id);
+	}
+	return offline;
+}
+
+bool Volume::exists() const
+{
+	if (m_id < 0)
+		return false;
+	if (db->isClosed())
+		return false;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT EXISTS(SELECT 1 FROM volume WHERE id = ?);", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	bool exists = false;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		exists = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return exists;
+}
+
+int64_t Volume::id() const
+{
+	return m_id;
+}
+
+QString Volume::identity() const
+{
+	if (db->isClosed())
+		return QString();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT identity FROM volume WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QString identity;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		identity = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+	sqlite3_finalize(stmt);
+	return identity;
+}
+
+QString Volume::root() const
+{
+	if (db->isClosed())
+		return QString();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT root FROM volume WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QString root;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		root = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+	sqlite3_finalize(stmt);
+	return root;
+}
+
+QString Volume::label() const
+{
+	if (db->isClosed())
+		return QString();
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT label FROM volume WHERE id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	QString label;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		label = QString::fromUtf8(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+	sqlite3_finalize(stmt);
+	return label;
+}
+
+int64_t Volume::fileCount() const
+{
+	if (db->isClosed())
+		return 0;
+	sqlite3_stmt* stmt;
+	sqlite3_prepare_v2(db->con(), "SELECT coalesce(sum(file_count), 0) FROM directory WHERE volume_id = ?;", -1, &stmt, nullptr);
+	sqlite3_bind_int64(stmt, 1, m_id);
+	int64_t count = 0;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return count;
+}
+
+const int Volume::PROBE_TIMEOUT = 2000;
+const QByteArray Volume::DIRECTORY_VOLUME_SQL = R"(coalesce(directory.volume_id, (
+	SELECT volume.id FROM volume
+	WHERE substr(directory.path || '/', 1, length(rtrim(volume.root, '/')) + 1) = rtrim(volume.root, '/') || '/'
+	ORDER BY length(volume.root) DESC LIMIT 1
+)))";
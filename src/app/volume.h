@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStorageInfo>
+#include <QString>
+
+#include "app/database.h"
+
+/**
+ * A file system files are stored on, identified by its UUID where one can
+ * be found and by its device otherwise, so a drive is known again however
+ * it is mounted. Every directory belongs to the volume it was on when it
+ * was created. Operations over many files probe the volumes once with
+ * offline() and leave the files on volumes that are not there alone,
+ * rather than find each of them missing or wait on a hung mount per file.
+ */
+struct Volume
+{
+public:
+	/**
+	 * Tells volumes apart. The UUID links udev keeps are listed once when
+	 * it is made, so keep one around for as long as several volumes are
+	 * looked up together.
+	 */
+	class Identities
+	{
+	public:
+		Identities();
+		QString of(const QStorageInfo& storage) const;
+
+	private:
+		// link name by the device it points at
+		QHash<QString, QString> m_uuids;
+	};
+	Volume();
+	Volume(int64_t id);
+	// the volume storage is on, created the first time it is seen
+	static DBError ensure(const QStorageInfo& storage, Volume* out = nullptr, const Identities* identities = nullptr);
+	static QList<Volume> all();
+	/**
+	 * Assigns the directories from before volumes were known to the volume
+	 * they are on. The disk is looked at on a thread of its own and the
+	 * assignments are written once it is done, unless another database was
+	 * opened meanwhile. Directories that cannot be found right now are left
+	 * for a later call.
+	 */
+	static void assignDirectories();
+	// what probing a volume needs, so it can be done away from the database
+	struct Mount
+	{
+		int64_t id;
+		QString identity;
+		QString root;
+	};
+	static QList<Mount> mounts();
+	/**
+	 * Probes every volume at once and returns the ids of those that are not
+	 * mounted, or did not answer within timeout milliseconds. A volume
+	 * whose last probe has not answered yet is not probed again, it is
+	 * waited on. Waits up to timeout, so away from the UI thread the mounts
+	 * are read first and probed with the overload that takes them, which
+	 * does not touch the database.
+	 */
+	static QSet<int64_t> offline(int timeout = PROBE_TIMEOUT);
+	static QSet<int64_t> offline(const QList<Mount>& mounts, int timeout = PROBE_TIMEOUT);
+	static const int PROBE_TIMEOUT;
+	/**
+	 * The id of the volume of the row named directory: its own, or for one
+	 * not assigned yet the volume with the deepest root above its path.
+	 * Everything that skips the files on offline volumes goes by it.
+	 */
+	static const QByteArray DIRECTORY_VOLUME_SQL;
+	bool exists() const;
+	int64_t id() const;
+	QString identity() const;
+	// where it was mounted when last seen
+	QString root() const;
+	QString label() const;
+	int64_t fileCount() const;
+	bool operator==(const Volume& other) const
+	{
+		return this->id() == other.id();
+	}
+	bool operator!=(const Volume& other) const
+	{
+		return this->id() != other.id();
+	}
+
+private:
+	int64_t m_id;
+	static DBError assign(const QList<std::pair<int64_t, QStorageInfo>>& found);
+};
@@ -0,0 +1,141 @@
+#include "writebatcher.h"
+
+#include "app/globals.h"
+
+WriteBatcher::WriteBatcher(bool bulk, int rowLimit, int timeLimit, int queueLimit)
+	: m_bulk(bulk)
+	, m_rowLimit(rowLimit)
+	, m_timeLimit(timeLimit)
+	, m_queueLimit(queueLimit)
+	, m_open(false)
+	, m_pending(0)
+	, m_written(0)
+	, m_closed(false)
+{}
+
+WriteBatcher::~WriteBatcher()
+{
+	close();
+	if (m_open)
+		finish();
+}
+
+DBError WriteBatcher::write(const Item& item)
+{
+	if (db->isClosed())
+		return DBError(DBError::DatabaseClosed);
+	if (!m_open)
+	{
+		if (DBError error = m_bulk ? db->beginBulk() : db->begin())
+			return error;
+		m_open = true;
+		m_pending = 0;
+		m_timer.start();
+	}
+	if (int rc = sqlite3_exec(db->con(), "SAVEPOINT batch_item;", 0, 0, 0); rc != SQLITE_OK)
+		return DBError(rc);
+	DBError error = item();
+	int rc = SQLITE_OK;
+	if (error)
+		rc = sqlite3_exec(db->con(), "ROLLBACK TO batch_item;", 0, 0, 0);
+	else
+		++m_pending;
+	if (rc == SQLITE_OK)
+		rc = sqlite3_exec(db->con(), "RELEASE batch_item;", 0, 0, 0);
+	// some errors roll back the whole transaction, the next SAVEPOINT would
+	// then quietly start one outside of beginBulk(). the chunk is lost
+	if (rc != SQLITE_OK || sqlite3_get_autocommit(db->con()))
+	{
+		db->rollback();
+		m_open = false;
+		m_pending = 0;
+		return error ? error : DBError(rc);
+	}
+	if (m_pending >= m_rowLimit || m_timer.elapsed() >= m_timeLimit)
+		if (DBError commitError = commitChunk())
+			return commitError;
+	return error;
+}
+
+void WriteBatcher::setCheckpoint(const Item& checkpoint)
+{
+	m_checkpoint = checkpoint;
+}
+
+bool WriteBatcher::submit(const Item& item)
+{
+	QMutexLocker locker(&m_mutex);
+	while (!m_closed && m_queue.size() >= m_queueLimit)
+		m_notFull.wait(&m_mutex);
+	if (m_closed)
+		return false;
+	m_queue.enqueue(item);
+	return true;
+}
+
+int WriteBatcher::drain(DBError* lastError)
+{
+	int failed = 0;
+	while (true)
+	{
+		Item item;
+		{
+			QMutexLocker locker(&m_mutex);
+			if (m_queue.isEmpty())
+				break;
+			item = m_queue.dequeue();
+			m_notFull.wakeOne();
+		}
+		if (DBError error = write(item))
+		{
+			++failed;
+			if (lastError)
+				*lastError = error;
+		}
+	}
+	return failed;
+}
+
+void WriteBatcher::close()
+{
+	QMutexLocker locker(&m_mutex);
+	m_closed = true;
+	m_notFull.wakeAll();
+}
+
+DBError WriteBatcher::finish()
+{
+	if (!m_open)
+		return DBError();
+	return commitChunk();
+}
+
+int64_t WriteBatcher::written() const
+{
+	return m_written;
+}
+
+DBError WriteBatcher::commitChunk()
+{
+	if (m_checkpoint)
+		if (DBError error = m_checkpoint())
+		{
+			db->rollback();
+			m_open = false;
+			return error;
+		}
+	if (DBError error = db->commit())
+	{
+		db->rollback();
+		m_open = false;
+		return error;
+	}
+	m_open = false;
+	m_written += m_pending;
+	m_pending = 0;
+	return DBError();
+}
+
+const int WriteBatcher::ROW_LIMIT = 1000;
+const int WriteBatcher::TIME_LIMIT = 2000;
+const int WriteBatcher::QUEUE_LIMIT = 256;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+#include <functional>
+
+#include "app/database.h"
+
+/**
+ * Splits a long run of writes on the main connection into transactions of
+ * at most rowLimit items or timeLimit milliseconds, so a cancel or crash
+ * only loses the open chunk and the WAL can be checkpointed in between.
+ * Every item runs in its own savepoint, a failing item is rolled back alone
+ * and the rest of its chunk kept.
+ *
+ * Producers on other threads hand items over with submit(), which blocks
+ * while queueLimit items are waiting, and the thread owning the connection
+ * runs them with drain().
+ */
+class WriteBatcher
+{
+public:
+	using Item = std::function<DBError()>;
+	explicit WriteBatcher(bool bulk = true, int rowLimit = ROW_LIMIT, int timeLimit = TIME_LIMIT, int queueLimit = QUEUE_LIMIT);
+	// commits the open chunk
+	~WriteBatcher();
+	// runs item now, returns its error once it has been rolled back
+	DBError write(const Item& item);
+	// called inside every chunk right before it commits, e.g. to save progress
+	void setCheckpoint(const Item& checkpoint);
+	// returns false once close() was called
+	bool submit(const Item& item);
+	// runs everything queued so far, returns the number of items that failed
+	int drain(DBError* lastError = nullptr);
+	// wakes blocked producers and refuses further items
+	void close();
+	DBError finish();
+	int64_t written() const;
+
+	static const int ROW_LIMIT;
+	static const int TIME_LIMIT;
+	static const int QUEUE_LIMIT;
+
+private:
+	bool m_bulk;
+	int m_rowLimit;
+	int m_timeLimit;
+	int m_queueLimit;
+	bool m_open;
+	int m_pending;
+	int64_t m_written;
+	QElapsedTimer m_timer;
+	Item m_checkpoint;
+	QMutex m_mutex;
+	QWaitCondition m_notFull;
+	QQueue<Item> m_queue;
+	bool m_closed;
+	DBError commitChunk();
+};